@@ -10,6 +10,7 @@
 
 #include <QAbstractFileEngine>
 #include <QAbstractFileEngineHandler>
+#include <QBuffer>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileSystemModel>
@@ -28,6 +29,10 @@ public:
     virtual bool exists(const QString &path) = 0;
     virtual bool isDirectory(const QString &path) = 0;
     virtual qint64 fileSize(const QString &path) = 0;
+
+    // Streaming handle on a file; with a real QFATFileSystem this is
+    // new QFATFile(fs, path) followed by open(mode)
+    virtual QIODevice *openFile(const QString &path, QIODevice::OpenMode mode) = 0;
 };
 
 /**
@@ -42,8 +47,6 @@ public:
     explicit QFATFileEngine(const QString &fileName, SimpleFATInterface *fs)
         : m_fileName(fileName)
         , m_fs(fs)
-        , m_position(0)
-        , m_openMode(QIODevice::NotOpen)
     {
         qDebug() << "[QFATFileEngine] Created for" << fileName;
     }
@@ -53,109 +56,59 @@ public:
         close();
     }
 
-    // Open the file and cache its contents
+    // Open a streaming handle; file contents are never loaded into memory as a whole
     bool open(QIODevice::OpenMode mode) override
     {
         qDebug() << "[QFATFileEngine] Opening" << m_fileName << "mode:" << mode;
 
-        if (m_openMode != QIODevice::NotOpen) {
+        if (m_file) {
             return false; // Already open
         }
 
-        m_openMode = mode;
-        m_position = 0;
-
-        if (mode & QIODevice::ReadOnly) {
-            // Read file contents into memory
-            m_fileData = m_fs->readFile(m_fileName);
-            return !m_fileData.isNull();
-        }
-
-        if (mode & QIODevice::WriteOnly) {
-            // Start with empty buffer for writing
-            m_fileData.clear();
-            return true;
-        }
-
-        return false;
+        m_file.reset(m_fs->openFile(m_fileName, mode));
+        return !m_file.isNull();
     }
 
     bool close() override
     {
         qDebug() << "[QFATFileEngine] Closing" << m_fileName;
 
-        if (m_openMode == QIODevice::NotOpen) {
+        if (!m_file) {
             return true;
         }
 
-        // If opened for writing, flush to filesystem
-        if (m_openMode & QIODevice::WriteOnly) {
-            bool success = m_fs->writeFile(m_fileName, m_fileData);
-            if (!success) {
-                return false;
-            }
-        }
-
-        m_fileData.clear();
-        m_position = 0;
-        m_openMode = QIODevice::NotOpen;
+        // Closing the handle writes the updated directory entry
+        m_file->close();
+        m_file.reset();
         return true;
     }
 
     qint64 read(char *data, qint64 maxlen) override
     {
-        if (!(m_openMode & QIODevice::ReadOnly)) {
-            return -1;
-        }
-
-        qint64 available = m_fileData.size() - m_position;
-        qint64 toRead = qMin(maxlen, available);
-
-        if (toRead > 0) {
-            memcpy(data, m_fileData.constData() + m_position, toRead);
-            m_position += toRead;
-        }
-
-        return toRead;
+        return m_file ? m_file->read(data, maxlen) : -1;
     }
 
     qint64 write(const char *data, qint64 len) override
     {
-        if (!(m_openMode & QIODevice::WriteOnly)) {
-            return -1;
-        }
-
-        // Expand buffer if needed
-        if (m_position + len > m_fileData.size()) {
-            m_fileData.resize(m_position + len);
-        }
-
-        memcpy(m_fileData.data() + m_position, data, len);
-        m_position += len;
-
-        return len;
+        return m_file ? m_file->write(data, len) : -1;
     }
 
     bool seek(qint64 pos) override
     {
-        if (pos < 0 || pos > m_fileData.size()) {
-            return false;
-        }
-        m_position = pos;
-        return true;
+        return m_file && m_file->seek(pos);
     }
 
     qint64 size() const override
     {
-        if (m_openMode != QIODevice::NotOpen) {
-            return m_fileData.size();
+        if (m_file) {
+            return m_file->size();
         }
         return m_fs->fileSize(m_fileName);
     }
 
     qint64 pos() const override
     {
-        return m_position;
+        return m_file ? m_file->pos() : 0;
     }
 
     bool remove() override
@@ -266,9 +219,7 @@ public:
 private:
     QString m_fileName;
     SimpleFATInterface *m_fs;
-    QByteArray m_fileData;
-    qint64 m_position;
-    QIODevice::OpenMode m_openMode;
+    QScopedPointer<QIODevice> m_file;
 };
 
 /**
@@ -380,6 +331,21 @@ public:
         return m_files.value(path).size();
     }
 
+    QIODevice *openFile(const QString &path, QIODevice::OpenMode mode) override
+    {
+        if (!(mode & QIODevice::WriteOnly) && !m_files.contains(path)) {
+            return nullptr;
+        }
+
+        // QBuffer operates on the stored QByteArray in place, like QFATFile does on the image
+        QBuffer *buffer = new QBuffer(&m_files[path]);
+        if (!buffer->open(mode)) {
+            delete buffer;
+            return nullptr;
+        }
+        return buffer;
+    }
+
 private:
     QMap<QString, QByteArray> m_files;
 };
@@ -57,9 +57,9 @@ int main(int argc, char *argv[])
 
     // Get filesystem info
     qDebug() << "\n--- Filesystem Information ---";
-    quint32 totalSpace = fs->getTotalSpace(error);
-    quint32 freeSpace = fs->getFreeSpace(error);
-    quint32 usedSpace = totalSpace - freeSpace;
+    quint64 totalSpace = fs->getTotalSpace(error);
+    quint64 freeSpace = fs->getFreeSpace(error);
+    quint64 usedSpace = totalSpace - freeSpace;
 
     qDebug() << "Total space:" << totalSpace << "bytes (" << totalSpace / 1024 << "KB)";
     qDebug() << "Free space:" << freeSpace << "bytes (" << freeSpace / 1024 << "KB)";
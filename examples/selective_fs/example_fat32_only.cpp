@@ -84,8 +84,8 @@ int main(int argc, char *argv[])
 
     // Get filesystem info
     qDebug() << "\n--- Filesystem Information ---";
-    quint32 totalSpace = fs->getTotalSpace(error);
-    quint32 freeSpace = fs->getFreeSpace(error);
+    quint64 totalSpace = fs->getTotalSpace(error);
+    quint64 freeSpace = fs->getFreeSpace(error);
 
     qDebug() << "Total space:" << totalSpace / 1024 / 1024 << "MB";
     qDebug() << "Free space:" << freeSpace / 1024 / 1024 << "MB";
@@ -12,19 +12,49 @@
 #define BPB_RESERVED_SECTORS_OFFSET 0x0E
 #define BPB_NUMBER_OF_FATS_OFFSET 0x10
 #define BPB_ROOT_ENTRY_COUNT_OFFSET 0x11
+#define BPB_TOTAL_SECTORS_16_OFFSET 0x13 // 0 if the volume needs the 32-bit field
 #define BPB_SECTORS_PER_FAT_OFFSET 0x16 // FAT12/FAT16 only (2 bytes)
+#define BPB_TOTAL_SECTORS_32_OFFSET 0x20
 #define BPB_SECTORS_PER_FAT32_OFFSET 0x24 // FAT32 (4 bytes)
 #define BPB_ROOT_DIRECTORY_CLUSTER_OFFSET 0x2C
+#define BPB_FSINFO_SECTOR_OFFSET 0x30 // FAT32 (2 bytes)
+
+// ============================================================================
+// FAT32 FSInfo sector constants
+// ============================================================================
+#define FSINFO_LEAD_SIGNATURE 0x41615252
+#define FSINFO_STRUCT_SIGNATURE 0x61417272
+#define FSINFO_TRAIL_SIGNATURE 0xAA550000
+#define FSINFO_LEAD_SIGNATURE_OFFSET 0x000
+#define FSINFO_STRUCT_SIGNATURE_OFFSET 0x1E4
+#define FSINFO_FREE_COUNT_OFFSET 0x1E8
+#define FSINFO_NEXT_FREE_OFFSET 0x1EC
+#define FSINFO_TRAIL_SIGNATURE_OFFSET 0x1FC
+#define FSINFO_UNKNOWN 0xFFFFFFFF // Free count or next-free hint not known
+
+#define BOOT_SECTOR_SIZE 512
+#define MIN_BYTES_PER_SECTOR 512
+#define MAX_BYTES_PER_SECTOR 4096
+
+// Highest cluster number that is not a reserved/bad marker
+#define FAT12_MAX_CLUSTER 0x0FF6
+#define FAT16_MAX_CLUSTER 0xFFF6
+#define FAT32_MAX_CLUSTER 0x0FFFFFF6
 
 // ============================================================================
 // Data area constants
 // ============================================================================
 #define DATA_AREA_SIZE 64 * 1024 // 64KB per data area
+#define STREAM_CHUNK_SIZE (1024 * 1024) // Buffer size for streaming file contents in and out
+#define STREAM_READ_TIMEOUT_MS 30000 // How long to wait for more data from a sequential source
+#define STREAM_WRITE_TIMEOUT_MS 30000 // How long to wait for a buffering sink to drain
 
 // ============================================================================
 // Entry constants
 // ============================================================================
 #define ENTRY_SIZE 32 // 32 bytes per entry
+#define ENTRY_MAX_FILE_SIZE 0xFFFFFFFFULL // File sizes are stored in 32 bits
+#define MAX_DIRECTORY_SIZE (65536 * ENTRY_SIZE) // A directory holds at most 65536 entries
 
 #define ENTRY_END_OF_DIRECTORY 0x00
 #define ENTRY_DELETED 0xE5
@@ -54,6 +84,8 @@
 #define ENTRY_ATTRIBUTE_DIRECTORY 0x10
 #define ENTRY_ATTRIBUTE_ARCHIVE 0x20
 #define ENTRY_ATTRIBUTE_LONG_FILE_NAME 0x0F
+#define ENTRY_ATTRIBUTE_LONG_FILE_NAME_MASK 0x3F // Bits compared against ENTRY_ATTRIBUTE_LONG_FILE_NAME
+#define ENTRY_ATTRIBUTE_CHANGEABLE (ENTRY_ATTRIBUTE_READ_ONLY | ENTRY_ATTRIBUTE_HIDDEN | ENTRY_ATTRIBUTE_SYSTEM | ENTRY_ATTRIBUTE_ARCHIVE)
 
 #define ENTRY_DATE_TIME_START_OF_YEAR 1980
 
@@ -64,6 +96,7 @@
 #define ENTRY_LFN_CHARS 13 // 13 characters per part
 #define ENTRY_LFN_PART1_OFFSET 0x01
 #define ENTRY_LFN_PART1_LENGTH 10
+#define ENTRY_LFN_CHECKSUM_OFFSET 0x0D // Checksum of the short name the part belongs to
 #define ENTRY_LFN_PART2_OFFSET 0x0E
 #define ENTRY_LFN_PART2_LENGTH 12
 #define ENTRY_LFN_PART3_OFFSET 0x1C
@@ -80,3 +113,11 @@
 #define MASK_6_BITS 0x3F
 #define MASK_7_BITS 0x7F
 #define MASK_8_BITS 0xFF
+
+// ============================================================================
+// Cache constants
+// ============================================================================
+#define EXTENT_CACHE_MAX_COST 65536 // Total number of extents kept across all cached chains
+#define DIRECTORY_INDEX_CACHE_MAX_COST (4 * 65536) // Total number of entries kept across all indexed directories
+#define PATH_CACHE_MAX_ENTRIES 4096 // Resolved paths, positive and negative
+#define BLOCK_CACHE_DEFAULT_SIZE (1024 * 1024) // Default block cache budget in bytes
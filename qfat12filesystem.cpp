@@ -8,87 +8,47 @@
 // ============================================================================
 
 QFAT12FileSystem::QFAT12FileSystem(QSharedPointer<QIODevice> device)
-    : QFATFileSystem(device)
+    : QFATFileSystem(device, QFATType::FAT12)
 {
 }
 
-QScopedPointer<QFAT12FileSystem> QFAT12FileSystem::create(const QString &imagePath)
+QScopedPointer<QFAT12FileSystem> QFAT12FileSystem::create(const QString &imagePath, QFATMountMode mode)
 {
+    bool mapped = (mode == QFATMountMode::MappedReadOnly);
     QSharedPointer<QFile> file(new QFile(imagePath));
-    if (!file->open(QIODevice::ReadWrite)) {
+    if (!file->open(mapped ? QIODevice::ReadOnly : QIODevice::ReadWrite)) {
         qWarning() << "Failed to open FAT12 image:" << imagePath;
         return QScopedPointer<QFAT12FileSystem>();
     }
 
-    return QScopedPointer<QFAT12FileSystem>(new QFAT12FileSystem(file));
-}
-
-quint16 QFAT12FileSystem::readRootDirSector()
-{
-    quint16 reservedSectors = readReservedSectors();
-    quint8 numFATs = readNumberOfFATs();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
+    QFAT12FileSystem *fs = new QFAT12FileSystem(file);
+    if (mapped && !fs->mapImage()) {
+        qWarning() << "Failed to map FAT12 image:" << imagePath;
+        delete fs;
+        return QScopedPointer<QFAT12FileSystem>();
+    }
 
-    return reservedSectors + (numFATs * sectorsPerFAT);
+    return QScopedPointer<QFAT12FileSystem>(fs);
 }
 
-quint32 QFAT12FileSystem::calculateRootDirOffset()
+quint64 QFAT12FileSystem::calculateRootDirOffset()
 {
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 rootDirSector = readRootDirSector();
-
-    return rootDirSector * bytesPerSector;
+    return m_geometry.rootDirOffset;
 }
 
-quint32 QFAT12FileSystem::calculateClusterOffset(quint16 cluster)
+quint64 QFAT12FileSystem::calculateClusterOffset(quint16 cluster)
 {
     if (cluster < 2) {
         return 0;
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint16 reservedSectors = readReservedSectors();
-    quint8 numFATs = readNumberOfFATs();
-    quint16 rootEntryCount = readRootEntryCount();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 rootDirSectors = ((rootEntryCount * 32) + (bytesPerSector - 1)) / bytesPerSector;
-    quint32 firstDataSector = reservedSectors + (numFATs * sectorsPerFAT) + rootDirSectors;
-    quint32 clusterSector = firstDataSector + ((cluster - 2) * sectorsPerCluster);
-
-    return clusterSector * bytesPerSector;
+    return m_geometry.clusterOffset(cluster);
 }
 
 quint16 QFAT12FileSystem::readNextCluster(quint16 cluster)
 {
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-
-    // FAT12 uses 12-bit entries, so we need special handling
-    // Every 3 bytes contain 2 FAT entries
-    quint32 fatOffset = reservedSectors * bytesPerSector;
-    quint32 entryOffset = cluster + (cluster / 2); // cluster * 1.5
-    quint32 absoluteOffset = fatOffset + entryOffset;
-
-    m_stream.device()->seek(absoluteOffset);
-    quint16 value;
-    m_stream >> value;
-
-    // Extract the 12-bit value
-    if (cluster & 1) {
-        // Odd cluster number - use high 12 bits
-        value = value >> 4;
-    } else {
-        // Even cluster number - use low 12 bits
-        value = value & 0x0FFF;
-    }
+    // FAT12 uses 12-bit entries, every 3 bytes contain 2 FAT entries
+    quint16 value = static_cast<quint16>(readFATEntry(cluster));
 
     // Check for end of chain markers
     if (value >= 0x0FF8) {
@@ -105,11 +65,7 @@ quint16 QFAT12FileSystem::readNextCluster(quint16 cluster)
 
 QList<QFATFileInfo> QFAT12FileSystem::listRootDirectory()
 {
-    quint32 rootDirOffset = calculateRootDirOffset();
-    quint16 rootEntryCount = readRootEntryCount();
-    quint32 rootDirSize = rootEntryCount * 32;
-
-    return readDirectoryEntries(rootDirOffset, rootDirSize);
+    return readDirectoryEntries(m_geometry.rootDirOffset, m_geometry.rootDirSize);
 }
 
 QList<QFATFileInfo> QFAT12FileSystem::listDirectory(const QString &path)
@@ -126,25 +82,11 @@ QList<QFATFileInfo> QFAT12FileSystem::listDirectory(const QString &path)
 
 QList<QFATFileInfo> QFAT12FileSystem::listDirectory(quint16 cluster)
 {
-    QList<QFATFileInfo> entries;
-
-    if (cluster < 2) {
-        return entries;
-    }
-
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
-
-    QList<quint16> clusters = getClusterChain(cluster);
-
-    for (quint16 c : clusters) {
-        quint32 clusterOffset = calculateClusterOffset(c);
-        QList<QFATFileInfo> clusterEntries = readDirectoryEntries(clusterOffset, clusterSize);
-        entries.append(clusterEntries);
+    if (!m_device->isOpen() || cluster < 2) {
+        return QList<QFATFileInfo>();
     }
 
-    return entries;
+    return readDirectoryChain(cluster);
 }
 
 QFATFileInfo QFAT12FileSystem::findFileByPath(const QString &path, QFATError &error)
@@ -164,28 +106,38 @@ QFATFileInfo QFAT12FileSystem::findFileByPath(const QString &path, QFATError &er
         return QFATFileInfo();
     }
 
-    QList<QFATFileInfo> currentDir = listRootDirectory();
+    // Repeated lookups of the same path, hits and misses alike, are answered from the path cache
+    QString cacheKey = pathCacheKey(parts);
+    QFATFileInfo cached;
+    if (lookupPathCache(cacheKey, cached, error)) {
+        return cached;
+    }
+
+    // Start from root directory, each component is a hashed lookup in its directory index
+    QList<quint32> directories;
+    quint32 dirCluster = 0;
 
     for (int i = 0; i < parts.size(); i++) {
-        QFATFileInfo found = findInDirectory(currentDir, parts[i]);
+        directories.append(directoryKey(dirCluster));
+        QFATFileInfo found = findInDirectory(dirCluster, parts[i]);
 
         if (found.name.isEmpty()) {
             error = (i < parts.size() - 1) ? QFATError::DirectoryNotFound : QFATError::FileNotFound;
             m_lastError = error;
-            return QFATFileInfo();
+            return cachePathResult(cacheKey, QFATFileInfo(), error, directories);
         }
 
         if (i == parts.size() - 1) {
-            return found;
+            return cachePathResult(cacheKey, found, error, directories);
         }
 
         if (!found.isDirectory) {
             error = QFATError::DirectoryNotFound;
             m_lastError = error;
-            return QFATFileInfo();
+            return cachePathResult(cacheKey, QFATFileInfo(), error, directories);
         }
 
-        currentDir = listDirectory(static_cast<quint16>(found.cluster));
+        dirCluster = found.cluster;
     }
 
     error = QFATError::FileNotFound;
@@ -197,20 +149,8 @@ QList<quint16> QFAT12FileSystem::getClusterChain(quint16 startCluster)
 {
     QList<quint16> chain;
 
-    if (startCluster < 2) {
-        return chain;
-    }
-
-    quint16 currentCluster = startCluster;
-    const int maxClusters = 0x0FF0;
-
-    while (currentCluster >= 2 && currentCluster < 0x0FF8 && chain.size() < maxClusters) {
-        chain.append(currentCluster);
-        currentCluster = readNextCluster(currentCluster);
-
-        if (currentCluster == 0) {
-            break;
-        }
+    for (quint32 cluster : expandExtents(getClusterExtents(startCluster))) {
+        chain.append(static_cast<quint16>(cluster));
     }
 
     return chain;
@@ -218,32 +158,14 @@ QList<quint16> QFAT12FileSystem::getClusterChain(quint16 startCluster)
 
 QByteArray QFAT12FileSystem::readClusterChain(quint16 startCluster, quint32 fileSize)
 {
-    QByteArray data;
-
     if (startCluster < 2 || fileSize == 0) {
-        return data;
+        return QByteArray();
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-
-    QList<quint16> clusters = getClusterChain(startCluster);
-    quint32 bytesRead = 0;
-
-    for (quint16 cluster : clusters) {
-        quint32 clusterOffset = calculateClusterOffset(cluster);
-        m_stream.device()->seek(clusterOffset);
-
-        quint32 bytesToRead = qMin(clusterSize, fileSize - bytesRead);
-        QByteArray clusterData(bytesToRead, 0);
-        m_stream.readRawData(clusterData.data(), bytesToRead);
-        data.append(clusterData);
-
-        bytesRead += bytesToRead;
-        if (bytesRead >= fileSize) {
-            break;
-        }
+    // Pre-sized buffer filled with one read per run of consecutive clusters
+    QByteArray data = readClusterRange(startCluster, 0, fileSize);
+    if (static_cast<quint32>(data.size()) < fileSize) {
+        qWarning() << "Short read of cluster chain starting at" << startCluster << ":" << data.size() << "of" << fileSize << "bytes";
     }
 
     return data;
@@ -296,14 +218,21 @@ QByteArray QFAT12FileSystem::readFilePartial(const QString &path, quint32 offset
         return QByteArray();
     }
 
-    if (offset >= fileInfo.size) {
+    if (offset >= fileInfo.size || fileInfo.cluster < 2) {
         return QByteArray();
     }
 
     quint32 actualLength = qMin(length, fileInfo.size - offset);
-    QByteArray fullData = readClusterChain(static_cast<quint16>(fileInfo.cluster), fileInfo.size);
 
-    return fullData.mid(offset, actualLength);
+    // Read only the clusters covering the requested range
+    QByteArray data = readClusterRange(fileInfo.cluster, offset, actualLength);
+    if (static_cast<quint32>(data.size()) != actualLength) {
+        error = QFATError::ReadError;
+        m_lastError = error;
+        return QByteArray();
+    }
+
+    return data;
 }
 
 bool QFAT12FileSystem::exists(const QString &path)
@@ -324,57 +253,10 @@ QFATFileInfo QFAT12FileSystem::getFileInfo(const QString &path, QFATError &error
 }
 
 // FAT12 Write Operations
-quint16 QFAT12FileSystem::findFreeCluster()
-{
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 totalClusters = (sectorsPerFAT * bytesPerSector * 2) / 3; // 1.5 bytes per FAT12 entry
-
-    // Start from cluster 2 (first valid data cluster)
-    for (quint16 cluster = 2; cluster < totalClusters && cluster < 0x0FF0; cluster++) {
-        quint16 nextCluster = readNextCluster(cluster);
-        if (nextCluster == 0) {
-            return cluster;
-        }
-    }
-
-    return 0; // No free clusters
-}
-
 bool QFAT12FileSystem::writeNextCluster(quint16 cluster, quint16 value)
 {
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-
-    // FAT12 uses 12-bit entries, so we need special handling
-    quint32 fatOffset = reservedSectors * bytesPerSector;
-    quint32 entryOffset = cluster + (cluster / 2); // cluster * 1.5
-    quint32 absoluteOffset = fatOffset + entryOffset;
-
-    // Read current value (need 2 bytes to handle 12-bit entry)
-    m_stream.device()->seek(absoluteOffset);
-    quint16 current;
-    m_stream >> current;
-
-    // Modify the 12-bit value
-    if (cluster & 1) {
-        // Odd cluster number - modify high 12 bits
-        current = (current & 0x000F) | ((value & 0x0FFF) << 4);
-    } else {
-        // Even cluster number - modify low 12 bits
-        current = (current & 0xF000) | (value & 0x0FFF);
-    }
-
-    // Write back
-    m_stream.device()->seek(absoluteOffset);
-    m_stream << current;
-
-    return m_stream.status() == QDataStream::Ok;
+    // FAT12 uses 12-bit entries, the neighbouring entry's nibble is preserved
+    return writeFATEntry(cluster, value & 0x0FFF);
 }
 
 bool QFAT12FileSystem::writeClusterData(quint16 cluster, const QByteArray &data, quint32 offset)
@@ -383,17 +265,16 @@ bool QFAT12FileSystem::writeClusterData(quint16 cluster, const QByteArray &data,
         return false;
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
+    quint32 clusterSize = m_geometry.clusterSize;
 
     if (offset + data.size() > clusterSize) {
         return false;
     }
 
-    quint32 clusterOffset = calculateClusterOffset(cluster);
+    quint64 clusterOffset = calculateClusterOffset(cluster);
     m_stream.device()->seek(clusterOffset + offset);
     m_stream.writeRawData(data.constData(), data.size());
+    invalidateDirectoryCaches(clusterOffset + offset);
 
     return m_stream.status() == QDataStream::Ok;
 }
@@ -402,20 +283,9 @@ QList<quint16> QFAT12FileSystem::allocateClusterChain(quint32 numClusters)
 {
     QList<quint16> chain;
 
-    for (quint32 i = 0; i < numClusters; i++) {
-        quint16 cluster = findFreeCluster();
-        if (cluster == 0) {
-            // Out of space - free what we allocated
-            freeClusterChain(chain.isEmpty() ? 0 : chain.first());
-            return QList<quint16>();
-        }
-
-        if (!chain.isEmpty()) {
-            writeNextCluster(chain.last(), cluster);
-        }
-
-        writeNextCluster(cluster, 0x0FFF); // Mark as end of chain
-        chain.append(cluster);
+    // Clusters come from the shared free cluster map, already linked and terminated
+    for (quint32 cluster : allocateClusters(numClusters)) {
+        chain.append(static_cast<quint16>(cluster));
     }
 
     return chain;
@@ -475,9 +345,7 @@ bool QFAT12FileSystem::writeFile(const QString &path, const QByteArray &data, QF
     error = QFATError::None;
 
     // Calculate required clusters
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+    quint32 clusterSize = m_geometry.clusterSize;
     quint32 numClusters = (data.size() + clusterSize - 1) / clusterSize;
 
     // Free old cluster chain if file exists
@@ -486,11 +354,11 @@ bool QFAT12FileSystem::writeFile(const QString &path, const QByteArray &data, QF
     }
 
     // Allocate new cluster chain (only if we have data)
-    QList<quint16> clusters;
+    QList<quint32> clusters;
     quint16 firstCluster = 0;
 
     if (numClusters > 0) {
-        clusters = allocateClusterChain(numClusters);
+        clusters = allocateClusters(numClusters);
         if (clusters.isEmpty()) {
             error = QFATError::InsufficientSpace;
             m_lastError = error;
@@ -499,24 +367,11 @@ bool QFAT12FileSystem::writeFile(const QString &path, const QByteArray &data, QF
         firstCluster = clusters.first();
 
         // Write data to clusters
-        quint32 bytesWritten = 0;
-        for (int i = 0; i < clusters.size(); i++) {
-            quint32 bytesToWrite = qMin(clusterSize, static_cast<quint32>(data.size()) - bytesWritten);
-            QByteArray clusterData = data.mid(bytesWritten, bytesToWrite);
-
-            // Pad cluster with zeros if needed
-            if (clusterData.size() < static_cast<int>(clusterSize)) {
-                clusterData.append(QByteArray(clusterSize - clusterData.size(), 0));
-            }
-
-            if (!writeClusterData(clusters[i], clusterData)) {
-                error = QFATError::WriteError;
-                m_lastError = error;
-                freeClusterChain(clusters.first());
-                return false;
-            }
-
-            bytesWritten += bytesToWrite;
+        if (!writeAllocatedClusters(clusters, data)) {
+            error = QFATError::WriteError;
+            m_lastError = error;
+            freeClusterChain(clusters.first());
+            return false;
         }
     }
 
@@ -669,9 +524,7 @@ bool QFAT12FileSystem::createDirectory(const QString &path, QFATError &error)
     quint16 dirCluster = clusters.first();
 
     // Initialize directory with . and .. entries
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+    quint32 clusterSize = m_geometry.clusterSize;
 
     QByteArray dirData(clusterSize, 0);
     quint8 *dirPtr = reinterpret_cast<quint8*>(dirData.data());
@@ -871,91 +724,15 @@ bool QFAT12FileSystem::renameFile(const QString &oldPath, const QString &newPath
 
 bool QFAT12FileSystem::moveFile(const QString &sourcePath, const QString &destPath, QFATError &error)
 {
-    error = QFATError::None;
-
-    if (!m_device->isOpen()) {
-        error = QFATError::DeviceNotOpen;
-        m_lastError = error;
-        return false;
-    }
-
-    // Check that source exists
-    QFATFileInfo sourceInfo = findFileByPath(sourcePath, error);
-    if (error != QFATError::None) {
-        m_lastError = error;
-        return false;
-    }
-
-    // Check that destination doesn't exist
-    QFATError destCheckError;
-    findFileByPath(destPath, destCheckError);
-    if (destCheckError == QFATError::None) {
-        error = QFATError::InvalidFileName; // Destination already exists
-        m_lastError = error;
+    // Only directory entries change, the data stays in its clusters
+    if (!relocateEntry(sourcePath, destPath, error)) {
         return false;
     }
 
-    // Parse destination path to verify parent exists
-    QStringList destParts = splitPath(destPath);
-    if (destParts.isEmpty()) {
-        error = QFATError::InvalidPath;
-        m_lastError = error;
-        return false;
-    }
-
-    QString destFileName = destParts.last();
-    QString destParentPath;
-
-    if (destParts.size() > 1) {
-        destParts.removeLast();
-        destParentPath = "/" + destParts.join("/");
-
-        // Verify destination parent exists
-        QFATError parentError;
-        QFATFileInfo parentInfo = findFileByPath(destParentPath, parentError);
-        if (parentError != QFATError::None || !parentInfo.isDirectory) {
-            error = QFATError::DirectoryNotFound;
-            m_lastError = error;
-            return false;
-        }
-    } else {
-        destParentPath = "/";
-    }
-
-    // Read source file data
-    QByteArray data;
-    if (!sourceInfo.isDirectory) {
-        data = readFile(sourcePath, error);
-        if (error != QFATError::None) {
-            m_lastError = error;
-            return false;
-        }
-    }
-
-    // Delete source
-    if (sourceInfo.isDirectory) {
-        if (!deleteDirectory(sourcePath, true, error)) {
-            m_lastError = error;
-            return false;
-        }
-    } else {
-        if (!deleteFile(sourcePath, error)) {
-            m_lastError = error;
-            return false;
-        }
-    }
-
-    // Create at destination
-    if (sourceInfo.isDirectory) {
-        if (!createDirectory(destPath, error)) {
-            m_lastError = error;
-            return false;
-        }
-    } else {
-        if (!writeFile(destPath, data, error)) {
-            m_lastError = error;
-            return false;
-        }
+    // The old long name no longer needs its short name mapping, unless the new entry reuses it
+    QString sourceName = splitPath(sourcePath).last().toLower();
+    if (sourceName != splitPath(destPath).last().toLower()) {
+        m_longToShortNameMap.remove(sourceName);
     }
 
     return true;
@@ -963,7 +740,7 @@ bool QFAT12FileSystem::moveFile(const QString &sourcePath, const QString &destPa
 
 // Helper methods
 
-quint32 QFAT12FileSystem::getFreeSpace(QFATError &error)
+quint64 QFAT12FileSystem::getFreeSpace(QFATError &error)
 {
     error = QFATError::None;
 
@@ -973,30 +750,18 @@ quint32 QFAT12FileSystem::getFreeSpace(QFATError &error)
         return 0;
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint16 reservedSectors = readReservedSectors();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 totalClusters = (sectorsPerFAT * bytesPerSector * 2) / 3; // 1.5 bytes per FAT12 entry
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-    quint32 freeClusters = 0;
-
-    // Count free clusters
-    for (quint16 cluster = 2; cluster < totalClusters && cluster < 0x0FF0; cluster++) {
-        quint16 value = readNextCluster(cluster);
-        if (value == 0) {
-            freeClusters++;
-        }
+    // Free clusters are counted once when the free cluster map is built, then kept up to date
+    quint32 freeClusters;
+    if (!freeClusterCount(freeClusters)) {
+        error = QFATError::ReadError;
+        m_lastError = error;
+        return 0;
     }
 
-    return freeClusters * clusterSize;
+    return static_cast<quint64>(freeClusters) * m_geometry.clusterSize;
 }
 
-quint32 QFAT12FileSystem::getTotalSpace(QFATError &error)
+quint64 QFAT12FileSystem::getTotalSpace(QFATError &error)
 {
     error = QFATError::None;
 
@@ -1006,36 +771,20 @@ quint32 QFAT12FileSystem::getTotalSpace(QFATError &error)
         return 0;
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint16 reservedSectors = readReservedSectors();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 totalClusters = (sectorsPerFAT * bytesPerSector * 2) / 3; // 1.5 bytes per FAT12 entry
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-
     // Usable clusters start from 2
-    quint32 usableClusters = (totalClusters > 2) ? (totalClusters - 2) : 0;
-    if (usableClusters > 0x0FF0 - 2) {
-        usableClusters = 0x0FF0 - 2;
-    }
-
-    return usableClusters * clusterSize;
+    return static_cast<quint64>(m_geometry.clusterCount) * m_geometry.clusterSize;
 }
 
 // Helper methods
 bool QFAT12FileSystem::updateDirectoryEntry(const QString &parentPath, const QFATFileInfo &fileInfo)
 {
     // Find the directory
-    quint32 dirOffset;
+    quint64 dirOffset;
     quint32 maxEntries;
 
     if (parentPath.isEmpty() || parentPath == "/" || parentPath == "\\") {
-        dirOffset = calculateRootDirOffset();
-        maxEntries = readRootEntryCount();
+        dirOffset = m_geometry.rootDirOffset;
+        maxEntries = m_geometry.rootEntryCount;
     } else {
         QFATError error;
         QFATFileInfo dirInfo = findFileByPath(parentPath, error);
@@ -1045,9 +794,7 @@ bool QFAT12FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
         dirOffset = calculateClusterOffset(static_cast<quint16>(dirInfo.cluster));
 
         // For cluster-based directories, calculate max entries per cluster
-        quint16 bytesPerSector = readBytesPerSector();
-        quint8 sectorsPerCluster = readSectorsPerCluster();
-        quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+        quint32 clusterSize = m_geometry.clusterSize;
         maxEntries = clusterSize / ENTRY_SIZE;
     }
 
@@ -1059,8 +806,8 @@ bool QFAT12FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
     int totalEntriesNeeded = lfnEntriesNeeded + 1;
 
     // Find existing entry by name, or find consecutive free slots
-    quint32 entryOffset = dirOffset;
-    quint32 freeSlotOffset = 0;
+    quint64 entryOffset = dirOffset;
+    quint64 freeSlotOffset = 0;
     int consecutiveFreeSlots = 0;
     bool foundExisting = false;
     bool foundFree = false;
@@ -1139,7 +886,7 @@ bool QFAT12FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
         // Write LFN entries if needed, followed by short name entry
         if (needsLFN) {
             quint8 checksum = calculateLFNChecksum(fileInfo.name);
-            quint32 currentOffset = freeSlotOffset;
+            quint64 currentOffset = freeSlotOffset;
 
             // Write LFN entries in reverse order
             for (int seq = lfnEntriesNeeded; seq >= 1; seq--) {
@@ -1148,6 +895,7 @@ bool QFAT12FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
 
                 m_stream.device()->seek(currentOffset);
                 m_stream.writeRawData(reinterpret_cast<char*>(lfnEntry), ENTRY_SIZE);
+                invalidateDirectoryCaches(currentOffset);
 
                 currentOffset += ENTRY_SIZE;
             }
@@ -1183,7 +931,7 @@ bool QFAT12FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
 }
 
 
-bool QFAT12FileSystem::createDirectoryEntry(quint32 dirOffset, const QFATFileInfo &fileInfo)
+bool QFAT12FileSystem::createDirectoryEntry(quint64 dirOffset, const QFATFileInfo &fileInfo)
 {
     quint8 entry[ENTRY_SIZE];
     memset(entry, 0, ENTRY_SIZE);
@@ -1243,6 +991,7 @@ bool QFAT12FileSystem::createDirectoryEntry(quint32 dirOffset, const QFATFileInf
     // Write entry to directory
     m_stream.device()->seek(dirOffset);
     qint64 written = m_stream.writeRawData(reinterpret_cast<char*>(entry), ENTRY_SIZE);
+    invalidateDirectoryCaches(dirOffset);
 
     return written == ENTRY_SIZE;
 }
@@ -1271,12 +1020,12 @@ bool QFAT12FileSystem::deleteDirectoryEntry(const QString &path)
     }
 
     // Find the directory
-    quint32 dirOffset;
+    quint64 dirOffset;
     quint32 maxEntries;
 
     if (parentPath.isEmpty() || parentPath == "/" || parentPath == "\\") {
-        dirOffset = calculateRootDirOffset();
-        maxEntries = readRootEntryCount();
+        dirOffset = m_geometry.rootDirOffset;
+        maxEntries = m_geometry.rootEntryCount;
     } else {
         QFATError error;
         QFATFileInfo dirInfo = findFileByPath(parentPath, error);
@@ -1285,14 +1034,12 @@ bool QFAT12FileSystem::deleteDirectoryEntry(const QString &path)
         }
         dirOffset = calculateClusterOffset(static_cast<quint16>(dirInfo.cluster));
 
-        quint16 bytesPerSector = readBytesPerSector();
-        quint8 sectorsPerCluster = readSectorsPerCluster();
-        quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+        quint32 clusterSize = m_geometry.clusterSize;
         maxEntries = clusterSize / ENTRY_SIZE;
     }
 
     // Find and delete the entry
-    quint32 entryOffset = dirOffset;
+    quint64 entryOffset = dirOffset;
 
     for (quint32 i = 0; i < maxEntries; i++) {
         m_stream.device()->seek(entryOffset);
@@ -1346,6 +1093,7 @@ bool QFAT12FileSystem::deleteDirectoryEntry(const QString &path)
             m_stream.device()->seek(entryOffset);
             quint8 deleted = ENTRY_DELETED;
             m_stream.writeRawData(reinterpret_cast<char*>(&deleted), 1);
+            invalidateDirectoryCaches(entryOffset);
             return true;
         }
 
@@ -1379,12 +1127,12 @@ QString QFAT12FileSystem::modifyDirectoryEntryName(const QString &path, const QS
     }
 
     // Find the directory
-    quint32 dirOffset;
+    quint64 dirOffset;
     quint32 maxEntries;
 
     if (parentPath.isEmpty() || parentPath == "/" || parentPath == "\\") {
-        dirOffset = calculateRootDirOffset();
-        maxEntries = readRootEntryCount();
+        dirOffset = m_geometry.rootDirOffset;
+        maxEntries = m_geometry.rootEntryCount;
     } else {
         QFATError error;
         QFATFileInfo dirInfo = findFileByPath(parentPath, error);
@@ -1393,9 +1141,7 @@ QString QFAT12FileSystem::modifyDirectoryEntryName(const QString &path, const QS
         }
         dirOffset = calculateClusterOffset(static_cast<quint16>(dirInfo.cluster));
 
-        quint16 bytesPerSector = readBytesPerSector();
-        quint8 sectorsPerCluster = readSectorsPerCluster();
-        quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+        quint32 clusterSize = m_geometry.clusterSize;
         maxEntries = clusterSize / ENTRY_SIZE;
     }
 
@@ -1415,7 +1161,7 @@ QString QFAT12FileSystem::modifyDirectoryEntryName(const QString &path, const QS
     QString newShortName = generateShortName(newName, parentEntries);
 
     // Find and update the entry
-    quint32 entryOffset = dirOffset;
+    quint64 entryOffset = dirOffset;
 
     for (quint32 i = 0; i < maxEntries; i++) {
         m_stream.device()->seek(entryOffset);
@@ -1482,6 +1228,7 @@ QString QFAT12FileSystem::modifyDirectoryEntryName(const QString &path, const QS
             // Write back
             m_stream.device()->seek(entryOffset);
             m_stream.writeRawData(reinterpret_cast<char*>(entry), ENTRY_SIZE);
+            invalidateDirectoryCaches(entryOffset);
 
             return newShortName;
         }
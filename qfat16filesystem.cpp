@@ -8,76 +8,44 @@
 // ============================================================================
 
 QFAT16FileSystem::QFAT16FileSystem(QSharedPointer<QIODevice> device)
-    : QFATFileSystem(device)
+    : QFATFileSystem(device, QFATType::FAT16)
 {
 }
 
-QScopedPointer<QFAT16FileSystem> QFAT16FileSystem::create(const QString &imagePath)
+QScopedPointer<QFAT16FileSystem> QFAT16FileSystem::create(const QString &imagePath, QFATMountMode mode)
 {
+    bool mapped = (mode == QFATMountMode::MappedReadOnly);
     QSharedPointer<QFile> file(new QFile(imagePath));
-    if (!file->open(QIODevice::ReadWrite)) {
+    if (!file->open(mapped ? QIODevice::ReadOnly : QIODevice::ReadWrite)) {
         qWarning() << "Failed to open FAT16 image:" << imagePath;
         return QScopedPointer<QFAT16FileSystem>();
     }
 
-    return QScopedPointer<QFAT16FileSystem>(new QFAT16FileSystem(file));
-}
-
-quint16 QFAT16FileSystem::readRootDirSector()
-{
-    // For FAT16, calculate root directory sector
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-    quint8 numFATs = readNumberOfFATs();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
+    QFAT16FileSystem *fs = new QFAT16FileSystem(file);
+    if (mapped && !fs->mapImage()) {
+        qWarning() << "Failed to map FAT16 image:" << imagePath;
+        delete fs;
+        return QScopedPointer<QFAT16FileSystem>();
+    }
 
-    // Root directory starts after reserved sectors + FATs
-    return reservedSectors + (numFATs * sectorsPerFAT);
+    return QScopedPointer<QFAT16FileSystem>(fs);
 }
 
-quint32 QFAT16FileSystem::calculateRootDirOffset()
+quint64 QFAT16FileSystem::calculateRootDirOffset()
 {
-    quint16 rootDirSector = readRootDirSector();
-    quint16 bytesPerSector = readBytesPerSector();
-    return rootDirSector * bytesPerSector;
+    // Root directory starts after reserved sectors + FATs
+    return m_geometry.rootDirOffset;
 }
 
-quint32 QFAT16FileSystem::calculateClusterOffset(quint16 cluster)
+quint64 QFAT16FileSystem::calculateClusterOffset(quint16 cluster)
 {
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint16 reservedSectors = readReservedSectors();
-    quint8 numFATs = readNumberOfFATs();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint16 rootEntryCount = readRootEntryCount();
-    quint32 rootDirSectors = (rootEntryCount * ENTRY_SIZE + bytesPerSector - 1) / bytesPerSector;
-
-    // Data area starts after reserved sectors + FATs + root directory
-    quint32 dataAreaStart = reservedSectors + (numFATs * sectorsPerFAT) + rootDirSectors;
-    quint32 dataAreaOffset = dataAreaStart * bytesPerSector;
-
     // Cluster 2 is first data cluster, so cluster starts at (cluster - 2) * cluster size
-    quint32 clusterOffset = (cluster - 2) * sectorsPerCluster * bytesPerSector;
-
-    return dataAreaOffset + clusterOffset;
+    return m_geometry.clusterOffset(cluster);
 }
 
 quint16 QFAT16FileSystem::readNextCluster(quint16 cluster)
 {
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-    quint16 fatOffset = reservedSectors * bytesPerSector + cluster * 2; // 2 bytes per cluster
-
-    m_stream.device()->seek(fatOffset);
-    quint16 nextCluster;
-    m_stream >> nextCluster;
+    quint16 nextCluster = static_cast<quint16>(readFATEntry(cluster));
 
     // Check for end of cluster chain (0xFFF8-0xFFFF)
     if (nextCluster >= 0xFFF8) {
@@ -94,8 +62,8 @@ QList<QFATFileInfo> QFAT16FileSystem::listRootDirectory()
         return QList<QFATFileInfo>();
     }
 
-    quint32 rootDirOffset = calculateRootDirOffset();
-    quint16 rootEntryCount = readRootEntryCount();
+    quint64 rootDirOffset = m_geometry.rootDirOffset;
+    quint16 rootEntryCount = m_geometry.rootEntryCount;
 
     if (rootEntryCount == 0) {
         rootEntryCount = 512; // Default if not specified
@@ -108,46 +76,11 @@ QList<QFATFileInfo> QFAT16FileSystem::listRootDirectory()
 
 QList<QFATFileInfo> QFAT16FileSystem::listDirectory(quint16 cluster)
 {
-    QList<QFATFileInfo> files;
-
     if (!m_device->isOpen() || cluster < 2) {
-        return files;
-    }
-
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-
-    quint16 currentCluster = cluster;
-    quint32 totalSize = 0;
-    const quint32 maxDirSize = DATA_AREA_SIZE; // Limit directory size to DATA_AREA_SIZE
-
-    // Follow cluster chain
-    while (currentCluster >= 2 && currentCluster < 0xFFF8 && totalSize < maxDirSize) {
-        quint32 clusterOffset = calculateClusterOffset(currentCluster);
-        QList<QFATFileInfo> entries = readDirectoryEntries(clusterOffset, clusterSize);
-
-        bool foundEnd = false;
-        for (const QFATFileInfo &entry : entries) {
-            if (entry.name.isEmpty() && entry.size == 0) {
-                foundEnd = true;
-                break;
-            }
-            files.append(entry);
-        }
-
-        if (foundEnd) {
-            break;
-        }
-
-        totalSize += clusterSize;
-        currentCluster = readNextCluster(currentCluster);
-        if (currentCluster == 0) {
-            break;
-        }
+        return QList<QFATFileInfo>();
     }
 
-    return files;
+    return readDirectoryChain(cluster);
 }
 
 QList<QFATFileInfo> QFAT16FileSystem::listDirectory(const QString &path)
@@ -186,40 +119,49 @@ QFATFileInfo QFAT16FileSystem::findFileByPath(const QString &path, QFATError &er
         return QFATFileInfo();
     }
 
-    // Start from root directory
-    QList<QFATFileInfo> currentDir = listRootDirectory();
+    // Repeated lookups of the same path, hits and misses alike, are answered from the path cache
+    QString cacheKey = pathCacheKey(parts);
+    QFATFileInfo cached;
+    if (lookupPathCache(cacheKey, cached, error)) {
+        return cached;
+    }
+
+    // Start from root directory, each component is a hashed lookup in its directory index
+    QList<quint32> directories;
+    quint32 dirCluster = 0;
 
     // Traverse the path
     for (int i = 0; i < parts.size(); i++) {
-        QFATFileInfo found = findInDirectory(currentDir, parts[i]);
+        directories.append(directoryKey(dirCluster));
+        QFATFileInfo found = findInDirectory(dirCluster, parts[i]);
 
         // If not found by normal means, check the in-memory mapping for files written without LFN
         if (found.name.isEmpty() && m_longToShortNameMap.contains(parts[i].toLower())) {
             QString shortName = m_longToShortNameMap[parts[i].toLower()];
             qDebug() << "[findFileByPath] Using mapping for" << parts[i] << "->" << shortName;
-            found = findInDirectory(currentDir, shortName);
+            found = findInDirectory(dirCluster, shortName);
         }
 
         if (found.name.isEmpty()) {
             error = (i < parts.size() - 1) ? QFATError::DirectoryNotFound : QFATError::FileNotFound;
             m_lastError = error;
-            return QFATFileInfo();
+            return cachePathResult(cacheKey, QFATFileInfo(), error, directories);
         }
 
         // If this is the last component, return it
         if (i == parts.size() - 1) {
-            return found;
+            return cachePathResult(cacheKey, found, error, directories);
         }
 
         // Otherwise, it must be a directory
         if (!found.isDirectory) {
             error = QFATError::DirectoryNotFound;
             m_lastError = error;
-            return QFATFileInfo();
+            return cachePathResult(cacheKey, QFATFileInfo(), error, directories);
         }
 
         // Move to the subdirectory
-        currentDir = listDirectory(static_cast<quint16>(found.cluster));
+        dirCluster = found.cluster;
     }
 
     error = QFATError::FileNotFound;
@@ -231,20 +173,8 @@ QList<quint16> QFAT16FileSystem::getClusterChain(quint16 startCluster)
 {
     QList<quint16> chain;
 
-    if (startCluster < 2) {
-        return chain;
-    }
-
-    quint16 currentCluster = startCluster;
-    const int maxClusters = 65536; // Safety limit
-
-    while (currentCluster >= 2 && currentCluster < 0xFFF8 && chain.size() < maxClusters) {
-        chain.append(currentCluster);
-        currentCluster = readNextCluster(currentCluster);
-
-        if (currentCluster == 0) {
-            break;
-        }
+    for (quint32 cluster : expandExtents(getClusterExtents(startCluster))) {
+        chain.append(static_cast<quint16>(cluster));
     }
 
     return chain;
@@ -252,38 +182,14 @@ QList<quint16> QFAT16FileSystem::getClusterChain(quint16 startCluster)
 
 QByteArray QFAT16FileSystem::readClusterChain(quint16 startCluster, quint32 fileSize)
 {
-    QByteArray data;
-
     if (startCluster < 2 || fileSize == 0) {
-        return data;
+        return QByteArray();
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-
-    QList<quint16> clusters = getClusterChain(startCluster);
-    quint32 bytesRead = 0;
-
-    for (quint16 cluster : clusters) {
-        quint32 clusterOffset = calculateClusterOffset(cluster);
-        m_stream.device()->seek(clusterOffset);
-
-        quint32 bytesToRead = qMin(clusterSize, fileSize - bytesRead);
-        QByteArray clusterData(bytesToRead, 0);
-
-        qint64 actualRead = m_stream.readRawData(clusterData.data(), bytesToRead);
-        if (actualRead <= 0) {
-            qWarning() << "Failed to read cluster" << cluster;
-            break;
-        }
-
-        data.append(clusterData);
-        bytesRead += actualRead;
-
-        if (bytesRead >= fileSize) {
-            break;
-        }
+    // Pre-sized buffer filled with one read per run of consecutive clusters
+    QByteArray data = readClusterRange(startCluster, 0, fileSize);
+    if (static_cast<quint32>(data.size()) < fileSize) {
+        qWarning() << "Short read of cluster chain starting at" << startCluster << ":" << data.size() << "of" << fileSize << "bytes";
     }
 
     return data;
@@ -313,60 +219,19 @@ QByteArray QFAT16FileSystem::readFile(const QString &path, QFATError &error)
     return readClusterChain(static_cast<quint16>(fileInfo.cluster), fileInfo.size);
 }
 
-quint16 QFAT16FileSystem::findFreeCluster()
-{
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 fatOffset = reservedSectors * bytesPerSector;
-    quint32 totalClusters = (sectorsPerFAT * bytesPerSector) / 2; // 2 bytes per FAT16 entry
-
-    // Start from cluster 2 (first valid data cluster)
-    for (quint16 cluster = 2; cluster < totalClusters && cluster < 0xFFF0; cluster++) {
-        m_stream.device()->seek(fatOffset + cluster * 2);
-        quint16 value;
-        m_stream >> value;
-
-        if (value == 0) {
-            return cluster;
-        }
-    }
-
-    return 0; // No free cluster found
-}
-
 bool QFAT16FileSystem::writeNextCluster(quint16 cluster, quint16 value)
 {
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-    quint32 fatOffset = reservedSectors * bytesPerSector + cluster * 2;
-
-    quint8 numFATs = readNumberOfFATs();
-
-    // Write to all FAT copies
-    for (quint8 i = 0; i < numFATs; i++) {
-        m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-        quint16 sectorsPerFAT;
-        m_stream >> sectorsPerFAT;
-
-        quint32 fatCopyOffset = fatOffset + (i * sectorsPerFAT * bytesPerSector);
-        m_stream.device()->seek(fatCopyOffset);
-        m_stream << value;
-    }
-
-    return m_stream.status() == QDataStream::Ok;
+    // Written to all FAT copies, or to the FAT cache when enabled
+    return writeFATEntry(cluster, value);
 }
 
 bool QFAT16FileSystem::writeClusterData(quint16 cluster, const QByteArray &data, quint32 offset)
 {
-    quint32 clusterOffset = calculateClusterOffset(cluster);
+    quint64 clusterOffset = calculateClusterOffset(cluster);
     m_stream.device()->seek(clusterOffset + offset);
 
     qint64 written = m_stream.writeRawData(data.constData(), data.size());
+    invalidateDirectoryCaches(clusterOffset + offset);
     return written == data.size();
 }
 
@@ -374,35 +239,9 @@ QList<quint16> QFAT16FileSystem::allocateClusterChain(quint32 numClusters)
 {
     QList<quint16> chain;
 
-    if (numClusters == 0) {
-        return chain;
-    }
-
-    // Find and allocate clusters
-    for (quint32 i = 0; i < numClusters; i++) {
-        quint16 freeCluster = findFreeCluster();
-        if (freeCluster == 0) {
-            // No more free clusters, free what we allocated and return empty
-            if (!chain.isEmpty()) {
-                freeClusterChain(chain.first());
-            }
-            return QList<quint16>();
-        }
-
-        chain.append(freeCluster);
-
-        // Mark cluster as used (write 0xFFFF for end of chain, or link to next)
-        if (i == numClusters - 1) {
-            writeNextCluster(freeCluster, 0xFFFF); // End of chain
-        } else {
-            // We'll update this once we know the next cluster
-            writeNextCluster(freeCluster, 0xFFFF);
-        }
-    }
-
-    // Link the chain
-    for (int i = 0; i < chain.size() - 1; i++) {
-        writeNextCluster(chain[i], chain[i + 1]);
+    // Clusters come from the shared free cluster map, already linked and terminated
+    for (quint32 cluster : allocateClusters(numClusters)) {
+        chain.append(static_cast<quint16>(cluster));
     }
 
     return chain;
@@ -421,7 +260,7 @@ bool QFAT16FileSystem::freeClusterChain(quint16 startCluster)
     return true;
 }
 
-bool QFAT16FileSystem::createDirectoryEntry(quint32 dirOffset, const QFATFileInfo &fileInfo)
+bool QFAT16FileSystem::createDirectoryEntry(quint64 dirOffset, const QFATFileInfo &fileInfo)
 {
     // This is a simplified implementation - doesn't handle long file names
     quint8 entry[ENTRY_SIZE];
@@ -482,6 +321,7 @@ bool QFAT16FileSystem::createDirectoryEntry(quint32 dirOffset, const QFATFileInf
     // Write entry to directory
     m_stream.device()->seek(dirOffset);
     qint64 written = m_stream.writeRawData(reinterpret_cast<char*>(entry), ENTRY_SIZE);
+    invalidateDirectoryCaches(dirOffset);
 
     return written == ENTRY_SIZE;
 }
@@ -489,12 +329,12 @@ bool QFAT16FileSystem::createDirectoryEntry(quint32 dirOffset, const QFATFileInf
 bool QFAT16FileSystem::updateDirectoryEntry(const QString &parentPath, const QFATFileInfo &fileInfo)
 {
     // Find the directory
-    quint32 dirOffset;
+    quint64 dirOffset;
     quint32 maxEntries;
 
     if (parentPath.isEmpty() || parentPath == "/" || parentPath == "\\") {
-        dirOffset = calculateRootDirOffset();
-        maxEntries = readRootEntryCount();
+        dirOffset = m_geometry.rootDirOffset;
+        maxEntries = m_geometry.rootEntryCount;
     } else {
         QFATError error;
         QFATFileInfo dirInfo = findFileByPath(parentPath, error);
@@ -504,9 +344,7 @@ bool QFAT16FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
         dirOffset = calculateClusterOffset(static_cast<quint16>(dirInfo.cluster));
 
         // For cluster-based directories, calculate max entries per cluster
-        quint16 bytesPerSector = readBytesPerSector();
-        quint8 sectorsPerCluster = readSectorsPerCluster();
-        quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+        quint32 clusterSize = m_geometry.clusterSize;
         maxEntries = clusterSize / ENTRY_SIZE;
     }
 
@@ -521,8 +359,8 @@ bool QFAT16FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
     int totalEntriesNeeded = lfnEntriesNeeded + 1; // LFN entries + short name entry
 
     // Find existing entry by name, or find consecutive free slots
-    quint32 entryOffset = dirOffset;
-    quint32 freeSlotOffset = 0;
+    quint64 entryOffset = dirOffset;
+    quint64 freeSlotOffset = 0;
     int consecutiveFreeSlots = 0;
     bool foundExisting = false;
     bool foundFree = false;
@@ -605,7 +443,7 @@ bool QFAT16FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
         if (needsLFN) {
             qDebug() << "[updateDirectoryEntry] Writing LFN for" << fileInfo.longName << "short:" << fileInfo.name << "entries:" << lfnEntriesNeeded;
             quint8 checksum = calculateLFNChecksum(fileInfo.name);
-            quint32 currentOffset = freeSlotOffset;
+            quint64 currentOffset = freeSlotOffset;
 
             // Write LFN entries in reverse order (highest sequence first)
             for (int seq = lfnEntriesNeeded; seq >= 1; seq--) {
@@ -614,6 +452,7 @@ bool QFAT16FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
 
                 m_stream.device()->seek(currentOffset);
                 m_stream.writeRawData(reinterpret_cast<char*>(lfnEntry), ENTRY_SIZE);
+                invalidateDirectoryCaches(currentOffset);
 
                 currentOffset += ENTRY_SIZE;
             }
@@ -696,9 +535,7 @@ bool QFAT16FileSystem::writeFile(const QString &path, const QByteArray &data, QF
     error = QFATError::None;
 
     // Calculate required clusters
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+    quint32 clusterSize = m_geometry.clusterSize;
     quint32 numClusters = (data.size() + clusterSize - 1) / clusterSize;
 
     // Free old cluster chain if file exists
@@ -707,11 +544,11 @@ bool QFAT16FileSystem::writeFile(const QString &path, const QByteArray &data, QF
     }
 
     // Allocate new cluster chain (only if we have data)
-    QList<quint16> clusters;
+    QList<quint32> clusters;
     quint16 firstCluster = 0;
 
     if (numClusters > 0) {
-        clusters = allocateClusterChain(numClusters);
+        clusters = allocateClusters(numClusters);
         if (clusters.isEmpty()) {
             error = QFATError::InsufficientSpace;
             m_lastError = error;
@@ -720,24 +557,11 @@ bool QFAT16FileSystem::writeFile(const QString &path, const QByteArray &data, QF
         firstCluster = clusters.first();
 
         // Write data to clusters
-        quint32 bytesWritten = 0;
-        for (int i = 0; i < clusters.size(); i++) {
-            quint32 bytesToWrite = qMin(clusterSize, static_cast<quint32>(data.size()) - bytesWritten);
-            QByteArray clusterData = data.mid(bytesWritten, bytesToWrite);
-
-            // Pad cluster with zeros if needed
-            if (clusterData.size() < static_cast<int>(clusterSize)) {
-                clusterData.append(QByteArray(clusterSize - clusterData.size(), 0));
-            }
-
-            if (!writeClusterData(clusters[i], clusterData)) {
-                error = QFATError::WriteError;
-                m_lastError = error;
-                freeClusterChain(clusters.first());
-                return false;
-            }
-
-            bytesWritten += bytesToWrite;
+        if (!writeAllocatedClusters(clusters, data)) {
+            error = QFATError::WriteError;
+            m_lastError = error;
+            freeClusterChain(clusters.first());
+            return false;
         }
     }
 
@@ -820,12 +644,12 @@ bool QFAT16FileSystem::deleteDirectoryEntry(const QString &path)
     }
 
     // Find the directory offset and max entries
-    quint32 dirOffset;
+    quint64 dirOffset;
     quint32 maxEntries;
 
     if (parentPath.isEmpty() || parentPath == "/" || parentPath == "\\") {
-        dirOffset = calculateRootDirOffset();
-        maxEntries = readRootEntryCount();
+        dirOffset = m_geometry.rootDirOffset;
+        maxEntries = m_geometry.rootEntryCount;
     } else {
         QFATError error;
         QFATFileInfo dirInfo = findFileByPath(parentPath, error);
@@ -835,16 +659,14 @@ bool QFAT16FileSystem::deleteDirectoryEntry(const QString &path)
         dirOffset = calculateClusterOffset(static_cast<quint16>(dirInfo.cluster));
 
         // For cluster-based directories, calculate max entries
-        quint16 bytesPerSector = readBytesPerSector();
-        quint8 sectorsPerCluster = readSectorsPerCluster();
-        quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+        quint32 clusterSize = m_geometry.clusterSize;
         maxEntries = clusterSize / ENTRY_SIZE;
     }
 
     // Scan raw directory data to find the entry
-    quint32 entryOffset = dirOffset;
+    quint64 entryOffset = dirOffset;
     bool found = false;
-    quint32 foundOffset = 0;
+    quint64 foundOffset = 0;
 
     for (quint32 i = 0; i < maxEntries; i++) {
         m_stream.device()->seek(entryOffset);
@@ -912,6 +734,7 @@ bool QFAT16FileSystem::deleteDirectoryEntry(const QString &path)
     m_stream.device()->seek(foundOffset);
     quint8 deletedMarker = ENTRY_DELETED;
     m_stream.writeRawData(reinterpret_cast<char*>(&deletedMarker), 1);
+    invalidateDirectoryCaches(foundOffset);
 
     return m_stream.status() == QDataStream::Ok;
 }
@@ -939,12 +762,12 @@ QString QFAT16FileSystem::modifyDirectoryEntryName(const QString &path, const QS
     }
 
     // Find the directory offset and max entries
-    quint32 dirOffset;
+    quint64 dirOffset;
     quint32 maxEntries;
 
     if (parentPath.isEmpty() || parentPath == "/" || parentPath == "\\") {
-        dirOffset = calculateRootDirOffset();
-        maxEntries = readRootEntryCount();
+        dirOffset = m_geometry.rootDirOffset;
+        maxEntries = m_geometry.rootEntryCount;
     } else {
         QFATError error;
         QFATFileInfo dirInfo = findFileByPath(parentPath, error);
@@ -954,9 +777,7 @@ QString QFAT16FileSystem::modifyDirectoryEntryName(const QString &path, const QS
         dirOffset = calculateClusterOffset(static_cast<quint16>(dirInfo.cluster));
 
         // For cluster-based directories, calculate max entries
-        quint16 bytesPerSector = readBytesPerSector();
-        quint8 sectorsPerCluster = readSectorsPerCluster();
-        quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+        quint32 clusterSize = m_geometry.clusterSize;
         maxEntries = clusterSize / ENTRY_SIZE;
     }
 
@@ -975,9 +796,9 @@ QString QFAT16FileSystem::modifyDirectoryEntryName(const QString &path, const QS
     QString newShortName = generateShortName(newName, existingEntries);
 
     // Scan raw directory data to find the entry
-    quint32 entryOffset = dirOffset;
+    quint64 entryOffset = dirOffset;
     bool found = false;
-    quint32 foundOffset = 0;
+    quint64 foundOffset = 0;
 
     for (quint32 i = 0; i < maxEntries; i++) {
         m_stream.device()->seek(entryOffset);
@@ -1072,6 +893,7 @@ QString QFAT16FileSystem::modifyDirectoryEntryName(const QString &path, const QS
     // Write the modified entry back
     m_stream.device()->seek(foundOffset);
     m_stream.writeRawData(reinterpret_cast<char*>(newEntryData), ENTRY_SIZE);
+    invalidateDirectoryCaches(foundOffset);
 
     if (m_stream.status() != QDataStream::Ok) {
         return QString();
@@ -1200,9 +1022,7 @@ bool QFAT16FileSystem::createDirectory(const QString &path, QFATError &error)
     quint16 dirCluster = clusters.first();
 
     // Initialize directory with . and .. entries
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+    quint32 clusterSize = m_geometry.clusterSize;
 
     QByteArray dirData(clusterSize, 0);
     quint8 *dirPtr = reinterpret_cast<quint8*>(dirData.data());
@@ -1299,16 +1119,15 @@ QByteArray QFAT16FileSystem::readFilePartial(const QString &path, quint32 offset
     // Adjust length if it exceeds file size
     quint32 actualLength = qMin(length, fileInfo.size - offset);
 
-    // Read the entire file first (we can optimize this later to skip clusters)
-    QByteArray fullData = readClusterChain(static_cast<quint16>(fileInfo.cluster), fileInfo.size);
-    if (fullData.isEmpty() && fileInfo.size > 0) {
+    // Read only the clusters covering the requested range
+    QByteArray data = readClusterRange(fileInfo.cluster, offset, actualLength);
+    if (static_cast<quint32>(data.size()) != actualLength) {
         error = QFATError::ReadError;
         m_lastError = error;
         return QByteArray();
     }
 
-    // Return the requested portion
-    return fullData.mid(offset, actualLength);
+    return data;
 }
 
 bool QFAT16FileSystem::renameFile(const QString &oldPath, const QString &newPath, QFATError &error)
@@ -1376,93 +1195,15 @@ bool QFAT16FileSystem::renameFile(const QString &oldPath, const QString &newPath
 
 bool QFAT16FileSystem::moveFile(const QString &sourcePath, const QString &destPath, QFATError &error)
 {
-    error = QFATError::None;
-
-    if (!m_device->isOpen()) {
-        error = QFATError::DeviceNotOpen;
-        m_lastError = error;
-        return false;
-    }
-
-    // Read the file data
-    QFATFileInfo sourceInfo = findFileByPath(sourcePath, error);
-    if (error != QFATError::None) {
-        m_lastError = error;
-        return false;
-    }
-
-    // Check if destination already exists
-    QFATError destError;
-    findFileByPath(destPath, destError);
-    if (destError == QFATError::None) {
-        error = QFATError::InvalidPath; // Destination already exists
-        m_lastError = error;
+    // Only directory entries change, the data stays in its clusters
+    if (!relocateEntry(sourcePath, destPath, error)) {
         return false;
     }
 
-    if (sourceInfo.isDirectory) {
-        // For directories, we need to update the cluster reference
-        // Create new directory entry in destination
-        QStringList destParts = splitPath(destPath);
-        QString destParentPath = destParts.size() > 1 ? "/" + destParts.mid(0, destParts.size() - 1).join("/") : "/";
-
-        // Verify destination parent exists
-        if (destParentPath != "/") {
-            QFATError parentError;
-            QFATFileInfo parentInfo = findFileByPath(destParentPath, parentError);
-            if (parentError != QFATError::None || !parentInfo.isDirectory) {
-                error = QFATError::DirectoryNotFound;
-                m_lastError = error;
-                return false;
-            }
-        }
-
-        // Create new entry with same cluster
-        sourceInfo.longName = destParts.last();
-        if (!updateDirectoryEntry(destParentPath, sourceInfo)) {
-            error = QFATError::WriteError;
-            m_lastError = error;
-            return false;
-        }
-
-        // Delete old entry (but don't free clusters)
-        if (!deleteDirectoryEntry(sourcePath)) {
-            error = QFATError::WriteError;
-            m_lastError = error;
-            return false;
-        }
-    } else {
-        // For files, verify destination parent exists
-        QStringList destParts = splitPath(destPath);
-        QString destParentPath = destParts.size() > 1 ? "/" + destParts.mid(0, destParts.size() - 1).join("/") : "/";
-
-        if (destParentPath != "/") {
-            QFATError parentError;
-            QFATFileInfo parentInfo = findFileByPath(destParentPath, parentError);
-            if (parentError != QFATError::None || !parentInfo.isDirectory) {
-                error = QFATError::DirectoryNotFound;
-                m_lastError = error;
-                return false;
-            }
-        }
-
-        // Read and write to new location
-        QByteArray data = readFile(sourcePath, error);
-        if (error != QFATError::None) {
-            m_lastError = error;
-            return false;
-        }
-
-        if (!writeFile(destPath, data, error)) {
-            m_lastError = error;
-            return false;
-        }
-
-        // Delete source file
-        if (!deleteFile(sourcePath, error)) {
-            m_lastError = error;
-            return false;
-        }
+    // The old long name no longer needs its short name mapping, unless the new entry reuses it
+    QString sourceName = splitPath(sourcePath).last().toLower();
+    if (sourceName != splitPath(destPath).last().toLower()) {
+        m_longToShortNameMap.remove(sourceName);
     }
 
     return true;
@@ -1531,7 +1272,7 @@ bool QFAT16FileSystem::deleteDirectory(const QString &path, bool recursive, QFAT
     return deleteFile(path, error);
 }
 
-quint32 QFAT16FileSystem::getFreeSpace(QFATError &error)
+quint64 QFAT16FileSystem::getFreeSpace(QFATError &error)
 {
     error = QFATError::None;
 
@@ -1541,34 +1282,18 @@ quint32 QFAT16FileSystem::getFreeSpace(QFATError &error)
         return 0;
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint16 reservedSectors = readReservedSectors();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 fatOffset = reservedSectors * bytesPerSector;
-    quint32 totalClusters = (sectorsPerFAT * bytesPerSector) / 2; // 2 bytes per FAT16 entry
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-    quint32 freeClusters = 0;
-
-    // Count free clusters
-    for (quint16 cluster = 2; cluster < totalClusters && cluster < 0xFFF0; cluster++) {
-        m_stream.device()->seek(fatOffset + cluster * 2);
-        quint16 value;
-        m_stream >> value;
-
-        if (value == 0) {
-            freeClusters++;
-        }
+    // Free clusters are counted once when the free cluster map is built, then kept up to date
+    quint32 freeClusters;
+    if (!freeClusterCount(freeClusters)) {
+        error = QFATError::ReadError;
+        m_lastError = error;
+        return 0;
     }
 
-    return freeClusters * clusterSize;
+    return static_cast<quint64>(freeClusters) * m_geometry.clusterSize;
 }
 
-quint32 QFAT16FileSystem::getTotalSpace(QFATError &error)
+quint64 QFAT16FileSystem::getTotalSpace(QFATError &error)
 {
     error = QFATError::None;
 
@@ -1578,20 +1303,7 @@ quint32 QFAT16FileSystem::getTotalSpace(QFATError &error)
         return 0;
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint16 reservedSectors = readReservedSectors();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT_OFFSET);
-    quint16 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 totalClusters = (sectorsPerFAT * bytesPerSector) / 2; // 2 bytes per FAT16 entry
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-
     // Total usable clusters (starting from cluster 2)
-    quint32 usableClusters = totalClusters - 2;
-
-    return usableClusters * clusterSize;
+    return static_cast<quint64>(m_geometry.clusterCount) * m_geometry.clusterSize;
 }
 
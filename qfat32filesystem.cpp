@@ -8,63 +8,45 @@
 // ============================================================================
 
 QFAT32FileSystem::QFAT32FileSystem(QSharedPointer<QIODevice> device)
-    : QFATFileSystem(device)
+    : QFATFileSystem(device, QFATType::FAT32)
 {
 }
 
-QScopedPointer<QFAT32FileSystem> QFAT32FileSystem::create(const QString &imagePath)
+QScopedPointer<QFAT32FileSystem> QFAT32FileSystem::create(const QString &imagePath, QFATMountMode mode)
 {
+    bool mapped = (mode == QFATMountMode::MappedReadOnly);
     QSharedPointer<QFile> file(new QFile(imagePath));
-    if (!file->open(QIODevice::ReadWrite)) {
+    if (!file->open(mapped ? QIODevice::ReadOnly : QIODevice::ReadWrite)) {
         qWarning() << "Failed to open FAT32 image:" << imagePath;
         return QScopedPointer<QFAT32FileSystem>();
     }
 
-    return QScopedPointer<QFAT32FileSystem>(new QFAT32FileSystem(file));
+    QFAT32FileSystem *fs = new QFAT32FileSystem(file);
+    if (mapped && !fs->mapImage()) {
+        qWarning() << "Failed to map FAT32 image:" << imagePath;
+        delete fs;
+        return QScopedPointer<QFAT32FileSystem>();
+    }
+
+    return QScopedPointer<QFAT32FileSystem>(fs);
 }
 
 quint32 QFAT32FileSystem::readRootDirCluster()
 {
     // For FAT32, root directory cluster is stored in the BIOS Parameter Block
-    m_stream.device()->seek(BPB_ROOT_DIRECTORY_CLUSTER_OFFSET);
-    quint32 value;
-    m_stream >> value;
-    return value;
+    return m_geometry.rootDirCluster;
 }
 
-quint32 QFAT32FileSystem::calculateClusterOffset(quint32 cluster)
+quint64 QFAT32FileSystem::calculateClusterOffset(quint32 cluster)
 {
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint16 reservedSectors = readReservedSectors();
-    quint8 numFATs = readNumberOfFATs();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT32_OFFSET);
-    quint32 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    // Calculate data area start
-    quint32 dataAreaStart = reservedSectors + (numFATs * sectorsPerFAT);
-    quint32 dataAreaOffset = dataAreaStart * bytesPerSector;
-
     // Cluster 2 is first data cluster, so cluster starts at (cluster - 2) * cluster size
-    quint32 clusterOffset = (cluster - 2) * sectorsPerCluster * bytesPerSector;
-
-    return dataAreaOffset + clusterOffset;
+    return m_geometry.clusterOffset(cluster);
 }
 
 quint32 QFAT32FileSystem::readNextCluster(quint32 cluster)
 {
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-    quint32 fatOffset = reservedSectors * bytesPerSector + cluster * 4; // 4 bytes per cluster
-
-    m_stream.device()->seek(fatOffset);
-    quint32 nextCluster;
-    m_stream >> nextCluster;
-
-    // Mask off high 4 bits (only use 28 bits for FAT32)
-    nextCluster &= 0x0FFFFFFF;
+    // High 4 bits are masked off (only 28 bits are used for FAT32)
+    quint32 nextCluster = readFATEntry(cluster);
 
     // Check for end of cluster chain (0x0FFFFFF8-0x0FFFFFFF)
     if (nextCluster >= 0x0FFFFFF8) {
@@ -87,46 +69,11 @@ QList<QFATFileInfo> QFAT32FileSystem::listRootDirectory()
 
 QList<QFATFileInfo> QFAT32FileSystem::listDirectory(quint32 cluster)
 {
-    QList<QFATFileInfo> files;
-
     if (!m_device->isOpen() || cluster < 2) {
-        return files;
-    }
-
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-
-    quint32 currentCluster = cluster;
-    quint32 totalSize = 0;
-    const quint32 maxDirSize = DATA_AREA_SIZE; // Limit directory size to DATA_AREA_SIZE
-
-    // Follow cluster chain
-    while (currentCluster >= 2 && currentCluster < 0x0FFFFFF8 && totalSize < maxDirSize) {
-        quint32 clusterOffset = calculateClusterOffset(currentCluster);
-        QList<QFATFileInfo> entries = readDirectoryEntries(clusterOffset, clusterSize);
-
-        bool foundEnd = false;
-        for (const QFATFileInfo &entry : entries) {
-            if (entry.name.isEmpty() && entry.size == 0) {
-                foundEnd = true;
-                break;
-            }
-            files.append(entry);
-        }
-
-        if (foundEnd) {
-            break;
-        }
-
-        totalSize += clusterSize;
-        currentCluster = readNextCluster(currentCluster);
-        if (currentCluster == 0) {
-            break;
-        }
+        return QList<QFATFileInfo>();
     }
 
-    return files;
+    return readDirectoryChain(cluster);
 }
 
 QList<QFATFileInfo> QFAT32FileSystem::listDirectory(const QString &path)
@@ -165,40 +112,49 @@ QFATFileInfo QFAT32FileSystem::findFileByPath(const QString &path, QFATError &er
         return QFATFileInfo();
     }
 
-    // Start from root directory
-    QList<QFATFileInfo> currentDir = listRootDirectory();
+    // Repeated lookups of the same path, hits and misses alike, are answered from the path cache
+    QString cacheKey = pathCacheKey(parts);
+    QFATFileInfo cached;
+    if (lookupPathCache(cacheKey, cached, error)) {
+        return cached;
+    }
+
+    // Start from root directory, each component is a hashed lookup in its directory index
+    QList<quint32> directories;
+    quint32 dirCluster = m_geometry.rootDirCluster;
 
     // Traverse the path
     for (int i = 0; i < parts.size(); i++) {
-        QFATFileInfo found = findInDirectory(currentDir, parts[i]);
+        directories.append(directoryKey(dirCluster));
+        QFATFileInfo found = findInDirectory(dirCluster, parts[i]);
 
         // If not found by normal means, check the in-memory mapping for files written without LFN
         if (found.name.isEmpty() && m_longToShortNameMap.contains(parts[i].toLower())) {
             QString shortName = m_longToShortNameMap[parts[i].toLower()];
             qDebug() << "[findFileByPath] Using mapping for" << parts[i] << "->" << shortName;
-            found = findInDirectory(currentDir, shortName);
+            found = findInDirectory(dirCluster, shortName);
         }
 
         if (found.name.isEmpty()) {
             error = (i < parts.size() - 1) ? QFATError::DirectoryNotFound : QFATError::FileNotFound;
             m_lastError = error;
-            return QFATFileInfo();
+            return cachePathResult(cacheKey, QFATFileInfo(), error, directories);
         }
 
         // If this is the last component, return it
         if (i == parts.size() - 1) {
-            return found;
+            return cachePathResult(cacheKey, found, error, directories);
         }
 
         // Otherwise, it must be a directory
         if (!found.isDirectory) {
             error = QFATError::DirectoryNotFound;
             m_lastError = error;
-            return QFATFileInfo();
+            return cachePathResult(cacheKey, QFATFileInfo(), error, directories);
         }
 
         // Move to the subdirectory
-        currentDir = listDirectory(found.cluster);
+        dirCluster = found.cluster;
     }
 
     error = QFATError::FileNotFound;
@@ -208,61 +164,19 @@ QFATFileInfo QFAT32FileSystem::findFileByPath(const QString &path, QFATError &er
 
 QList<quint32> QFAT32FileSystem::getClusterChain(quint32 startCluster)
 {
-    QList<quint32> chain;
-
-    if (startCluster < 2) {
-        return chain;
-    }
-
-    quint32 currentCluster = startCluster;
-    const int maxClusters = 0x0FFFFFF0; // Safety limit
-
-    while (currentCluster >= 2 && currentCluster < 0x0FFFFFF8 && chain.size() < maxClusters) {
-        chain.append(currentCluster);
-        currentCluster = readNextCluster(currentCluster);
-
-        if (currentCluster == 0) {
-            break;
-        }
-    }
-
-    return chain;
+    return expandExtents(getClusterExtents(startCluster));
 }
 
 QByteArray QFAT32FileSystem::readClusterChain(quint32 startCluster, quint32 fileSize)
 {
-    QByteArray data;
-
     if (startCluster < 2 || fileSize == 0) {
-        return data;
+        return QByteArray();
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-
-    QList<quint32> clusters = getClusterChain(startCluster);
-    quint32 bytesRead = 0;
-
-    for (quint32 cluster : clusters) {
-        quint32 clusterOffset = calculateClusterOffset(cluster);
-        m_stream.device()->seek(clusterOffset);
-
-        quint32 bytesToRead = qMin(clusterSize, fileSize - bytesRead);
-        QByteArray clusterData(bytesToRead, 0);
-
-        qint64 actualRead = m_stream.readRawData(clusterData.data(), bytesToRead);
-        if (actualRead <= 0) {
-            qWarning() << "Failed to read cluster" << cluster;
-            break;
-        }
-
-        data.append(clusterData);
-        bytesRead += actualRead;
-
-        if (bytesRead >= fileSize) {
-            break;
-        }
+    // Pre-sized buffer filled with one read per run of consecutive clusters
+    QByteArray data = readClusterRange(startCluster, 0, fileSize);
+    if (static_cast<quint32>(data.size()) < fileSize) {
+        qWarning() << "Short read of cluster chain starting at" << startCluster << ":" << data.size() << "of" << fileSize << "bytes";
     }
 
     return data;
@@ -292,103 +206,26 @@ QByteArray QFAT32FileSystem::readFile(const QString &path, QFATError &error)
     return readClusterChain(fileInfo.cluster, fileInfo.size);
 }
 
-quint32 QFAT32FileSystem::findFreeCluster()
-{
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT32_OFFSET);
-    quint32 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 fatOffset = reservedSectors * bytesPerSector;
-    quint32 totalClusters = (sectorsPerFAT * bytesPerSector) / 4; // 4 bytes per FAT32 entry
-
-    // Start from cluster 2 (first valid data cluster)
-    for (quint32 cluster = 2; cluster < totalClusters && cluster < 0x0FFFFFF0; cluster++) {
-        m_stream.device()->seek(fatOffset + cluster * 4);
-        quint32 value;
-        m_stream >> value;
-        value &= 0x0FFFFFFF; // Mask high 4 bits
-
-        if (value == 0) {
-            return cluster;
-        }
-    }
-
-    return 0; // No free cluster found
-}
-
 bool QFAT32FileSystem::writeNextCluster(quint32 cluster, quint32 value)
 {
-    quint16 bytesPerSector = readBytesPerSector();
-    quint16 reservedSectors = readReservedSectors();
-    quint32 fatOffset = reservedSectors * bytesPerSector + cluster * 4;
-
-    quint8 numFATs = readNumberOfFATs();
-
-    // Mask to preserve high 4 bits
-    value &= 0x0FFFFFFF;
-
-    // Write to all FAT copies
-    for (quint8 i = 0; i < numFATs; i++) {
-        m_stream.device()->seek(BPB_SECTORS_PER_FAT32_OFFSET);
-        quint32 sectorsPerFAT;
-        m_stream >> sectorsPerFAT;
-
-        quint32 fatCopyOffset = fatOffset + (i * sectorsPerFAT * bytesPerSector);
-        m_stream.device()->seek(fatCopyOffset);
-        m_stream << value;
-    }
-
-    return m_stream.status() == QDataStream::Ok;
+    // Written to all FAT copies (or the FAT cache), preserving the reserved high 4 bits
+    return writeFATEntry(cluster, value);
 }
 
 bool QFAT32FileSystem::writeClusterData(quint32 cluster, const QByteArray &data, quint32 offset)
 {
-    quint32 clusterOffset = calculateClusterOffset(cluster);
+    quint64 clusterOffset = calculateClusterOffset(cluster);
     m_stream.device()->seek(clusterOffset + offset);
 
     qint64 written = m_stream.writeRawData(data.constData(), data.size());
+    invalidateDirectoryCaches(clusterOffset + offset);
     return written == data.size();
 }
 
 QList<quint32> QFAT32FileSystem::allocateClusterChain(quint32 numClusters)
 {
-    QList<quint32> chain;
-
-    if (numClusters == 0) {
-        return chain;
-    }
-
-    // Find and allocate clusters
-    for (quint32 i = 0; i < numClusters; i++) {
-        quint32 freeCluster = findFreeCluster();
-        if (freeCluster == 0) {
-            // No more free clusters, free what we allocated and return empty
-            if (!chain.isEmpty()) {
-                freeClusterChain(chain.first());
-            }
-            return QList<quint32>();
-        }
-
-        chain.append(freeCluster);
-
-        // Mark cluster as used (write 0x0FFFFFFF for end of chain)
-        if (i == numClusters - 1) {
-            writeNextCluster(freeCluster, 0x0FFFFFFF); // End of chain
-        } else {
-            // We'll update this once we know the next cluster
-            writeNextCluster(freeCluster, 0x0FFFFFFF);
-        }
-    }
-
-    // Link the chain
-    for (int i = 0; i < chain.size() - 1; i++) {
-        writeNextCluster(chain[i], chain[i + 1]);
-    }
-
-    return chain;
+    // Clusters come from the shared free cluster map, already linked and terminated
+    return allocateClusters(numClusters);
 }
 
 bool QFAT32FileSystem::freeClusterChain(quint32 startCluster)
@@ -404,7 +241,7 @@ bool QFAT32FileSystem::freeClusterChain(quint32 startCluster)
     return true;
 }
 
-bool QFAT32FileSystem::createDirectoryEntry(quint32 dirOffset, const QFATFileInfo &fileInfo)
+bool QFAT32FileSystem::createDirectoryEntry(quint64 dirOffset, const QFATFileInfo &fileInfo)
 {
     // This is a simplified implementation - doesn't handle long file names
     quint8 entry[ENTRY_SIZE];
@@ -478,12 +315,14 @@ bool QFAT32FileSystem::createDirectoryEntry(quint32 dirOffset, const QFATFileInf
             prevEntry[ENTRY_NAME_OFFSET] = ENTRY_DELETED;
             m_stream.device()->seek(dirOffset - ENTRY_SIZE);
             m_stream.writeRawData(reinterpret_cast<char*>(prevEntry), ENTRY_SIZE);
+            invalidateDirectoryCaches(dirOffset - ENTRY_SIZE);
         }
     }
 
     // Write entry to directory
     m_stream.device()->seek(dirOffset);
     qint64 written = m_stream.writeRawData(reinterpret_cast<char*>(entry), ENTRY_SIZE);
+    invalidateDirectoryCaches(dirOffset);
 
     return written == ENTRY_SIZE;
 }
@@ -505,21 +344,19 @@ bool QFAT32FileSystem::updateDirectoryEntry(const QString &parentPath, const QFA
     }
 
     // For FAT32, all directories are cluster-based and can span multiple clusters
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+    quint32 clusterSize = m_geometry.clusterSize;
     quint32 entriesPerCluster = clusterSize / ENTRY_SIZE;
 
     // Follow the cluster chain to find existing entry or free slot
     quint32 currentCluster = startCluster;
-    quint32 freeSlotOffset = 0;
+    quint64 freeSlotOffset = 0;
     bool foundExisting = false;
     bool foundFree = false;
-    quint32 existingOffset = 0;
+    quint64 existingOffset = 0;
 
     while (currentCluster >= 2 && currentCluster < 0x0FFFFFF8) {
-        quint32 clusterOffset = calculateClusterOffset(currentCluster);
-        quint32 entryOffset = clusterOffset;
+        quint64 clusterOffset = calculateClusterOffset(currentCluster);
+        quint64 entryOffset = clusterOffset;
 
         for (quint32 i = 0; i < entriesPerCluster; i++) {
             m_stream.device()->seek(entryOffset);
@@ -647,9 +484,7 @@ bool QFAT32FileSystem::writeFile(const QString &path, const QByteArray &data, QF
     error = QFATError::None;
 
     // Calculate required clusters
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+    quint32 clusterSize = m_geometry.clusterSize;
     quint32 numClusters = (data.size() + clusterSize - 1) / clusterSize;
 
     // Free old cluster chain if file exists
@@ -671,24 +506,11 @@ bool QFAT32FileSystem::writeFile(const QString &path, const QByteArray &data, QF
         firstCluster = clusters.first();
 
         // Write data to clusters
-        quint32 bytesWritten = 0;
-        for (int i = 0; i < clusters.size(); i++) {
-            quint32 bytesToWrite = qMin(clusterSize, static_cast<quint32>(data.size()) - bytesWritten);
-            QByteArray clusterData = data.mid(bytesWritten, bytesToWrite);
-
-            // Pad cluster with zeros if needed
-            if (clusterData.size() < static_cast<int>(clusterSize)) {
-                clusterData.append(QByteArray(clusterSize - clusterData.size(), 0));
-            }
-
-            if (!writeClusterData(clusters[i], clusterData)) {
-                error = QFATError::WriteError;
-                m_lastError = error;
-                freeClusterChain(clusters.first());
-                return false;
-            }
-
-            bytesWritten += bytesToWrite;
+        if (!writeAllocatedClusters(clusters, data)) {
+            error = QFATError::WriteError;
+            m_lastError = error;
+            freeClusterChain(clusters.first());
+            return false;
         }
     }
 
@@ -784,18 +606,16 @@ bool QFAT32FileSystem::deleteDirectoryEntry(const QString &path)
     }
 
     // Scan through the directory clusters to find the entry
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+    quint32 clusterSize = m_geometry.clusterSize;
     quint32 entriesPerCluster = clusterSize / ENTRY_SIZE;
 
     quint32 currentCluster = startCluster;
     bool found = false;
-    quint32 foundOffset = 0;
+    quint64 foundOffset = 0;
 
     while (currentCluster >= 2 && currentCluster < 0x0FFFFFF8) {
-        quint32 clusterOffset = calculateClusterOffset(currentCluster);
-        quint32 entryOffset = clusterOffset;
+        quint64 clusterOffset = calculateClusterOffset(currentCluster);
+        quint64 entryOffset = clusterOffset;
 
         for (quint32 i = 0; i < entriesPerCluster; i++) {
             m_stream.device()->seek(entryOffset);
@@ -871,6 +691,7 @@ bool QFAT32FileSystem::deleteDirectoryEntry(const QString &path)
     m_stream.device()->seek(foundOffset);
     quint8 deletedMarker = ENTRY_DELETED;
     m_stream.writeRawData(reinterpret_cast<char*>(&deletedMarker), 1);
+    invalidateDirectoryCaches(foundOffset);
 
     return m_stream.status() == QDataStream::Ok;
 }
@@ -932,18 +753,16 @@ QString QFAT32FileSystem::modifyDirectoryEntryName(const QString &path, const QS
     }
 
     // Scan through the directory clusters to find the entry
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+    quint32 clusterSize = m_geometry.clusterSize;
     quint32 entriesPerCluster = clusterSize / ENTRY_SIZE;
 
     quint32 currentCluster = startCluster;
     bool found = false;
-    quint32 foundOffset = 0;
+    quint64 foundOffset = 0;
 
     while (currentCluster >= 2 && currentCluster < 0x0FFFFFF8) {
-        quint32 clusterOffset = calculateClusterOffset(currentCluster);
-        quint32 entryOffset = clusterOffset;
+        quint64 clusterOffset = calculateClusterOffset(currentCluster);
+        quint64 entryOffset = clusterOffset;
 
         for (quint32 i = 0; i < entriesPerCluster; i++) {
             m_stream.device()->seek(entryOffset);
@@ -1041,6 +860,7 @@ QString QFAT32FileSystem::modifyDirectoryEntryName(const QString &path, const QS
     // Write the modified entry back
     m_stream.device()->seek(foundOffset);
     m_stream.writeRawData(reinterpret_cast<char*>(newEntryData), ENTRY_SIZE);
+    invalidateDirectoryCaches(foundOffset);
 
     if (m_stream.status() != QDataStream::Ok) {
         return QString();
@@ -1180,9 +1000,7 @@ bool QFAT32FileSystem::createDirectory(const QString &path, QFATError &error)
     quint32 dirCluster = clusters.first();
 
     // Initialize directory with . and .. entries
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint32 clusterSize = bytesPerSector * sectorsPerCluster;
+    quint32 clusterSize = m_geometry.clusterSize;
 
     QByteArray dirData(clusterSize, 0);
     quint8 *dirPtr = reinterpret_cast<quint8*>(dirData.data());
@@ -1291,16 +1109,15 @@ QByteArray QFAT32FileSystem::readFilePartial(const QString &path, quint32 offset
     // Adjust length if it exceeds file size
     quint32 actualLength = qMin(length, fileInfo.size - offset);
 
-    // Read the entire file first (we can optimize this later to skip clusters)
-    QByteArray fullData = readClusterChain(fileInfo.cluster, fileInfo.size);
-    if (fullData.isEmpty() && fileInfo.size > 0) {
+    // Read only the clusters covering the requested range
+    QByteArray data = readClusterRange(fileInfo.cluster, offset, actualLength);
+    if (static_cast<quint32>(data.size()) != actualLength) {
         error = QFATError::ReadError;
         m_lastError = error;
         return QByteArray();
     }
 
-    // Return the requested portion
-    return fullData.mid(offset, actualLength);
+    return data;
 }
 
 bool QFAT32FileSystem::renameFile(const QString &oldPath, const QString &newPath, QFATError &error)
@@ -1368,93 +1185,15 @@ bool QFAT32FileSystem::renameFile(const QString &oldPath, const QString &newPath
 
 bool QFAT32FileSystem::moveFile(const QString &sourcePath, const QString &destPath, QFATError &error)
 {
-    error = QFATError::None;
-
-    if (!m_device->isOpen()) {
-        error = QFATError::DeviceNotOpen;
-        m_lastError = error;
-        return false;
-    }
-
-    // Read the file data
-    QFATFileInfo sourceInfo = findFileByPath(sourcePath, error);
-    if (error != QFATError::None) {
-        m_lastError = error;
+    // Only directory entries change, the data stays in its clusters
+    if (!relocateEntry(sourcePath, destPath, error)) {
         return false;
     }
 
-    // Check if destination already exists
-    QFATError destError;
-    findFileByPath(destPath, destError);
-    if (destError == QFATError::None) {
-        error = QFATError::InvalidPath; // Destination already exists
-        m_lastError = error;
-        return false;
-    }
-
-    if (sourceInfo.isDirectory) {
-        // For directories, we need to update the cluster reference
-        // Create new directory entry in destination
-        QStringList destParts = splitPath(destPath);
-        QString destParentPath = destParts.size() > 1 ? "/" + destParts.mid(0, destParts.size() - 1).join("/") : "/";
-
-        // Verify destination parent exists
-        if (destParentPath != "/") {
-            QFATError parentError;
-            QFATFileInfo parentInfo = findFileByPath(destParentPath, parentError);
-            if (parentError != QFATError::None || !parentInfo.isDirectory) {
-                error = QFATError::DirectoryNotFound;
-                m_lastError = error;
-                return false;
-            }
-        }
-
-        // Create new entry with same cluster
-        sourceInfo.longName = destParts.last();
-        if (!updateDirectoryEntry(destParentPath, sourceInfo)) {
-            error = QFATError::WriteError;
-            m_lastError = error;
-            return false;
-        }
-
-        // Delete old entry (but don't free clusters)
-        if (!deleteDirectoryEntry(sourcePath)) {
-            error = QFATError::WriteError;
-            m_lastError = error;
-            return false;
-        }
-    } else {
-        // For files, verify destination parent exists
-        QStringList destParts = splitPath(destPath);
-        QString destParentPath = destParts.size() > 1 ? "/" + destParts.mid(0, destParts.size() - 1).join("/") : "/";
-
-        if (destParentPath != "/") {
-            QFATError parentError;
-            QFATFileInfo parentInfo = findFileByPath(destParentPath, parentError);
-            if (parentError != QFATError::None || !parentInfo.isDirectory) {
-                error = QFATError::DirectoryNotFound;
-                m_lastError = error;
-                return false;
-            }
-        }
-
-        // Read and write to new location
-        QByteArray data = readFile(sourcePath, error);
-        if (error != QFATError::None) {
-            m_lastError = error;
-            return false;
-        }
-
-        if (!writeFile(destPath, data, error)) {
-            m_lastError = error;
-            return false;
-        }
-
-        // Delete source file
-        if (!deleteFile(sourcePath, error)) {
-            m_lastError = error;
-            return false;
-        }
+    // The old long name no longer needs its short name mapping, unless the new entry reuses it
+    QString sourceName = splitPath(sourcePath).last().toLower();
+    if (sourceName != splitPath(destPath).last().toLower()) {
+        m_longToShortNameMap.remove(sourceName);
     }
 
     return true;
@@ -1523,7 +1262,7 @@ bool QFAT32FileSystem::deleteDirectory(const QString &path, bool recursive, QFAT
     return deleteFile(path, error);
 }
 
-quint32 QFAT32FileSystem::getFreeSpace(QFATError &error)
+quint64 QFAT32FileSystem::getFreeSpace(QFATError &error)
 {
     error = QFATError::None;
 
@@ -1533,35 +1272,19 @@ quint32 QFAT32FileSystem::getFreeSpace(QFATError &error)
         return 0;
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint16 reservedSectors = readReservedSectors();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT32_OFFSET);
-    quint32 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 fatOffset = reservedSectors * bytesPerSector;
-    quint32 totalClusters = (sectorsPerFAT * bytesPerSector) / 4; // 4 bytes per FAT32 entry
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-    quint32 freeClusters = 0;
-
-    // Count free clusters
-    for (quint32 cluster = 2; cluster < totalClusters && cluster < 0x0FFFFFF0; cluster++) {
-        m_stream.device()->seek(fatOffset + cluster * 4);
-        quint32 value;
-        m_stream >> value;
-        value &= 0x0FFFFFFF; // Mask to 28 bits
-
-        if (value == 0) {
-            freeClusters++;
-        }
+    // Free clusters are counted once when the free cluster map is built, then kept up to date.
+    // FAT32 can take the count from FSInfo instead of scanning.
+    quint32 freeClusters;
+    if (!freeClusterCount(freeClusters)) {
+        error = QFATError::ReadError;
+        m_lastError = error;
+        return 0;
     }
 
-    return freeClusters * clusterSize;
+    return static_cast<quint64>(freeClusters) * m_geometry.clusterSize;
 }
 
-quint32 QFAT32FileSystem::getTotalSpace(QFATError &error)
+quint64 QFAT32FileSystem::getTotalSpace(QFATError &error)
 {
     error = QFATError::None;
 
@@ -1571,19 +1294,6 @@ quint32 QFAT32FileSystem::getTotalSpace(QFATError &error)
         return 0;
     }
 
-    quint16 bytesPerSector = readBytesPerSector();
-    quint8 sectorsPerCluster = readSectorsPerCluster();
-    quint16 reservedSectors = readReservedSectors();
-
-    m_stream.device()->seek(BPB_SECTORS_PER_FAT32_OFFSET);
-    quint32 sectorsPerFAT;
-    m_stream >> sectorsPerFAT;
-
-    quint32 totalClusters = (sectorsPerFAT * bytesPerSector) / 4; // 4 bytes per FAT32 entry
-    quint32 clusterSize = sectorsPerCluster * bytesPerSector;
-
     // Total usable clusters (starting from cluster 2)
-    quint32 usableClusters = totalClusters - 2;
-
-    return usableClusters * clusterSize;
+    return static_cast<quint64>(m_geometry.clusterCount) * m_geometry.clusterSize;
 }
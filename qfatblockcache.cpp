@@ -0,0 +1,589 @@
+#include "qfatfilesystem.h"
+#include "internal_constants.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstring>
+
+// ============================================================================
+// QFATBlockCache
+// ============================================================================
+
+QFATBlockCache::QFATBlockCache(QSharedPointer<QIODevice> device, const QFATVolumeGeometry &geometry, QObject *parent)
+    : QIODevice(parent)
+    , m_device(device)
+    , m_geometry(geometry)
+    , m_blockSize(geometry.valid ? geometry.bytesPerSector : MIN_BYTES_PER_SECTOR)
+    , m_capacity(BLOCK_CACHE_DEFAULT_SIZE)
+    , m_holdMetadata(false)
+    , m_clock(0)
+    , m_position(0)
+    , m_hits(0)
+    , m_misses(0)
+{
+    // Metadata is small and rewritten often, file contents are large and usually touched once
+    m_policies[static_cast<int>(QFATCacheRegion::FAT)] = QFATCachePolicy::WriteBack;
+    m_policies[static_cast<int>(QFATCacheRegion::Directory)] = QFATCachePolicy::WriteBack;
+    m_policies[static_cast<int>(QFATCacheRegion::Data)] = QFATCachePolicy::Bypass;
+
+    if (geometry.valid) {
+        m_directoryClusters.resize(geometry.maxCluster + 1);
+    }
+}
+
+QFATBlockCache::~QFATBlockCache()
+{
+    close();
+}
+
+bool QFATBlockCache::open(OpenMode mode)
+{
+    // The backend is picked once the underlying device is open and has a handle
+    m_blockDevice.reset(QFATBlockDevice::create(m_device));
+
+    // Buffering is what this device does, QIODevice must not add its own on top
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void QFATBlockCache::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    flush();
+    QIODevice::close();
+}
+
+qint64 QFATBlockCache::size() const
+{
+    return m_blockDevice ? m_blockDevice->size() : m_device->size();
+}
+
+bool QFATBlockCache::seek(qint64 pos)
+{
+    if (!QIODevice::seek(pos)) {
+        return false;
+    }
+
+    m_position = pos;
+    return true;
+}
+
+bool QFATBlockCache::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    return flushBlocks();
+}
+
+bool QFATBlockCache::flushRegion(QFATCacheRegion region)
+{
+    QMutexLocker locker(&m_mutex);
+    return flushBlocks(static_cast<int>(region));
+}
+
+bool QFATBlockCache::sync()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_blockDevice && m_blockDevice->sync();
+}
+
+void QFATBlockCache::setHoldMetadata(bool hold)
+{
+    QMutexLocker locker(&m_mutex);
+    m_holdMetadata = hold;
+}
+
+void QFATBlockCache::discardWrites()
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_blocks.begin(); it != m_blocks.end();) {
+        if (it.value().dirty) {
+            m_lru.remove(it.value().lastUse);
+            it = m_blocks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool QFATBlockCache::flushBlocks(int region)
+{
+    // Without a region everything goes except held blocks, with one exactly that region goes
+    QList<quint64> dirty;
+    for (auto it = m_blocks.constBegin(); it != m_blocks.constEnd(); ++it) {
+        if (!it.value().dirty) {
+            continue;
+        }
+        quint64 position = it.key() * m_blockSize;
+        if (region < 0 ? holds(position) : static_cast<int>(regionAt(position)) != region) {
+            continue;
+        }
+        dirty.append(it.key());
+    }
+    std::sort(dirty.begin(), dirty.end());
+
+    // Consecutive full blocks go out with a single write
+    bool ok = true;
+    int i = 0;
+    while (i < dirty.size()) {
+        int runEnd = i + 1;
+        QByteArray run = m_blocks[dirty[i]].data;
+        while (runEnd < dirty.size() && dirty[runEnd] == dirty[runEnd - 1] + 1
+               && m_blocks[dirty[runEnd - 1]].data.size() == static_cast<int>(m_blockSize)) {
+            run.append(m_blocks[dirty[runEnd]].data);
+            runEnd++;
+        }
+
+        if (writeDevice(dirty[i] * m_blockSize, run.constData(), run.size()) != run.size()) {
+            qWarning() << "QFATBlockCache: failed to write back blocks" << dirty[i] << "to" << dirty[runEnd - 1];
+            ok = false;
+        } else {
+            for (int j = i; j < runEnd; j++) {
+                m_blocks[dirty[j]].dirty = false;
+            }
+        }
+        i = runEnd;
+    }
+
+    if (m_blockDevice) {
+        ok = m_blockDevice->flush() && ok;
+    }
+
+    return ok;
+}
+
+bool QFATBlockCache::setCapacity(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_capacity = qMax<qint64>(bytes, 0);
+    return evictTo(maxBlocks());
+}
+
+bool QFATBlockCache::setPolicy(QFATCacheRegion region, QFATCachePolicy policy)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Blocks cached under the old policy stay coherent, only pending writes must not linger
+    m_policies[static_cast<int>(region)] = policy;
+    return policy == QFATCachePolicy::WriteBack || flushBlocks();
+}
+
+void QFATBlockCache::setDirectoryCluster(quint32 cluster, bool isDirectory)
+{
+    QMutexLocker locker(&m_mutex);
+    if (cluster < static_cast<quint32>(m_directoryClusters.size())) {
+        m_directoryClusters.setBit(cluster, isDirectory);
+    }
+}
+
+qint64 QFATBlockCache::readData(char *data, qint64 maxlen)
+{
+    qint64 bytesRead = readAt(m_position, data, maxlen);
+    if (bytesRead > 0) {
+        m_position += bytesRead;
+    }
+    return bytesRead;
+}
+
+qint64 QFATBlockCache::writeData(const char *data, qint64 len)
+{
+    qint64 bytesWritten = writeAt(m_position, data, len);
+    if (bytesWritten > 0) {
+        m_position += bytesWritten;
+    }
+    return bytesWritten;
+}
+
+qint64 QFATBlockCache::readAt(quint64 offset, char *data, qint64 maxlen)
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 total = 0;
+
+    while (total < maxlen) {
+        quint64 position = offset + total;
+        quint64 index = position / m_blockSize;
+
+        if (!cachesReads(position)) {
+            // Read every following uncached block with the same device call
+            quint64 end = position + (maxlen - total);
+            quint64 runEnd = (index + 1) * m_blockSize;
+            while (runEnd < end && !cachesReads(runEnd)) {
+                runEnd += m_blockSize;
+            }
+            qint64 length = qMin(runEnd, end) - position;
+
+            qint64 bytesRead = readDevice(position, data + total, length);
+            if (bytesRead <= 0) {
+                if (total == 0 && bytesRead < 0) {
+                    return -1;
+                }
+                break;
+            }
+
+            // Modified blocks that were not written back yet are newer than the device
+            for (quint64 cached : cachedBlocksIn(position, bytesRead)) {
+                const Block &block = m_blocks[cached];
+                if (!block.dirty) {
+                    continue;
+                }
+                quint64 blockStart = cached * m_blockSize;
+                quint64 from = qMax(position, blockStart);
+                quint64 to = qMin<quint64>(position + bytesRead, blockStart + block.data.size());
+                if (from < to) {
+                    memcpy(data + total + (from - position), block.data.constData() + (from - blockStart), to - from);
+                }
+            }
+
+            total += bytesRead;
+            if (bytesRead < length) {
+                break;
+            }
+            continue;
+        }
+
+        auto it = m_blocks.find(index);
+        if (it == m_blocks.end()) {
+            // Fetch the whole run of missing blocks with one device read
+            quint64 end = position + (maxlen - total);
+            quint64 runEnd = missingRunEnd(index, end, false);
+            qint64 length = qMin(runEnd * m_blockSize, end) - position;
+
+            // Scans larger than the cache would only evict everything else
+            if (runEnd - index > static_cast<quint64>(maxBlocks() / 2)) {
+                qint64 bytesRead = readDevice(position, data + total, length);
+                if (bytesRead <= 0) {
+                    if (total == 0 && bytesRead < 0) {
+                        return -1;
+                    }
+                    break;
+                }
+                m_misses += runEnd - index;
+                total += bytesRead;
+                if (bytesRead < length) {
+                    break;
+                }
+                continue;
+            }
+
+            QByteArray run((runEnd - index) * m_blockSize, 0);
+            qint64 bytesRead = readDevice(index * m_blockSize, run.data(), run.size());
+            if (bytesRead < 0 || !insertBlocks(index, run.left(bytesRead))) {
+                if (total == 0) {
+                    return -1;
+                }
+                break;
+            }
+            m_misses += runEnd - index;
+
+            it = m_blocks.find(index);
+            if (it == m_blocks.end()) {
+                break; // End of device
+            }
+        } else {
+            m_hits++;
+        }
+
+        Block &block = it.value();
+        touch(index, block);
+
+        quint64 offsetInBlock = position - index * m_blockSize;
+        if (offsetInBlock >= static_cast<quint64>(block.data.size())) {
+            break; // End of device
+        }
+
+        qint64 length = qMin<qint64>(block.data.size() - offsetInBlock, maxlen - total);
+        memcpy(data + total, block.data.constData() + offsetInBlock, length);
+        total += length;
+    }
+
+    return total;
+}
+
+qint64 QFATBlockCache::writeAt(quint64 offset, const char *data, qint64 len)
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 total = 0;
+
+    while (total < len) {
+        quint64 position = offset + total;
+        quint64 index = position / m_blockSize;
+
+        if (!cachesWrites(position)) {
+            quint64 end = position + (len - total);
+            quint64 runEnd = (index + 1) * m_blockSize;
+            while (runEnd < end && !cachesWrites(runEnd)) {
+                runEnd += m_blockSize;
+            }
+            qint64 length = qMin(runEnd, end) - position;
+
+            qint64 bytesWritten = writeDevice(position, data + total, length);
+            if (bytesWritten <= 0) {
+                if (total == 0) {
+                    return -1;
+                }
+                break;
+            }
+
+            // Keep cached copies in step with what was just written
+            for (quint64 cached : cachedBlocksIn(position, bytesWritten)) {
+                Block &block = m_blocks[cached];
+                quint64 blockStart = cached * m_blockSize;
+                quint64 from = qMax(position, blockStart);
+                quint64 to = qMin<quint64>(position + bytesWritten, blockStart + block.data.size());
+                if (from < to) {
+                    memcpy(block.data.data() + (from - blockStart), data + total + (from - position), to - from);
+                }
+            }
+
+            total += bytesWritten;
+            if (bytesWritten < length) {
+                break;
+            }
+            continue;
+        }
+
+        if (!m_blocks.contains(index) && !holds(position)) {
+            // Large writes go straight to the device instead of turning the whole cache over
+            quint64 end = position + (len - total);
+            quint64 runEnd = missingRunEnd(index, end, true);
+            if (runEnd - index > static_cast<quint64>(maxBlocks() / 2)) {
+                qint64 length = qMin(runEnd * m_blockSize, end) - position;
+                qint64 bytesWritten = writeDevice(position, data + total, length);
+                if (bytesWritten <= 0) {
+                    if (total == 0) {
+                        return -1;
+                    }
+                    break;
+                }
+                total += bytesWritten;
+                if (bytesWritten < length) {
+                    break;
+                }
+                continue;
+            }
+        }
+
+        quint64 offsetInBlock = position - index * m_blockSize;
+        qint64 length = qMin<qint64>(m_blockSize - offsetInBlock, len - total);
+
+        // A block that is overwritten completely does not need to be read first
+        Block *block = cachedBlock(index, offsetInBlock != 0 || length != static_cast<qint64>(m_blockSize));
+        if (!block) {
+            if (total == 0) {
+                return -1;
+            }
+            break;
+        }
+
+        if (offsetInBlock + length > static_cast<quint64>(block->data.size())) {
+            block->data.resize(offsetInBlock + length);
+        }
+        memcpy(block->data.data() + offsetInBlock, data + total, length);
+        block->dirty = true;
+        total += length;
+    }
+
+    return total;
+}
+
+void QFATBlockCache::prefetch(quint64 offset, qint64 length)
+{
+    // The backend does its own locking, and a hint needs no ordering against cached blocks
+    if (m_blockDevice && length > 0) {
+        m_blockDevice->prefetch(offset, length);
+    }
+}
+
+QFATCacheRegion QFATBlockCache::regionAt(quint64 position) const
+{
+    if (!m_geometry.valid) {
+        return QFATCacheRegion::Data;
+    }
+
+    if (position < m_geometry.fatOffset + static_cast<quint64>(m_geometry.numFATs) * m_geometry.fatSize) {
+        return QFATCacheRegion::FAT;
+    }
+    if (position < m_geometry.dataOffset) {
+        return QFATCacheRegion::Directory;
+    }
+
+    quint64 cluster = ((position - m_geometry.dataOffset) >> m_geometry.clusterShift) + 2;
+    if (cluster < static_cast<quint64>(m_directoryClusters.size()) && m_directoryClusters.testBit(cluster)) {
+        return QFATCacheRegion::Directory;
+    }
+    return QFATCacheRegion::Data;
+}
+
+qint64 QFATBlockCache::maxBlocks() const
+{
+    return m_capacity / m_blockSize;
+}
+
+bool QFATBlockCache::cachesReads(quint64 position) const
+{
+    return maxBlocks() > 0 && policy(regionAt(position)) != QFATCachePolicy::Bypass;
+}
+
+bool QFATBlockCache::cachesWrites(quint64 position) const
+{
+    return holds(position) || (maxBlocks() > 0 && policy(regionAt(position)) == QFATCachePolicy::WriteBack);
+}
+
+bool QFATBlockCache::holds(quint64 position) const
+{
+    return m_holdMetadata && regionAt(position) != QFATCacheRegion::Data;
+}
+
+QFATBlockCache::Block *QFATBlockCache::cachedBlock(quint64 index, bool load)
+{
+    auto it = m_blocks.find(index);
+    if (it != m_blocks.end()) {
+        m_hits++;
+        touch(index, it.value());
+        return &it.value();
+    }
+
+    m_misses++;
+
+    QByteArray data;
+    if (load) {
+        data.resize(m_blockSize);
+        qint64 bytesRead = readDevice(index * m_blockSize, data.data(), m_blockSize);
+        if (bytesRead < 0) {
+            return nullptr;
+        }
+        data.resize(bytesRead);
+    }
+
+    if (!insertBlocks(index, data)) {
+        return nullptr;
+    }
+
+    // A block past the end of the device starts out empty
+    it = m_blocks.find(index);
+    if (it == m_blocks.end()) {
+        it = m_blocks.insert(index, Block());
+        it.value().dirty = false;
+        it.value().lastUse = 0;
+        touch(index, it.value());
+    }
+    return &it.value();
+}
+
+bool QFATBlockCache::insertBlocks(quint64 index, const QByteArray &data)
+{
+    qint64 count = (data.size() + m_blockSize - 1) / m_blockSize;
+
+    // Make room first, so blocks handed out afterwards stay valid until the caller is done with them
+    if (!evictTo(maxBlocks() - qMax<qint64>(count, 1))) {
+        return false;
+    }
+
+    for (qint64 i = 0; i < count; i++) {
+        Block block;
+        block.data = data.mid(i * m_blockSize, m_blockSize);
+        block.dirty = false;
+        block.lastUse = 0;
+        auto it = m_blocks.insert(index + i, block);
+        touch(index + i, it.value());
+    }
+
+    return true;
+}
+
+quint64 QFATBlockCache::missingRunEnd(quint64 index, quint64 end, bool forWrite) const
+{
+    quint64 runEnd = index + 1;
+    while (runEnd * m_blockSize < end && !m_blocks.contains(runEnd)
+           && (forWrite ? cachesWrites(runEnd * m_blockSize) : cachesReads(runEnd * m_blockSize))) {
+        runEnd++;
+    }
+    return runEnd;
+}
+
+void QFATBlockCache::touch(quint64 index, Block &block)
+{
+    m_lru.remove(block.lastUse);
+    block.lastUse = ++m_clock;
+    m_lru.insert(block.lastUse, index);
+}
+
+bool QFATBlockCache::evictTo(qint64 maxBlocks)
+{
+    auto oldest = m_lru.begin();
+    while (m_blocks.size() > qMax<qint64>(maxBlocks, 0) && oldest != m_lru.end()) {
+        quint64 index = oldest.value();
+
+        // Held blocks may push the cache past its budget, they cannot be written early
+        Block &block = m_blocks[index];
+        if (block.dirty && holds(index * m_blockSize)) {
+            ++oldest;
+            continue;
+        }
+        if (block.dirty && !writeBack(index, block)) {
+            return false;
+        }
+
+        oldest = m_lru.erase(oldest);
+        m_blocks.remove(index);
+    }
+
+    return true;
+}
+
+bool QFATBlockCache::writeBack(quint64 index, Block &block)
+{
+    if (writeDevice(index * m_blockSize, block.data.constData(), block.data.size()) != block.data.size()) {
+        qWarning() << "QFATBlockCache: failed to write back block" << index;
+        return false;
+    }
+
+    block.dirty = false;
+    return true;
+}
+
+QList<quint64> QFATBlockCache::cachedBlocksIn(quint64 position, quint64 length) const
+{
+    QList<quint64> blocks;
+
+    if (m_blocks.isEmpty() || length == 0) {
+        return blocks;
+    }
+
+    quint64 first = position / m_blockSize;
+    quint64 last = (position + length - 1) / m_blockSize;
+
+    // Probe whichever is smaller, the requested range or the cache itself
+    if (last - first + 1 <= static_cast<quint64>(m_blocks.size())) {
+        for (quint64 index = first; index <= last; index++) {
+            if (m_blocks.contains(index)) {
+                blocks.append(index);
+            }
+        }
+    } else {
+        for (auto it = m_blocks.constBegin(); it != m_blocks.constEnd(); ++it) {
+            if (it.key() >= first && it.key() <= last) {
+                blocks.append(it.key());
+            }
+        }
+    }
+
+    return blocks;
+}
+
+qint64 QFATBlockCache::readDevice(quint64 position, char *data, qint64 length)
+{
+    if (!m_blockDevice) {
+        return -1;
+    }
+    return m_blockDevice->readAt(position, data, length);
+}
+
+qint64 QFATBlockCache::writeDevice(quint64 position, const char *data, qint64 length)
+{
+    if (!m_blockDevice) {
+        return -1;
+    }
+    return m_blockDevice->writeAt(position, data, length);
+}
@@ -0,0 +1,186 @@
+#include "qfatfilesystem.h"
+#include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// QIODevice fallback
+// ============================================================================
+
+// Positional access emulated with seek + read/write, serialized by a mutex since they share one file position
+class QFATIODeviceBlockDevice : public QFATBlockDevice
+{
+public:
+    explicit QFATIODeviceBlockDevice(QSharedPointer<QIODevice> device)
+        : m_device(device)
+    {
+    }
+
+    qint64 readAt(quint64 offset, char *data, qint64 length) override
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_device->seek(offset)) {
+            return -1;
+        }
+        return m_device->read(data, length);
+    }
+
+    qint64 writeAt(quint64 offset, const char *data, qint64 length) override
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_device->seek(offset)) {
+            return -1;
+        }
+        return m_device->write(data, length);
+    }
+
+    qint64 size() const override
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_device->size();
+    }
+
+    bool flush() override
+    {
+        QMutexLocker locker(&m_mutex);
+        if (QFileDevice *file = qobject_cast<QFileDevice *>(m_device.data())) {
+            return file->flush();
+        }
+        return true;
+    }
+
+private:
+    QSharedPointer<QIODevice> m_device;
+    mutable QMutex m_mutex;
+};
+
+// ============================================================================
+// pread/pwrite on file-backed images
+// ============================================================================
+
+#ifdef Q_OS_UNIX
+// Every call carries its own offset, so there is no shared file position and no locking
+class QFATPosixBlockDevice : public QFATBlockDevice
+{
+public:
+    QFATPosixBlockDevice(QSharedPointer<QIODevice> device, int fd)
+        : m_device(device)
+        , m_fd(fd)
+    {
+    }
+
+    qint64 readAt(quint64 offset, char *data, qint64 length) override
+    {
+        qint64 total = 0;
+        while (total < length) {
+            ssize_t result = ::pread(m_fd, data + total, length - total, offset + total);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return total > 0 ? total : -1;
+            }
+            if (result == 0) {
+                break; // End of file
+            }
+            total += result;
+        }
+        return total;
+    }
+
+    qint64 writeAt(quint64 offset, const char *data, qint64 length) override
+    {
+        qint64 total = 0;
+        while (total < length) {
+            ssize_t result = ::pwrite(m_fd, data + total, length - total, offset + total);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return total > 0 ? total : -1;
+            }
+            total += result;
+        }
+        return total;
+    }
+
+    qint64 size() const override
+    {
+        struct stat info;
+        if (::fstat(m_fd, &info) != 0) {
+            return -1;
+        }
+        return info.st_size;
+    }
+
+    bool flush() override
+    {
+        // pwrite leaves nothing buffered in user space
+        return true;
+    }
+
+    bool sync() override
+    {
+#ifdef Q_OS_LINUX
+        return ::fdatasync(m_fd) == 0;
+#else
+        return ::fsync(m_fd) == 0;
+#endif
+    }
+
+    void prefetch(quint64 offset, qint64 length) override
+    {
+#ifdef POSIX_FADV_WILLNEED
+        ::posix_fadvise(m_fd, offset, length, POSIX_FADV_WILLNEED);
+#else
+        Q_UNUSED(offset);
+        Q_UNUSED(length);
+#endif
+    }
+
+private:
+    QSharedPointer<QIODevice> m_device; // Keeps the descriptor open
+    int m_fd;
+};
+#endif
+
+// ============================================================================
+// QFATBlockDevice
+// ============================================================================
+
+QFATBlockDevice::~QFATBlockDevice()
+{
+}
+
+bool QFATBlockDevice::sync()
+{
+    return flush();
+}
+
+void QFATBlockDevice::prefetch(quint64 offset, qint64 length)
+{
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+}
+
+QFATBlockDevice *QFATBlockDevice::create(QSharedPointer<QIODevice> device)
+{
+#ifdef Q_OS_UNIX
+    QFile *file = qobject_cast<QFile *>(device.data());
+    if (file && file->isOpen() && file->handle() >= 0) {
+        // Anything QFile still buffers must reach the descriptor before bypassing it
+        file->flush();
+        return new QFATPosixBlockDevice(device, file->handle());
+    }
+#endif
+
+    return new QFATIODeviceBlockDevice(device);
+}
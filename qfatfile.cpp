@@ -0,0 +1,387 @@
+#include "qfatfilesystem.h"
+#include "internal_constants.h"
+#include <QDebug>
+#include <QtEndian>
+
+// ============================================================================
+// QFATFile
+// ============================================================================
+
+QFATFile::QFATFile(QFATFileSystem *fileSystem, const QString &path, QObject *parent)
+    : QIODevice(parent)
+    , m_fileSystem(fileSystem)
+    , m_path(path)
+    , m_allocatedClusters(0)
+    , m_devicePos(0)
+    , m_sizeHint(0)
+    , m_entryDirty(false)
+{
+}
+
+QFATFile::~QFATFile()
+{
+    close();
+}
+
+bool QFATFile::open(OpenMode mode)
+{
+    if (isOpen()) {
+        qWarning() << "QFATFile::open: file already open:" << m_path;
+        return false;
+    }
+
+    if (!m_fileSystem || !m_fileSystem->m_device->isOpen()) {
+        setErrorString("Device not open");
+        return false;
+    }
+
+    // Append implies write access, as with QFile
+    if (mode & Append) {
+        mode |= WriteOnly;
+    }
+
+    QStringList parts = m_fileSystem->splitPath(m_path);
+    if (parts.isEmpty()) {
+        setErrorString("Invalid path");
+        return false;
+    }
+    parts.removeLast();
+    m_parentPath = "/" + parts.join("/");
+
+    QFATError error;
+    QFATFileInfo info = m_fileSystem->getFileInfo(m_path, error);
+    bool exists = (error == QFATError::None && !info.name.isEmpty());
+
+    if (exists && info.isDirectory) {
+        setErrorString("Is a directory");
+        return false;
+    }
+
+    if (mode & WriteOnly) {
+        // Like QFile, write-only access truncates unless reading or appending as well
+        bool truncate = (mode & Truncate) || !(mode & (ReadOnly | Append));
+        if (!exists || truncate) {
+            if (!m_fileSystem->writeFile(m_path, QByteArray(), error)) {
+                setErrorString(m_fileSystem->errorString());
+                return false;
+            }
+            info = m_fileSystem->getFileInfo(m_path, error);
+            if (error != QFATError::None) {
+                setErrorString(m_fileSystem->errorString());
+                return false;
+            }
+        }
+    } else if (!exists) {
+        setErrorString("File not found");
+        return false;
+    }
+
+    m_info = info;
+    m_extents = m_fileSystem->getClusterExtents(m_info.cluster);
+    m_allocatedClusters = 0;
+    for (const QFATExtent &extent : m_extents) {
+        m_allocatedClusters += extent.length;
+    }
+    m_devicePos = 0;
+    m_entryDirty = false;
+
+    if (!QIODevice::open(mode)) {
+        return false;
+    }
+
+    if (mode & Append) {
+        seek(size());
+    }
+
+    return true;
+}
+
+void QFATFile::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    flush();
+    QIODevice::close();
+
+    m_extents.clear();
+    m_allocatedClusters = 0;
+    m_devicePos = 0;
+}
+
+qint64 QFATFile::size() const
+{
+    return m_info.size;
+}
+
+bool QFATFile::seek(qint64 pos)
+{
+    if (pos < 0 || static_cast<quint64>(pos) > ENTRY_MAX_FILE_SIZE) {
+        return false;
+    }
+
+    if (!QIODevice::seek(pos)) {
+        return false;
+    }
+
+    m_devicePos = pos;
+    return true;
+}
+
+void QFATFile::setSizeHint(qint64 size)
+{
+    m_sizeHint = qBound<qint64>(0, size, ENTRY_MAX_FILE_SIZE);
+}
+
+bool QFATFile::flush()
+{
+    if (!m_entryDirty) {
+        return true;
+    }
+
+    m_info.modified = QDateTime::currentDateTime();
+
+    // Patch size, first cluster and modification time where the entry was found, instead of searching the
+    // parent directory for it again
+    QFATError error = QFATError::None;
+    bool patched = m_info.entry.isValid() && m_fileSystem->patchDirectoryEntry(m_info.entry, [this](quint8 *entry) {
+        QString longName;
+        if (m_fileSystem->parseDirectoryEntry(entry, longName).name.compare(m_info.name, Qt::CaseInsensitive) != 0) {
+            return false;
+        }
+
+        quint16 date;
+        quint16 time;
+        m_fileSystem->encodeFATDateTime(m_info.modified, date, time);
+        qToLittleEndian<quint16>(time, entry + ENTRY_WRITTEN_DATE_TIME_OFFSET);
+        qToLittleEndian<quint16>(date, entry + ENTRY_WRITTEN_DATE_TIME_OFFSET + 2);
+        qToLittleEndian<quint16>(static_cast<quint16>(m_info.cluster & 0xFFFF), entry + ENTRY_CLUSTER_OFFSET);
+        if (m_fileSystem->m_geometry.type == QFATType::FAT32) {
+            qToLittleEndian<quint16>(static_cast<quint16>(m_info.cluster >> 16), entry + ENTRY_HIGH_ORDER_CLUSTER_ADDRESS_OFFSET);
+        }
+        qToLittleEndian<quint32>(m_info.size, entry + ENTRY_SIZE_OFFSET);
+        return true;
+    }, error);
+
+    if (!patched && !m_fileSystem->updateDirectoryEntry(m_parentPath, m_info)) {
+        setErrorString("Failed to update directory entry");
+        return false;
+    }
+
+    m_entryDirty = false;
+    return true;
+}
+
+bool QFATFile::resize(qint64 size)
+{
+    if (!isOpen() || !isWritable()) {
+        setErrorString("File not open for writing");
+        return false;
+    }
+
+    if (size < 0 || static_cast<quint64>(size) > ENTRY_MAX_FILE_SIZE) {
+        setErrorString("Invalid size");
+        return false;
+    }
+
+    if (static_cast<quint64>(size) > m_info.size) {
+        // Allocate the whole range at once so it can be one run, then zero it through the normal write path
+        if (!ensureAllocated(size)) {
+            setErrorString("Insufficient space");
+            m_fileSystem->m_lastError = QFATError::InsufficientSpace;
+            return false;
+        }
+
+        qint64 position = pos();
+        QByteArray zeros(static_cast<int>(qMin<qint64>(size - m_info.size, m_fileSystem->m_geometry.clusterSize)), 0);
+        if (!seek(m_info.size)) {
+            return false;
+        }
+        while (static_cast<quint64>(size) > m_info.size) {
+            qint64 chunk = qMin<qint64>(size - m_info.size, zeros.size());
+            if (write(zeros.constData(), chunk) != chunk) {
+                return false;
+            }
+        }
+        seek(position);
+        return flush();
+    }
+
+    m_info.size = static_cast<quint32>(size);
+    m_entryDirty = true;
+    if (pos() > size) {
+        seek(size);
+    }
+
+    if (!releaseClusters(size)) {
+        setErrorString("Write error");
+        m_fileSystem->m_lastError = QFATError::WriteError;
+        return false;
+    }
+    return flush();
+}
+
+bool QFATFile::reserve(qint64 size)
+{
+    if (!isOpen() || !isWritable()) {
+        setErrorString("File not open for writing");
+        return false;
+    }
+
+    if (size < 0 || static_cast<quint64>(size) > ENTRY_MAX_FILE_SIZE) {
+        setErrorString("Invalid size");
+        return false;
+    }
+
+    if (!ensureAllocated(size)) {
+        setErrorString("Insufficient space");
+        m_fileSystem->m_lastError = QFATError::InsufficientSpace;
+        return false;
+    }
+
+    // Records the first cluster if the file had none yet, the size stays as it is
+    return flush();
+}
+
+qint64 QFATFile::readData(char *data, qint64 maxlen)
+{
+    if (m_devicePos >= m_info.size || maxlen <= 0) {
+        return 0;
+    }
+
+    qint64 length = qMin<qint64>(maxlen, m_info.size - m_devicePos);
+    qint64 bytesRead = m_fileSystem->readExtents(m_extents, m_devicePos, data, length);
+    if (bytesRead < 0) {
+        setErrorString("Read error");
+        return -1;
+    }
+
+    m_devicePos += bytesRead;
+    return bytesRead;
+}
+
+qint64 QFATFile::writeData(const char *data, qint64 len)
+{
+    if (len <= 0) {
+        return 0;
+    }
+
+    quint64 end = m_devicePos + len;
+    if (end > ENTRY_MAX_FILE_SIZE) {
+        setErrorString("File too large");
+        m_fileSystem->m_lastError = QFATError::InsufficientSpace;
+        return -1;
+    }
+
+    if (!ensureAllocated(end)) {
+        setErrorString("Insufficient space");
+        m_fileSystem->m_lastError = QFATError::InsufficientSpace;
+        return -1;
+    }
+
+    // Writing past the end leaves a hole that must read back as zeros
+    if (m_devicePos > m_info.size) {
+        QByteArray zeros(qMin<quint64>(m_devicePos - m_info.size, m_fileSystem->m_geometry.clusterSize), 0);
+        quint64 position = m_info.size;
+        while (position < m_devicePos) {
+            qint64 chunk = qMin<quint64>(m_devicePos - position, zeros.size());
+            if (m_fileSystem->writeExtents(m_extents, position, zeros.constData(), chunk) != chunk) {
+                setErrorString("Write error");
+                m_fileSystem->m_lastError = QFATError::WriteError;
+                return -1;
+            }
+            position += chunk;
+        }
+    }
+
+    qint64 bytesWritten = m_fileSystem->writeExtents(m_extents, m_devicePos, data, len);
+    if (bytesWritten < 0) {
+        setErrorString("Write error");
+        m_fileSystem->m_lastError = QFATError::WriteError;
+        return -1;
+    }
+
+    m_devicePos += bytesWritten;
+    if (m_devicePos > m_info.size) {
+        m_info.size = static_cast<quint32>(m_devicePos);
+    }
+    m_entryDirty = true;
+
+    return bytesWritten;
+}
+
+bool QFATFile::ensureAllocated(quint64 size)
+{
+    quint32 clusterSize = m_fileSystem->m_geometry.clusterSize;
+    quint32 needed = static_cast<quint32>((size + clusterSize - 1) / clusterSize);
+    if (needed <= m_allocatedClusters) {
+        return true;
+    }
+
+    // Keep growing in place after the tail, and size the run search for the hinted final size
+    quint32 hinted = static_cast<quint32>((qMax<quint64>(m_sizeHint, size) + clusterSize - 1) / clusterSize);
+    quint32 preferredStart = m_extents.isEmpty() ? 0 : m_extents.last().startCluster + m_extents.last().length;
+    QList<quint32> clusters = m_fileSystem->allocateClusters(needed - m_allocatedClusters, hinted - m_allocatedClusters, preferredStart);
+    if (clusters.isEmpty()) {
+        return false;
+    }
+
+    // Link the new clusters after the current tail, or make them the start of the chain
+    if (m_extents.isEmpty()) {
+        m_info.cluster = clusters.first();
+    } else {
+        const QFATExtent &tail = m_extents.last();
+        if (!m_fileSystem->writeFATEntry(tail.startCluster + tail.length - 1, clusters.first())) {
+            for (quint32 cluster : clusters) {
+                m_fileSystem->writeFATEntry(cluster, 0);
+            }
+            return false;
+        }
+    }
+
+    for (quint32 cluster : clusters) {
+        if (!m_extents.isEmpty() && m_extents.last().startCluster + m_extents.last().length == cluster) {
+            m_extents.last().length++;
+        } else {
+            m_extents.append(QFATExtent(cluster, 1));
+        }
+    }
+
+    m_allocatedClusters = needed;
+    m_entryDirty = true;
+    return true;
+}
+
+bool QFATFile::releaseClusters(quint64 size)
+{
+    quint32 clusterSize = m_fileSystem->m_geometry.clusterSize;
+    quint32 keep = static_cast<quint32>((size + clusterSize - 1) / clusterSize);
+    if (keep >= m_allocatedClusters) {
+        return true;
+    }
+
+    QList<quint32> clusters = m_fileSystem->expandExtents(m_extents);
+
+    // Detach the tail before freeing it, so a failure part way leaves lost clusters rather than a file
+    // pointing into free space
+    if (keep == 0) {
+        m_info.cluster = 0;
+        if (!flush()) {
+            return false;
+        }
+    } else if (!m_fileSystem->writeFATEntry(clusters[keep - 1], m_fileSystem->fatEndOfChainMarker())) {
+        return false;
+    }
+
+    for (int i = keep; i < clusters.size(); i++) {
+        if (!m_fileSystem->writeFATEntry(clusters[i], 0)) {
+            return false;
+        }
+    }
+
+    m_extents = m_fileSystem->compactClusters(clusters.mid(0, keep));
+    m_allocatedClusters = keep;
+    m_entryDirty = true;
+    return true;
+}
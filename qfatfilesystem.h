@@ -1,14 +1,38 @@
 #ifndef QFATFILESYSTEM_H
 #define QFATFILESYSTEM_H
 
+#include <QBitArray>
+#include <QByteArray>
+#include <QCache>
 #include <QDataStream>
 #include <QDateTime>
 #include <QFile>
+#include <QHash>
+#include <QIODevice>
 #include <QList>
 #include <QMap>
+#include <QMutex>
 #include <QSharedPointer>
 #include <QScopedPointer>
 #include <QString>
+#include <functional>
+
+// Where a short directory entry is stored: the first cluster of its directory (0 for the fixed FAT12/16 root)
+// and its 32-byte slot within that directory. Stays valid until the entry is deleted or moved.
+struct QFATEntryHandle {
+    quint32 directoryCluster;
+    quint32 slot;
+    quint8 shortName[11]; // Raw 8.3 name found at the slot, tells the entry apart from a later one reusing it
+
+    QFATEntryHandle()
+        : directoryCluster(0)
+        , slot(0xFFFFFFFF)
+        , shortName()
+    {
+    }
+
+    bool isValid() const { return slot != 0xFFFFFFFF; }
+};
 
 struct QFATFileInfo {
     QString name;
@@ -19,6 +43,7 @@ struct QFATFileInfo {
     QDateTime modified;
     quint16 attributes;
     quint32 cluster; // First cluster number (for FAT16, only low 16 bits are used)
+    QFATEntryHandle entry; // Set for entries read from a directory
 
     QFATFileInfo()
         : isDirectory(false)
@@ -41,14 +66,283 @@ enum class QFATError {
     WriteError,
     NotImplemented,
     InsufficientSpace,
-    InvalidFileName
+    InvalidFileName,
+    NotInBatch,
+    BatchAborted
+};
+
+// FAT variant of a volume
+enum class QFATType {
+    FAT12,
+    FAT16,
+    FAT32
+};
+
+// Device regions the block cache distinguishes
+enum class QFATCacheRegion {
+    FAT, // Reserved sectors and every FAT copy
+    Directory, // FAT12/16 root directory and clusters known to hold directories
+    Data
+};
+
+// How the block cache treats accesses to a region
+enum class QFATCachePolicy {
+    WriteBack, // Reads and writes are cached, modified blocks are written on flush() or eviction
+    WriteThrough, // Reads are cached, writes go straight to the device
+    Bypass // Nothing is cached, accesses go straight to the device
+};
+
+// How far the FAT32 FSInfo free-cluster count is believed
+enum class QFATFSInfoMode {
+    Trust, // Reported free space comes from FSInfo until the FAT has to be scanned anyway
+    Verify // Free space always comes from a FAT scan, a stale FSInfo count is corrected on flush()
+};
+
+// How create() opens an image
+enum class QFATMountMode {
+    ReadWrite,
+    // Opened read-only and mapped into memory. Files stored in one contiguous run are returned as views into
+    // the mapping, which stay valid only as long as the filesystem object. Write operations fail.
+    MappedReadOnly
+};
+
+// Receives a file piece by piece in order, returns false to stop reading
+using QFATChunkHandler = std::function<bool(const char *data, qint64 length)>;
+
+// Volume geometry parsed once from the BIOS Parameter Block when the filesystem is constructed.
+// All offsets and sizes are in bytes, relative to the start of the device.
+struct QFATVolumeGeometry {
+    QFATType type;
+    bool valid;
+
+    // Raw BPB values
+    quint16 bytesPerSector;
+    quint8 sectorsPerCluster;
+    quint16 reservedSectors;
+    quint8 numFATs;
+    quint16 rootEntryCount;
+    quint32 sectorsPerFAT;
+    quint32 totalSectors;
+
+    // Derived layout
+    quint64 fatOffset; // First FAT copy
+    quint32 fatSize; // Size of one FAT copy
+    quint64 rootDirOffset; // Fixed root directory (FAT12/FAT16 only)
+    quint32 rootDirSize;
+    quint32 rootDirCluster; // Root directory cluster (FAT32 only)
+    quint16 fsInfoSector; // FSInfo sector (FAT32 only), 0 if the volume has none
+    quint64 dataOffset; // Cluster 2
+    quint32 clusterSize;
+    quint32 clusterShift; // log2(clusterSize)
+    quint32 clusterMask; // clusterSize - 1
+    quint32 clusterCount; // Number of data clusters
+    quint32 maxCluster; // Highest valid data cluster number
+
+    QFATVolumeGeometry()
+        : type(QFATType::FAT16)
+        , valid(false)
+        , bytesPerSector(0)
+        , sectorsPerCluster(0)
+        , reservedSectors(0)
+        , numFATs(0)
+        , rootEntryCount(0)
+        , sectorsPerFAT(0)
+        , totalSectors(0)
+        , fatOffset(0)
+        , fatSize(0)
+        , rootDirOffset(0)
+        , rootDirSize(0)
+        , rootDirCluster(0)
+        , fsInfoSector(0)
+        , dataOffset(0)
+        , clusterSize(0)
+        , clusterShift(0)
+        , clusterMask(0)
+        , clusterCount(0)
+        , maxCluster(0)
+    {
+    }
+
+    quint64 clusterOffset(quint32 cluster) const { return dataOffset + (static_cast<quint64>(cluster - 2) << clusterShift); }
+    bool isDataCluster(quint32 cluster) const { return cluster >= 2 && cluster <= maxCluster; }
+};
+
+// Space usage of a volume, byte counts are 64-bit so volumes past 4 GiB report correctly
+struct QFATVolumeStats {
+    quint64 totalBytes;
+    quint64 freeBytes;
+    quint64 usedBytes;
+    quint32 clusterSize;
+    quint32 totalClusters;
+    quint32 freeClusters;
+
+    QFATVolumeStats()
+        : totalBytes(0)
+        , freeBytes(0)
+        , usedBytes(0)
+        , clusterSize(0)
+        , totalClusters(0)
+        , freeClusters(0)
+    {
+    }
+};
+
+// Run of consecutive clusters in a cluster chain
+struct QFATExtent {
+    quint32 startCluster;
+    quint32 length; // Number of clusters
+
+    QFATExtent()
+        : startCluster(0)
+        , length(0)
+    {
+    }
+
+    QFATExtent(quint32 start, quint32 count)
+        : startCluster(start)
+        , length(count)
+    {
+    }
+};
+
+// Entries of one directory with their names hashed for constant-time lookup
+struct QFATDirectoryIndex {
+    QList<QFATFileInfo> entries;
+    QHash<QString, int> byName; // Upper-cased short and long names -> position in entries
+    QHash<QString, int> byShortNameOnly; // Short names of entries without a usable long name
+};
+
+// Outcome of resolving one path, including misses
+struct QFATPathCacheEntry {
+    QFATFileInfo info;
+    QFATError error;
+    QList<quint32> directories; // Directories the lookup went through, root first
+};
+
+// Positional access to the image, each call carries its own offset so callers on different threads do not race on a shared position
+class QFATBlockDevice
+{
+public:
+    virtual ~QFATBlockDevice();
+
+    virtual qint64 readAt(quint64 offset, char *data, qint64 length) = 0;
+    virtual qint64 writeAt(quint64 offset, const char *data, qint64 length) = 0;
+    virtual qint64 size() const = 0;
+    virtual bool flush() = 0;
+
+    // Make everything written so far durable, defaults to flush()
+    virtual bool sync();
+
+    // Hint that a range is about to be read, so the device can fetch it in the background
+    virtual void prefetch(quint64 offset, qint64 length);
+
+    // pread/pwrite for file-backed images where available, seek + read/write under a lock otherwise
+    static QFATBlockDevice *create(QSharedPointer<QIODevice> device);
+};
+
+// Sector-sized block cache sitting between a filesystem and its device.
+// Every region has its own policy, blocks are evicted least recently used first once the budget is reached.
+// Uncached accesses still see modified blocks that have not been written back yet.
+class QFATBlockCache : public QIODevice
+{
+public:
+    QFATBlockCache(QSharedPointer<QIODevice> device, const QFATVolumeGeometry &geometry, QObject *parent = nullptr);
+    ~QFATBlockCache() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+
+    // Write modified blocks back to the device, blocks held for a batch stay behind
+    bool flush();
+
+    // Write back the modified blocks of one region only, held ones included
+    bool flushRegion(QFATCacheRegion region);
+
+    // Wait until the device has made what was written so far durable
+    bool sync();
+
+    // While holding, FAT and directory writes stay in memory whatever the budget and policy,
+    // until flushRegion() writes them or discardWrites() drops them
+    void setHoldMetadata(bool hold);
+    bool holdsMetadata() const { return m_holdMetadata; }
+
+    // Drop every modified block that was not written back yet
+    void discardWrites();
+
+    // Positional counterparts of read() and write(), they leave pos() untouched
+    qint64 readAt(quint64 offset, char *data, qint64 length);
+    qint64 writeAt(quint64 offset, const char *data, qint64 length);
+    void prefetch(quint64 offset, qint64 length);
+
+    // Memory budget in bytes, less than one block disables caching
+    bool setCapacity(qint64 bytes);
+    qint64 capacity() const { return m_capacity; }
+
+    bool setPolicy(QFATCacheRegion region, QFATCachePolicy policy);
+    QFATCachePolicy policy(QFATCacheRegion region) const { return m_policies[static_cast<int>(region)]; }
+
+    // Directory clusters live in the data area, the filesystem tells the cache which ones they are
+    void setDirectoryCluster(quint32 cluster, bool isDirectory);
+
+    quint64 hits() const { return m_hits; }
+    quint64 misses() const { return m_misses; }
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    struct Block {
+        QByteArray data;
+        bool dirty;
+        quint64 lastUse;
+    };
+
+    bool flushBlocks(int region = -1);
+    QFATCacheRegion regionAt(quint64 position) const;
+    bool holds(quint64 position) const;
+    bool cachesReads(quint64 position) const;
+    bool cachesWrites(quint64 position) const;
+    qint64 maxBlocks() const;
+    Block *cachedBlock(quint64 index, bool load);
+    bool insertBlocks(quint64 index, const QByteArray &data);
+    quint64 missingRunEnd(quint64 index, quint64 end, bool forWrite) const;
+    void touch(quint64 index, Block &block);
+    bool evictTo(qint64 maxBlocks);
+    bool writeBack(quint64 index, Block &block);
+    QList<quint64> cachedBlocksIn(quint64 position, quint64 length) const;
+    qint64 readDevice(quint64 position, char *data, qint64 length);
+    qint64 writeDevice(quint64 position, const char *data, qint64 length);
+
+    QSharedPointer<QIODevice> m_device;
+    QScopedPointer<QFATBlockDevice> m_blockDevice;
+    QMutex m_mutex; // Guards the blocks and policies, positional calls may come from any thread
+    const QFATVolumeGeometry m_geometry;
+    const quint32 m_blockSize;
+    qint64 m_capacity;
+    QFATCachePolicy m_policies[3];
+    QBitArray m_directoryClusters;
+    bool m_holdMetadata;
+
+    QHash<quint64, Block> m_blocks; // Keyed by block index
+    QMap<quint64, quint64> m_lru; // Last use -> block index, oldest first
+    quint64 m_clock;
+    quint64 m_position;
+    quint64 m_hits;
+    quint64 m_misses;
 };
 
+class QFATFile;
+
 // Base class with common FAT filesystem functionality
 class QFATFileSystem
 {
+    friend class QFATFile;
+
 public:
-    QFATFileSystem(QSharedPointer<QIODevice> device);
+    QFATFileSystem(QSharedPointer<QIODevice> device, QFATType type);
     virtual ~QFATFileSystem();
 
     // Pure virtual methods to be implemented by derived classes
@@ -61,6 +355,36 @@ public:
     virtual bool writeFile(const QString &path, const QByteArray &data, QFATError &error) = 0;
     virtual bool deleteFile(const QString &path, QFATError &error) = 0;
 
+    // Whole-file streaming with bounded memory
+    // writeFileFrom: expectedSize, if known, keeps the file contiguous
+    // readFileTo/readFileChunks: data is passed on one cluster run (at most STREAM_CHUNK_SIZE) at a time
+    bool writeFileFrom(const QString &path, QIODevice *source, QFATError &error, qint64 expectedSize = -1);
+    bool readFileTo(const QString &path, QIODevice *sink, QFATError &error);
+    bool readFileChunks(const QString &path, const QFATChunkHandler &handler, QFATError &error);
+
+    // In-place updates of an existing chain: only new tail clusters are allocated, existing data is not rewritten.
+    // appendFile creates the file if it does not exist, writeAt may write past the end (the gap reads as zeros).
+    bool appendFile(const QString &path, const QByteArray &data, QFATError &error);
+    bool writeAt(const QString &path, quint32 offset, const QByteArray &data, QFATError &error);
+
+    // Shrink a file by releasing the tail of its chain, or grow it with zeros.
+    // Clusters past the new size are released, which includes any unused reservation from preallocate().
+    bool truncate(const QString &path, quint32 newSize, QFATError &error);
+
+    // Reserve clusters for size bytes up front, as one contiguous run where free space allows, without changing
+    // the recorded file size. Missing files are created. Later writes use the reserved clusters first.
+    // Note that fsck tools treat a chain longer than the file size as an error and may trim it.
+    bool preallocate(const QString &path, quint32 size, QFATError &error);
+
+    // Metadata updates that patch the short directory entry in place with a single write.
+    // Handles come with every QFATFileInfo from a lookup or listing, so nothing is resolved by path.
+    // An invalid QDateTime leaves that timestamp unchanged. Only the read-only (0x01), hidden (0x02),
+    // system (0x04) and archive (0x20) attributes can be changed.
+    bool setFileTimes(const QFATEntryHandle &handle, const QDateTime &created, const QDateTime &modified, QFATError &error);
+    bool setFileTimes(const QString &path, const QDateTime &created, const QDateTime &modified, QFATError &error);
+    bool setAttributes(const QFATEntryHandle &handle, quint8 attributes, QFATError &error);
+    bool setAttributes(const QString &path, quint8 attributes, QFATError &error);
+
     // File/directory operations
     virtual bool renameFile(const QString &oldPath, const QString &newPath, QFATError &error) = 0;
     virtual bool moveFile(const QString &sourcePath, const QString &destPath, QFATError &error) = 0;
@@ -74,42 +398,291 @@ public:
     virtual QFATFileInfo getFileInfo(const QString &path, QFATError &error) = 0;
 
     // Filesystem information
-    virtual quint32 getFreeSpace(QFATError &error) = 0;
-    virtual quint32 getTotalSpace(QFATError &error) = 0;
+    virtual quint64 getFreeSpace(QFATError &error) = 0;
+    virtual quint64 getTotalSpace(QFATError &error) = 0;
+    QFATVolumeStats volumeStats(QFATError &error);
 
     // Error handling
     QFATError lastError() const { return m_lastError; }
     QString errorString() const;
 
+    // Volume layout, parsed once at construction
+    const QFATVolumeGeometry &geometry() const { return m_geometry; }
+
+    // FAT cache: keeps the first FAT copy in memory so chain walks and allocations do not touch the device.
+    // Modified sectors are written back to every FAT copy on flush() or destruction.
+    bool setFATCacheEnabled(bool enabled);
+    bool isFATCacheEnabled() const { return m_fatCacheEnabled; }
+
+    // Deferred FAT mirrors: only the first FAT copy is written while operating, the other copies
+    // get one bulk copy of the changed sectors on flush() or destruction. Turning it off syncs them right away.
+    bool setFATMirrorDeferred(bool deferred);
+    bool isFATMirrorDeferred() const { return m_fatMirrorDeferred; }
+
+    // Block cache beneath all device I/O. The budget is in bytes, 0 disables the cache.
+    bool setBlockCacheSize(qint64 bytes);
+    qint64 blockCacheSize() const { return m_blockCache->capacity(); }
+    bool setBlockCachePolicy(QFATCacheRegion region, QFATCachePolicy policy);
+    QFATCachePolicy blockCachePolicy(QFATCacheRegion region) const { return m_blockCache->policy(region); }
+
+    // Write pending metadata and cached blocks back to the device, does nothing inside a batch
+    bool flush();
+
+    // Batches keep FAT and directory changes in memory until commitBatch(), which writes them in a
+    // crash-consistent order: file data, then the FAT copies, then directory entries, then freed clusters.
+    // Clusters freed inside a batch are not reused before it commits. Batches nest, only the outermost commits,
+    // and rolling back a nested batch aborts the whole batch: the outermost commitBatch() then rolls back and fails.
+    // Only metadata is rolled back. File contents go to the device right away, so data written into clusters a
+    // file already owned (writeAt(), appendFile(), QFATFile) stays changed, while new files and chains disappear.
+    bool beginBatch();
+    bool commitBatch(QFATError &error);
+    void rollbackBatch();
+    bool isInBatch() const { return m_batchDepth > 0; }
+
+    // FAT32 FSInfo handling, the free count and next-free hint are written back on flush()
+    void setFSInfoMode(QFATFSInfoMode mode) { m_fsInfoMode = mode; }
+    QFATFSInfoMode fsInfoMode() const { return m_fsInfoMode; }
+
+    // Whether the image is memory-mapped, see QFATMountMode::MappedReadOnly
+    bool isMapped() const { return m_mappedImage != nullptr; }
+
 protected:
     QDataStream m_stream;
     QSharedPointer<QIODevice> m_device;
+    const QFATVolumeGeometry m_geometry;
     QFATError m_lastError;
 
+    // All device I/O through m_stream goes through the block cache
+    QScopedPointer<QFATBlockCache> m_blockCache;
+
+    // Read-only mapping of the whole image, null unless mounted with QFATMountMode::MappedReadOnly
+    const uchar *m_mappedImage;
+    quint64 m_mappedSize;
+
+    // FAT cache state
+    bool m_fatCacheEnabled;
+    QByteArray m_fatCache;
+    QBitArray m_fatDirtySectors;
+
+    // Sectors of the first FAT copy not yet copied to the others, used while mirrors are deferred
+    bool m_fatMirrorDeferred;
+    QBitArray m_fatMirrorDirtySectors;
+
+    // Free-cluster bitmap (bit set = free), indexed by cluster number and built on first use
+    bool m_freeClusterMapLoaded;
+    QBitArray m_freeClusterMap;
+    quint32 m_freeClusterCount;
+    quint32 m_nextFreeCluster; // Next-fit allocation cursor
+
+    // FAT32 FSInfo values as stored on disk, and whether the free count still describes the FAT
+    QFATFSInfoMode m_fsInfoMode;
+    bool m_fsInfoLoaded;
+    bool m_fsInfoCountUsable;
+    quint32 m_fsInfoFreeCount;
+    quint32 m_fsInfoNextFree;
+    bool m_fsInfoDirty; // The free count or allocation cursor moved since FSInfo was loaded or written
+
+    // Batch state, freed clusters map to their FAT value before the batch freed them
+    int m_batchDepth;
+    bool m_batchFATCacheWasEnabled;
+    bool m_batchAborted; // A nested batch was rolled back, the outermost one can only roll back too
+    QHash<quint32, quint32> m_batchFreed;
+
+    // Decoded cluster chains keyed by start cluster, dropped whenever the FAT changes
+    QCache<quint32, QList<QFATExtent>> m_extentCache;
+
+    // Directory indexes keyed by directory cluster (0 is the fixed FAT12/16 root), dropped whenever an entry changes
+    QCache<quint32, QFATDirectoryIndex> m_directoryIndex;
+
+    // Resolved paths keyed by upper-cased normalized path, dropped when an entry in one of their directories changes
+    QCache<QString, QFATPathCacheEntry> m_pathCache;
+
+    static QFATVolumeGeometry parseGeometry(QIODevice *device, QFATType type);
+
+    // Map the image for MappedReadOnly mounts, and the mapped bytes of a device range (null if not mapped)
+    bool mapImage();
+    const char *mappedRange(quint64 offset, quint64 length) const;
+
+    // FAT entry access, decoded according to the volume type (12, 16 or 28 bits).
+    // Goes through the FAT cache when it is enabled, otherwise straight to the device.
+    quint32 readFATEntry(quint32 cluster);
+    bool writeFATEntry(quint32 cluster, quint32 value);
+    quint32 fatEndOfChainMarker() const;
+    bool flushFATCache();
+    void discardBatch();
+    bool syncFATMirrors();
+    quint8 fatCopiesToWrite() const { return m_fatMirrorDeferred ? 1 : m_geometry.numFATs; }
+    void markFATMirrorDirty(quint32 offset, quint32 length);
+
+    // Cluster allocation, shared by all FAT variants
+    bool ensureFreeClusterMap();
+    void updateFreeClusterMap(quint32 cluster, bool isFree);
+    quint32 findFreeCluster();
+    quint32 findFreeClusterRun(quint32 count);
+    QList<QFATExtent> freeClusterRuns();
+    QList<QFATExtent> findFewestFreeRuns(quint32 count);
+
+    // Allocate and link count clusters. sizeHint is the expected final size of the chain in clusters,
+    // preferredStart the cluster right after an existing chain that is being grown.
+    QList<quint32> allocateClusters(quint32 count, quint32 sizeHint = 0, quint32 preferredStart = 0);
+    bool freeClusterCount(quint32 &count);
+
+    // FAT32 FSInfo sector
+    void loadFSInfo();
+    bool flushFSInfo();
+
+    // Cluster chains as runs of consecutive clusters
+    QList<QFATExtent> getClusterExtents(quint32 startCluster);
+    QList<quint32> expandExtents(const QList<QFATExtent> &extents);
+    QList<QFATExtent> compactClusters(const QList<quint32> &clusters);
+
+    // Read bytes [offset, offset + length) of a cluster chain, touching only the extents that cover them
+    QByteArray readClusterRange(quint32 startCluster, quint32 offset, quint32 length);
+
+    // Raw I/O at a byte position within a list of extents, returns the number of bytes transferred or -1
+    qint64 readExtents(const QList<QFATExtent> &extents, quint64 offset, char *data, qint64 length);
+    qint64 writeExtents(const QList<QFATExtent> &extents, quint64 offset, const char *data, qint64 length);
+
+    // Fill freshly allocated clusters with data, zero-filling only the slack after the last byte
+    bool writeAllocatedClusters(const QList<quint32> &clusters, const QByteArray &data);
+
+    // Shared by appendFile and writeAt, a negative offset appends
+    bool writeInPlace(const QString &path, qint64 offset, const QByteArray &data, QFATError &error);
+
+    // Write the short directory entry of fileInfo into the directory at parentPath, matched by short name
+    virtual bool updateDirectoryEntry(const QString &parentPath, const QFATFileInfo &fileInfo) = 0;
+
+    // Mark the short directory entry named by the last path component as deleted, its clusters are left alone
+    virtual bool deleteDirectoryEntry(const QString &path) = 0;
+
+    // Move an entry to destPath by writing a new entry for the same first cluster and deleting the old one.
+    // Moved directories get their '..' entry pointed at the new parent. No file data is read or written.
+    bool relocateEntry(const QString &sourcePath, const QString &destPath, QFATError &error);
+
     // Common helper methods
-    QFATFileInfo parseDirectoryEntry(quint8 *entry, QString &longName);
-    QString readLongFileName(quint8 *entry);
-    bool isValidEntry(quint8 *entry);
-    bool isDeletedEntry(quint8 *entry);
-    bool isLongFileNameEntry(quint8 *entry);
+    QFATFileInfo parseDirectoryEntry(const quint8 *entry, QString &longName);
+    QString readLongFileName(const quint8 *entry);
+    bool isValidEntry(const quint8 *entry);
+    bool isDeletedEntry(const quint8 *entry);
+    bool isLongFileNameEntry(const quint8 *entry);
     QDateTime parseDateTime(quint16 date, quint16 time);
     quint16 readBytesPerSector();
     quint8 readSectorsPerCluster();
     quint16 readReservedSectors();
     quint8 readNumberOfFATs();
     quint16 readRootEntryCount();
-    QList<QFATFileInfo> readDirectoryEntries(quint32 offset, quint32 maxSize);
+    QList<QFATFileInfo> readDirectoryEntries(quint64 offset, quint32 maxSize);
+    QList<QFATFileInfo> readDirectoryChain(quint32 startCluster);
+    QList<QFATFileInfo> parseDirectoryEntries(const QByteArray &buffer, quint32 directoryCluster);
+
+    // Device offset of the entry a handle points at, 0 if the slot lies outside the directory
+    quint64 entryOffset(const QFATEntryHandle &handle);
+    // Read the live short entry at handle, let patch modify it and write it back in one go.
+    // patch returns false if the entry is not the one it expected, which leaves it untouched.
+    bool patchDirectoryEntry(const QFATEntryHandle &handle, const std::function<bool(quint8 *)> &patch, QFATError &error);
 
     // Path traversal helpers
     QStringList splitPath(const QString &path);
     QFATFileInfo findInDirectory(const QList<QFATFileInfo> &entries, const QString &name);
+    QFATFileInfo findInDirectory(quint32 dirCluster, const QString &name);
+    QFATDirectoryIndex *directoryIndex(quint32 dirCluster);
+    quint32 directoryKey(quint32 dirCluster) const;
+    bool directoryContainsCluster(quint32 dirCluster, quint32 cluster);
+
+    // Path resolution cache
+    QString pathCacheKey(const QStringList &parts) const;
+    bool lookupPathCache(const QString &key, QFATFileInfo &info, QFATError &error);
+    QFATFileInfo cachePathResult(const QString &key, const QFATFileInfo &info, QFATError error, const QList<quint32> &directories);
+
+    // Drop the directory indexes and resolved paths affected by a directory entry written at entryOffset
+    void invalidateDirectoryCaches(quint64 entryOffset);
 
     // Writing helpers
     void encodeFATDateTime(const QDateTime &dt, quint16 &date, quint16 &time);
     QString generateShortName(const QString &longName, const QList<QFATFileInfo> &existingEntries);
+    void encodeShortName(const QString &shortName, quint8 *name);
     quint8 calculateLFNChecksum(const QString &shortName);
+    quint8 calculateLFNChecksum(const quint8 *name);
     int calculateLFNEntriesNeeded(const QString &longName);
     void writeLFNEntry(quint8 *entry, const QString &longName, int sequence, quint8 checksum, bool isLast);
+
+    // Write LFN entries for longName followed by shortEntry into consecutive free slots of a directory
+    // (0 is the root). offsets receives where each entry went. False if no run of free slots is long enough.
+    bool writeEntrySet(quint32 directoryCluster, const QString &longName, const QString &shortName, const quint8 *shortEntry, QList<quint64> &offsets);
+    // Mark the short entry at handle deleted, together with the LFN parts in front of it that carry its checksum
+    bool deleteEntrySet(const QFATEntryHandle &handle);
+};
+
+// Streaming handle on a single file of a mounted filesystem.
+// Reads and writes go through the file's cluster extents, so memory use does not depend on the file size.
+// The directory entry (size, first cluster, modification time) is updated on flush() and close().
+// The filesystem must outlive the handle, and the file must not be modified through other means while open.
+class QFATFile : public QIODevice
+{
+public:
+    QFATFile(QFATFileSystem *fileSystem, const QString &path, QObject *parent = nullptr);
+    ~QFATFile() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+
+    // Write the directory entry if the file changed
+    bool flush();
+
+    QString path() const { return m_path; }
+    QFATFileInfo fileInfo() const { return m_info; }
+
+    // Expected final size in bytes, lets growing writes look for a contiguous run that fits all of it
+    void setSizeHint(qint64 size);
+    qint64 sizeHint() const { return m_sizeHint; }
+
+    // Like QFile::resize. Shrinking releases the clusters past the new size, growing fills with zeros.
+    bool resize(qint64 size);
+
+    // Allocate clusters for size bytes without changing the file size
+    bool reserve(qint64 size);
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    bool ensureAllocated(quint64 size);
+    bool releaseClusters(quint64 size);
+
+    QFATFileSystem *m_fileSystem;
+    QString m_path;
+    QString m_parentPath;
+    QFATFileInfo m_info;
+    QList<QFATExtent> m_extents;
+    quint32 m_allocatedClusters;
+    quint64 m_devicePos;
+    qint64 m_sizeHint;
+    bool m_entryDirty;
+};
+
+// Scoped batch on a filesystem, see QFATFileSystem::beginBatch().
+// Changes are written by commit(), a transaction that goes out of scope uncommitted is rolled back.
+// Rolling back a transaction nested in another one aborts the outer one as well.
+class QFATTransaction
+{
+public:
+    explicit QFATTransaction(QFATFileSystem *fileSystem);
+    ~QFATTransaction();
+
+    bool commit(QFATError &error);
+    void rollback();
+
+    // False once committed or rolled back, or if the batch could not be started
+    bool isActive() const { return m_active; }
+
+private:
+    Q_DISABLE_COPY(QFATTransaction)
+
+    QFATFileSystem *m_fileSystem;
+    bool m_active;
 };
 
 // FAT12 specific filesystem implementation
@@ -119,7 +692,7 @@ public:
     QFAT12FileSystem(QSharedPointer<QIODevice> device);
 
     // Factory method
-    static QScopedPointer<QFAT12FileSystem> create(const QString &imagePath);
+    static QScopedPointer<QFAT12FileSystem> create(const QString &imagePath, QFATMountMode mode = QFATMountMode::ReadWrite);
 
     // FAT12 specific methods
     QList<QFATFileInfo> listRootDirectory() override;
@@ -145,13 +718,12 @@ public:
     QFATFileInfo getFileInfo(const QString &path, QFATError &error) override;
 
     // Filesystem information
-    quint32 getFreeSpace(QFATError &error) override;
-    quint32 getTotalSpace(QFATError &error) override;
+    quint64 getFreeSpace(QFATError &error) override;
+    quint64 getTotalSpace(QFATError &error) override;
 
 private:
-    quint16 readRootDirSector();
-    quint32 calculateRootDirOffset();
-    quint32 calculateClusterOffset(quint16 cluster);
+    quint64 calculateRootDirOffset();
+    quint64 calculateClusterOffset(quint16 cluster);
     quint16 readNextCluster(quint16 cluster);
 
     // Path traversal
@@ -162,14 +734,13 @@ private:
     QByteArray readClusterChain(quint16 startCluster, quint32 fileSize);
 
     // Writing operations
-    quint16 findFreeCluster();
     bool writeNextCluster(quint16 cluster, quint16 value);
     bool writeClusterData(quint16 cluster, const QByteArray &data, quint32 offset = 0);
     QList<quint16> allocateClusterChain(quint32 numClusters);
     bool freeClusterChain(quint16 startCluster);
-    bool updateDirectoryEntry(const QString &parentPath, const QFATFileInfo &fileInfo);
-    bool createDirectoryEntry(quint32 dirOffset, const QFATFileInfo &fileInfo);
-    bool deleteDirectoryEntry(const QString &path);
+    bool updateDirectoryEntry(const QString &parentPath, const QFATFileInfo &fileInfo) override;
+    bool createDirectoryEntry(quint64 dirOffset, const QFATFileInfo &fileInfo);
+    bool deleteDirectoryEntry(const QString &path) override;
     QString modifyDirectoryEntryName(const QString &path, const QString &newName);
     bool isDirectoryEmpty(quint16 cluster);
 
@@ -185,7 +756,7 @@ public:
     QFAT16FileSystem(QSharedPointer<QIODevice> device);
 
     // Factory method
-    static QScopedPointer<QFAT16FileSystem> create(const QString &imagePath);
+    static QScopedPointer<QFAT16FileSystem> create(const QString &imagePath, QFATMountMode mode = QFATMountMode::ReadWrite);
 
     // FAT16 specific methods
     QList<QFATFileInfo> listRootDirectory() override;
@@ -211,13 +782,12 @@ public:
     QFATFileInfo getFileInfo(const QString &path, QFATError &error) override;
 
     // Filesystem information
-    quint32 getFreeSpace(QFATError &error) override;
-    quint32 getTotalSpace(QFATError &error) override;
+    quint64 getFreeSpace(QFATError &error) override;
+    quint64 getTotalSpace(QFATError &error) override;
 
 private:
-    quint16 readRootDirSector();
-    quint32 calculateRootDirOffset();
-    quint32 calculateClusterOffset(quint16 cluster);
+    quint64 calculateRootDirOffset();
+    quint64 calculateClusterOffset(quint16 cluster);
     quint16 readNextCluster(quint16 cluster);
 
     // Path traversal
@@ -228,14 +798,13 @@ private:
     QByteArray readClusterChain(quint16 startCluster, quint32 fileSize);
 
     // Writing operations
-    quint16 findFreeCluster();
     bool writeNextCluster(quint16 cluster, quint16 value);
     bool writeClusterData(quint16 cluster, const QByteArray &data, quint32 offset = 0);
     QList<quint16> allocateClusterChain(quint32 numClusters);
     bool freeClusterChain(quint16 startCluster);
-    bool updateDirectoryEntry(const QString &parentPath, const QFATFileInfo &fileInfo);
-    bool createDirectoryEntry(quint32 dirOffset, const QFATFileInfo &fileInfo);
-    bool deleteDirectoryEntry(const QString &path);
+    bool updateDirectoryEntry(const QString &parentPath, const QFATFileInfo &fileInfo) override;
+    bool createDirectoryEntry(quint64 dirOffset, const QFATFileInfo &fileInfo);
+    bool deleteDirectoryEntry(const QString &path) override;
     QString modifyDirectoryEntryName(const QString &path, const QString &newName);
     bool isDirectoryEmpty(quint16 cluster);
 
@@ -251,7 +820,7 @@ public:
     QFAT32FileSystem(QSharedPointer<QIODevice> device);
 
     // Factory method
-    static QScopedPointer<QFAT32FileSystem> create(const QString &imagePath);
+    static QScopedPointer<QFAT32FileSystem> create(const QString &imagePath, QFATMountMode mode = QFATMountMode::ReadWrite);
 
     // FAT32 specific methods
     QList<QFATFileInfo> listRootDirectory() override;
@@ -277,12 +846,12 @@ public:
     QFATFileInfo getFileInfo(const QString &path, QFATError &error) override;
 
     // Filesystem information
-    quint32 getFreeSpace(QFATError &error) override;
-    quint32 getTotalSpace(QFATError &error) override;
+    quint64 getFreeSpace(QFATError &error) override;
+    quint64 getTotalSpace(QFATError &error) override;
 
 private:
     quint32 readRootDirCluster();
-    quint32 calculateClusterOffset(quint32 cluster);
+    quint64 calculateClusterOffset(quint32 cluster);
     quint32 readNextCluster(quint32 cluster);
 
     // Path traversal
@@ -293,14 +862,13 @@ private:
     QByteArray readClusterChain(quint32 startCluster, quint32 fileSize);
 
     // Writing operations
-    quint32 findFreeCluster();
     bool writeNextCluster(quint32 cluster, quint32 value);
     bool writeClusterData(quint32 cluster, const QByteArray &data, quint32 offset = 0);
     QList<quint32> allocateClusterChain(quint32 numClusters);
     bool freeClusterChain(quint32 startCluster);
-    bool updateDirectoryEntry(const QString &parentPath, const QFATFileInfo &fileInfo);
-    bool createDirectoryEntry(quint32 dirOffset, const QFATFileInfo &fileInfo);
-    bool deleteDirectoryEntry(const QString &path);
+    bool updateDirectoryEntry(const QString &parentPath, const QFATFileInfo &fileInfo) override;
+    bool createDirectoryEntry(quint64 dirOffset, const QFATFileInfo &fileInfo);
+    bool deleteDirectoryEntry(const QString &path) override;
     QString modifyDirectoryEntryName(const QString &path, const QString &newName);
     bool isDirectoryEmpty(quint32 cluster);
 
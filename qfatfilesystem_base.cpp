@@ -1,28 +1,2057 @@
+#include <algorithm>
+#include <cstring>
+
 #include <QByteArray>
 #include <QDataStream>
 #include <QDebug>
 #include <QFile>
 #include <QRegularExpression>
 #include <QString>
+#include <QtEndian>
+
+#include "internal_constants.h"
+#include "qfatfilesystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QFAT_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define QFAT_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// Base class: QFATFileSystem
+// ============================================================================
+
+QFATFileSystem::QFATFileSystem(QSharedPointer<QIODevice> device, QFATType type)
+    : m_device(device)
+    , m_geometry(parseGeometry(device.data(), type))
+    , m_lastError(QFATError::None)
+    , m_mappedImage(nullptr)
+    , m_mappedSize(0)
+    , m_fatCacheEnabled(false)
+    , m_fatMirrorDeferred(false)
+    , m_freeClusterMapLoaded(false)
+    , m_freeClusterCount(0)
+    , m_nextFreeCluster(2)
+    , m_fsInfoMode(QFATFSInfoMode::Trust)
+    , m_fsInfoLoaded(false)
+    , m_fsInfoCountUsable(false)
+    , m_fsInfoFreeCount(FSINFO_UNKNOWN)
+    , m_fsInfoNextFree(FSINFO_UNKNOWN)
+    , m_fsInfoDirty(false)
+    , m_batchDepth(0)
+    , m_batchFATCacheWasEnabled(false)
+    , m_batchAborted(false)
+    , m_extentCache(EXTENT_CACHE_MAX_COST)
+    , m_directoryIndex(DIRECTORY_INDEX_CACHE_MAX_COST)
+    , m_pathCache(PATH_CACHE_MAX_ENTRIES)
+{
+    // All I/O through the stream goes through the block cache, which shares the device's access mode
+    m_blockCache.reset(new QFATBlockCache(m_device, m_geometry));
+    if (m_device && m_device->isOpen()) {
+        m_blockCache->open(m_device->openMode() & QIODevice::ReadWrite);
+    }
+    m_stream.setDevice(m_blockCache.data());
+    // Set byte order to Little Endian so that the data is read correctly
+    m_stream.setByteOrder(QDataStream::LittleEndian);
+
+    loadFSInfo();
+}
+
+QFATFileSystem::~QFATFileSystem()
+{
+    // A batch that was never committed leaves the volume as it was
+    if (m_batchDepth > 0) {
+        discardBatch();
+    }
+    flush();
+}
+
+bool QFATFileSystem::mapImage()
+{
+    QFileDevice *file = qobject_cast<QFileDevice *>(m_device.data());
+    if (!file || !file->isOpen() || !m_geometry.valid) {
+        return false;
+    }
+
+    qint64 size = file->size();
+    uchar *image = size > 0 ? file->map(0, size) : nullptr;
+    if (!image) {
+        return false;
+    }
+
+    m_mappedImage = image;
+    m_mappedSize = size;
+
+    // Reads are served from the mapping, cached blocks would only duplicate the page cache
+    m_blockCache->setCapacity(0);
+    return true;
+}
+
+const char *QFATFileSystem::mappedRange(quint64 offset, quint64 length) const
+{
+    if (!m_mappedImage || offset > m_mappedSize || length > m_mappedSize - offset) {
+        return nullptr;
+    }
+    return reinterpret_cast<const char *>(m_mappedImage) + offset;
+}
+
+QFATVolumeGeometry QFATFileSystem::parseGeometry(QIODevice *device, QFATType type)
+{
+    QFATVolumeGeometry geometry;
+    geometry.type = type;
+
+    if (!device || !device->isOpen()) {
+        return geometry;
+    }
+
+    // Read the whole boot sector at once instead of seeking to every BPB field
+    quint8 bootSector[BOOT_SECTOR_SIZE];
+    device->seek(0);
+    if (device->read(reinterpret_cast<char *>(bootSector), BOOT_SECTOR_SIZE) != BOOT_SECTOR_SIZE) {
+        qWarning() << "Failed to read boot sector";
+        return geometry;
+    }
+
+    geometry.bytesPerSector = qFromLittleEndian<quint16>(bootSector + BPB_BYTES_PER_SECTOR_OFFSET);
+    geometry.sectorsPerCluster = bootSector[BPB_SECTORS_PER_CLUSTER_OFFSET];
+    geometry.reservedSectors = qFromLittleEndian<quint16>(bootSector + BPB_RESERVED_SECTORS_OFFSET);
+    geometry.numFATs = bootSector[BPB_NUMBER_OF_FATS_OFFSET];
+    geometry.rootEntryCount = qFromLittleEndian<quint16>(bootSector + BPB_ROOT_ENTRY_COUNT_OFFSET);
+    geometry.totalSectors = qFromLittleEndian<quint16>(bootSector + BPB_TOTAL_SECTORS_16_OFFSET);
+    if (geometry.totalSectors == 0) {
+        geometry.totalSectors = qFromLittleEndian<quint32>(bootSector + BPB_TOTAL_SECTORS_32_OFFSET);
+    }
+
+    if (type == QFATType::FAT32) {
+        geometry.sectorsPerFAT = qFromLittleEndian<quint32>(bootSector + BPB_SECTORS_PER_FAT32_OFFSET);
+        geometry.rootDirCluster = qFromLittleEndian<quint32>(bootSector + BPB_ROOT_DIRECTORY_CLUSTER_OFFSET);
+        geometry.fsInfoSector = qFromLittleEndian<quint16>(bootSector + BPB_FSINFO_SECTOR_OFFSET);
+    } else {
+        geometry.sectorsPerFAT = qFromLittleEndian<quint16>(bootSector + BPB_SECTORS_PER_FAT_OFFSET);
+    }
+
+    // Sector and cluster sizes must be powers of two so cluster offsets can be computed with shifts
+    auto isPowerOfTwo = [](quint32 value) {
+        return value != 0 && (value & (value - 1)) == 0;
+    };
+    if (!isPowerOfTwo(geometry.bytesPerSector) || geometry.bytesPerSector < MIN_BYTES_PER_SECTOR || geometry.bytesPerSector > MAX_BYTES_PER_SECTOR
+        || !isPowerOfTwo(geometry.sectorsPerCluster) || geometry.reservedSectors == 0 || geometry.numFATs == 0 || geometry.sectorsPerFAT == 0) {
+        qWarning() << "Invalid BIOS Parameter Block";
+        return geometry;
+    }
+
+    quint32 rootDirSectors = (geometry.rootEntryCount * ENTRY_SIZE + geometry.bytesPerSector - 1) / geometry.bytesPerSector;
+    quint32 firstDataSector = geometry.reservedSectors + geometry.numFATs * geometry.sectorsPerFAT + rootDirSectors;
+
+    // Byte offsets are 64-bit, large FAT32 volumes put the data area and clusters past 4 GiB
+    geometry.fatOffset = static_cast<quint64>(geometry.reservedSectors) * geometry.bytesPerSector;
+    geometry.fatSize = geometry.sectorsPerFAT * geometry.bytesPerSector;
+    geometry.rootDirOffset = geometry.fatOffset + static_cast<quint64>(geometry.numFATs) * geometry.fatSize;
+    geometry.rootDirSize = geometry.rootEntryCount * ENTRY_SIZE;
+    geometry.dataOffset = static_cast<quint64>(firstDataSector) * geometry.bytesPerSector;
+    geometry.clusterSize = geometry.sectorsPerCluster * geometry.bytesPerSector;
+    geometry.clusterMask = geometry.clusterSize - 1;
+    while ((1u << geometry.clusterShift) < geometry.clusterSize) {
+        geometry.clusterShift++;
+    }
+
+    // The number of data clusters is bounded both by the volume size and by what the FAT can address
+    quint32 fatEntries;
+    quint32 maxCluster;
+    switch (type) {
+    case QFATType::FAT12:
+        fatEntries = geometry.fatSize * 2 / 3; // 1.5 bytes per entry
+        maxCluster = FAT12_MAX_CLUSTER;
+        break;
+    case QFATType::FAT16:
+        fatEntries = geometry.fatSize / 2;
+        maxCluster = FAT16_MAX_CLUSTER;
+        break;
+    default:
+        fatEntries = geometry.fatSize / 4;
+        maxCluster = FAT32_MAX_CLUSTER;
+        break;
+    }
+
+    if (fatEntries <= 2) {
+        qWarning() << "FAT too small";
+        return geometry;
+    }
+
+    quint32 clusterCount = fatEntries - 2;
+    if (geometry.totalSectors > firstDataSector) {
+        clusterCount = qMin(clusterCount, (geometry.totalSectors - firstDataSector) / geometry.sectorsPerCluster);
+    }
+    geometry.clusterCount = qMin(clusterCount, maxCluster - 1);
+    geometry.maxCluster = geometry.clusterCount + 1;
+
+    geometry.valid = true;
+    return geometry;
+}
+
+// ============================================================================
+// FAT access
+// ============================================================================
+
+// Byte offset of a FAT entry within one FAT copy, and how many bytes hold it
+static inline void fatEntryLocation(QFATType type, quint32 cluster, quint32 &offset, quint32 &width)
+{
+    switch (type) {
+    case QFATType::FAT12:
+        offset = cluster + (cluster / 2); // cluster * 1.5
+        width = 2;
+        break;
+    case QFATType::FAT16:
+        offset = cluster * 2;
+        width = 2;
+        break;
+    default:
+        offset = cluster * 4;
+        width = 4;
+        break;
+    }
+}
+
+static inline quint32 decodeFATEntry(QFATType type, quint32 cluster, const uchar *bytes)
+{
+    switch (type) {
+    case QFATType::FAT12: {
+        quint16 value = qFromLittleEndian<quint16>(bytes);
+        // Odd clusters use the high 12 bits, even clusters the low 12 bits
+        return (cluster & 1) ? (value >> 4) : (value & 0x0FFF);
+    }
+    case QFATType::FAT16:
+        return qFromLittleEndian<quint16>(bytes);
+    default:
+        // Only the low 28 bits are used on FAT32
+        return qFromLittleEndian<quint32>(bytes) & 0x0FFFFFFF;
+    }
+}
+
+static inline void encodeFATEntry(QFATType type, quint32 cluster, quint32 value, uchar *bytes)
+{
+    switch (type) {
+    case QFATType::FAT12: {
+        quint16 current = qFromLittleEndian<quint16>(bytes);
+        if (cluster & 1) {
+            current = (current & 0x000F) | ((value & 0x0FFF) << 4);
+        } else {
+            current = (current & 0xF000) | (value & 0x0FFF);
+        }
+        qToLittleEndian<quint16>(current, bytes);
+        break;
+    }
+    case QFATType::FAT16:
+        qToLittleEndian<quint16>(static_cast<quint16>(value), bytes);
+        break;
+    default: {
+        // The high 4 bits are reserved and must be preserved
+        quint32 current = qFromLittleEndian<quint32>(bytes);
+        qToLittleEndian<quint32>((current & 0xF0000000) | (value & 0x0FFFFFFF), bytes);
+        break;
+    }
+    }
+}
+
+quint32 QFATFileSystem::fatEndOfChainMarker() const
+{
+    switch (m_geometry.type) {
+    case QFATType::FAT12:
+        return 0x0FFF;
+    case QFATType::FAT16:
+        return 0xFFFF;
+    default:
+        return 0x0FFFFFFF;
+    }
+}
+
+// ============================================================================
+// FAT scanning kernels
+// ============================================================================
+
+// The kernels mark free (zero) entries in a bitmap with one bit per entry, least significant bit first,
+// the layout QBitArray::fromBits() expects. Vector loops handle whole bitmap bytes, the scalar loops the rest.
+
+static inline void markFreeEntry(uchar *bitmap, quint32 entry)
+{
+    bitmap[entry >> 3] |= static_cast<uchar>(1u << (entry & 7));
+}
+
+static void scanFreeEntries12(const uchar *fat, quint32 count, uchar *bitmap)
+{
+    // Two packed 12-bit entries share three bytes, so unpack them in pairs
+    quint32 entry = 0;
+    for (; entry + 1 < count; entry += 2) {
+        const uchar *pair = fat + entry + entry / 2;
+        if ((pair[0] | ((pair[1] & 0x0F) << 8)) == 0) {
+            markFreeEntry(bitmap, entry);
+        }
+        if (((pair[1] >> 4) | (pair[2] << 4)) == 0) {
+            markFreeEntry(bitmap, entry + 1);
+        }
+    }
+    if (entry < count && decodeFATEntry(QFATType::FAT12, entry, fat + entry + entry / 2) == 0) {
+        markFreeEntry(bitmap, entry);
+    }
+}
+
+static void scanFreeEntries16(const uchar *fat, quint32 count, uchar *bitmap)
+{
+    quint32 entry = 0;
+
+#ifdef QFAT_HAVE_AVX2
+    const __m256i zero256 = _mm256_setzero_si256();
+    for (; entry + 16 <= count; entry += 16) {
+        __m256i isFree = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(fat + entry * 2)), zero256);
+        // Packing works per 128-bit lane: entries 0-7 end up in mask bits 0-7, entries 8-15 in bits 16-23
+        quint32 mask = static_cast<quint32>(_mm256_movemask_epi8(_mm256_packs_epi16(isFree, isFree)));
+        bitmap[entry >> 3] = static_cast<uchar>(mask);
+        bitmap[(entry >> 3) + 1] = static_cast<uchar>(mask >> 16);
+    }
+#endif
+
+#ifdef QFAT_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; entry + 8 <= count; entry += 8) {
+        __m128i isFree = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(fat + entry * 2)), zero);
+        bitmap[entry >> 3] = static_cast<uchar>(_mm_movemask_epi8(_mm_packs_epi16(isFree, zero)));
+    }
+#endif
+
+    for (; entry < count; entry++) {
+        if (qFromLittleEndian<quint16>(fat + entry * 2) == 0) {
+            markFreeEntry(bitmap, entry);
+        }
+    }
+}
+
+static void scanFreeEntries32(const uchar *fat, quint32 count, uchar *bitmap)
+{
+    quint32 entry = 0;
+
+    // Only the low 28 bits count, the reserved high bits may be set on free entries
+#ifdef QFAT_HAVE_AVX2
+    const __m256i zero256 = _mm256_setzero_si256();
+    const __m256i mask256 = _mm256_set1_epi32(0x0FFFFFFF);
+    for (; entry + 8 <= count; entry += 8) {
+        __m256i value = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(fat + entry * 4)), mask256);
+        __m256i isFree = _mm256_cmpeq_epi32(value, zero256);
+        bitmap[entry >> 3] = static_cast<uchar>(_mm256_movemask_ps(_mm256_castsi256_ps(isFree)));
+    }
+#endif
+
+#ifdef QFAT_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi32(0x0FFFFFFF);
+    for (; entry + 8 <= count; entry += 8) {
+        __m128i low = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(fat + entry * 4)), mask);
+        __m128i high = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(fat + entry * 4 + 16)), mask);
+        int bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(low, zero)))
+            | (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(high, zero))) << 4);
+        bitmap[entry >> 3] = static_cast<uchar>(bits);
+    }
+#endif
+
+    for (; entry < count; entry++) {
+        if ((qFromLittleEndian<quint32>(fat + entry * 4) & 0x0FFFFFFF) == 0) {
+            markFreeEntry(bitmap, entry);
+        }
+    }
+}
+
+// First cluster in [from, to] whose bit equals value, or to + 1 if there is none.
+// Words and bytes that cannot contain a match are skipped whole.
+static quint32 findClusterBit(const QBitArray &map, bool value, quint32 from, quint32 to)
+{
+    const uchar *bits = reinterpret_cast<const uchar *>(map.bits());
+    const quint64 skipWord = value ? 0 : ~quint64(0);
+    const uchar skipByte = value ? 0x00 : 0xFF;
+
+    quint32 cluster = from;
+    while (cluster <= to) {
+        if ((cluster & 63) == 0 && to - cluster >= 63) {
+            quint64 word;
+            memcpy(&word, bits + (cluster >> 3), sizeof(word));
+            if (word == skipWord) {
+                cluster += 64;
+                continue;
+            }
+        }
+        if ((cluster & 7) == 0 && bits[cluster >> 3] == skipByte) {
+            cluster += 8;
+            continue;
+        }
+        if (map.testBit(cluster) == value) {
+            return cluster;
+        }
+        cluster++;
+    }
+
+    return to + 1;
+}
+
+quint32 QFATFileSystem::readFATEntry(quint32 cluster)
+{
+    quint32 offset;
+    quint32 width;
+    fatEntryLocation(m_geometry.type, cluster, offset, width);
+
+    // Entries outside the FAT terminate any chain that points at them
+    if (offset + width > m_geometry.fatSize) {
+        return fatEndOfChainMarker();
+    }
+
+    if (m_fatCacheEnabled) {
+        return decodeFATEntry(m_geometry.type, cluster, reinterpret_cast<const uchar *>(m_fatCache.constData()) + offset);
+    }
+
+    if (const char *mapped = mappedRange(m_geometry.fatOffset + offset, width)) {
+        return decodeFATEntry(m_geometry.type, cluster, reinterpret_cast<const uchar *>(mapped));
+    }
+
+    uchar bytes[4];
+    if (m_blockCache->readAt(m_geometry.fatOffset + offset, reinterpret_cast<char *>(bytes), width) != width) {
+        return fatEndOfChainMarker();
+    }
+
+    return decodeFATEntry(m_geometry.type, cluster, bytes);
+}
+
+bool QFATFileSystem::writeFATEntry(quint32 cluster, quint32 value)
+{
+    quint32 offset;
+    quint32 width;
+    fatEntryLocation(m_geometry.type, cluster, offset, width);
+
+    if (offset + width > m_geometry.fatSize) {
+        return false;
+    }
+
+    // Any FAT change may alter a cached chain
+    m_extentCache.clear();
+
+    // Clusters freed inside a batch stay taken until it commits, so remember what the FAT held
+    if (value == 0 && m_batchDepth > 0 && !m_batchFreed.contains(cluster)) {
+        quint32 previous = readFATEntry(cluster);
+        if (previous != 0) {
+            m_batchFreed.insert(cluster, previous);
+        }
+    }
+    bool updateMap = (value != 0 || m_batchDepth == 0);
+
+    if (m_fatCacheEnabled) {
+        encodeFATEntry(m_geometry.type, cluster, value, reinterpret_cast<uchar *>(m_fatCache.data()) + offset);
+
+        // A FAT12 entry may straddle a sector boundary
+        m_fatDirtySectors.setBit(offset / m_geometry.bytesPerSector);
+        m_fatDirtySectors.setBit((offset + width - 1) / m_geometry.bytesPerSector);
+        if (updateMap) {
+            updateFreeClusterMap(cluster, value == 0);
+        }
+        return true;
+    }
+
+    // FAT12 and FAT32 entries share bytes with reserved bits or the neighbouring entry, so read-modify-write
+    uchar bytes[4];
+    if (m_blockCache->readAt(m_geometry.fatOffset + offset, reinterpret_cast<char *>(bytes), width) != width) {
+        return false;
+    }
+    encodeFATEntry(m_geometry.type, cluster, value, bytes);
+
+    // Write to all FAT copies, or only to the first one while the mirrors are deferred
+    for (quint8 i = 0; i < fatCopiesToWrite(); i++) {
+        quint64 position = m_geometry.fatOffset + static_cast<quint64>(i) * m_geometry.fatSize + offset;
+        if (m_blockCache->writeAt(position, reinterpret_cast<const char *>(bytes), width) != width) {
+            return false;
+        }
+    }
+    markFATMirrorDirty(offset, width);
+
+    if (updateMap) {
+        updateFreeClusterMap(cluster, value == 0);
+    }
+    return true;
+}
+
+// ============================================================================
+// Cluster allocation
+// ============================================================================
+
+bool QFATFileSystem::ensureFreeClusterMap()
+{
+    if (m_freeClusterMapLoaded) {
+        return true;
+    }
+
+    if (!m_geometry.valid || !m_device->isOpen()) {
+        return false;
+    }
+
+    // Decode the whole FAT in one pass, from the FAT cache or from a single bulk read
+    QByteArray fat = m_fatCache;
+    if (!m_fatCacheEnabled) {
+        fat = QByteArray(m_geometry.fatSize, 0);
+        if (m_blockCache->readAt(m_geometry.fatOffset, fat.data(), fat.size()) != fat.size()) {
+            qWarning() << "Failed to read FAT for free cluster map";
+            return false;
+        }
+    }
+
+    // Only entries that lie completely within the FAT are scanned
+    quint32 entryCount = m_geometry.maxCluster + 1;
+    quint32 offset;
+    quint32 width;
+    fatEntryLocation(m_geometry.type, entryCount - 1, offset, width);
+    while (entryCount > 2 && offset + width > m_geometry.fatSize) {
+        entryCount--;
+        fatEntryLocation(m_geometry.type, entryCount - 1, offset, width);
+    }
+
+    // Build the free map a bitmap byte at a time with the scanning kernels
+    const uchar *bytes = reinterpret_cast<const uchar *>(fat.constData());
+    QByteArray bitmap((m_geometry.maxCluster + 8) / 8, 0);
+    uchar *bitmapBytes = reinterpret_cast<uchar *>(bitmap.data());
+    switch (m_geometry.type) {
+    case QFATType::FAT12:
+        scanFreeEntries12(bytes, entryCount, bitmapBytes);
+        break;
+    case QFATType::FAT16:
+        scanFreeEntries16(bytes, entryCount, bitmapBytes);
+        break;
+    default:
+        scanFreeEntries32(bytes, entryCount, bitmapBytes);
+        break;
+    }
+
+    // Entries 0 and 1 are reserved, not free clusters
+    bitmapBytes[0] &= ~0x03;
+
+    m_freeClusterMap = QBitArray::fromBits(bitmap.constData(), m_geometry.maxCluster + 1);
+    m_freeClusterCount = static_cast<quint32>(m_freeClusterMap.count(true));
+
+    if (m_fsInfoCountUsable && m_fsInfoFreeCount != m_freeClusterCount && m_fsInfoMode == QFATFSInfoMode::Verify) {
+        qWarning() << "FSInfo free cluster count" << m_fsInfoFreeCount << "does not match the FAT (" << m_freeClusterCount << "), correcting it";
+        m_fsInfoDirty = true;
+    }
+
+    // Clusters freed by a running batch are not available before it commits
+    for (auto it = m_batchFreed.constBegin(); it != m_batchFreed.constEnd(); ++it) {
+        if (it.key() < static_cast<quint32>(m_freeClusterMap.size()) && m_freeClusterMap.testBit(it.key())) {
+            m_freeClusterMap.clearBit(it.key());
+            m_freeClusterCount--;
+        }
+    }
+
+    m_freeClusterMapLoaded = true;
+    return true;
+}
+
+void QFATFileSystem::updateFreeClusterMap(quint32 cluster, bool isFree)
+{
+    // A freed directory cluster may come back as file data
+    if (isFree) {
+        m_blockCache->setDirectoryCluster(cluster, false);
+    }
+
+    if (!m_freeClusterMapLoaded) {
+        // Without the map there is no telling whether this changed the free count
+        m_fsInfoDirty = m_fsInfoDirty || m_fsInfoCountUsable;
+        m_fsInfoCountUsable = false;
+        return;
+    }
+
+    if (!m_geometry.isDataCluster(cluster)) {
+        return;
+    }
+
+    if (m_freeClusterMap.testBit(cluster) == isFree) {
+        return;
+    }
+
+    m_freeClusterMap.setBit(cluster, isFree);
+    m_fsInfoDirty = true;
+    if (isFree) {
+        m_freeClusterCount++;
+    } else {
+        m_freeClusterCount--;
+    }
+}
+
+quint32 QFATFileSystem::findFreeCluster()
+{
+    if (!ensureFreeClusterMap() || m_freeClusterCount == 0) {
+        return 0;
+    }
+
+    // Next-fit: continue after the last allocation and wrap around once
+    quint32 start = qBound<quint32>(2, m_nextFreeCluster, m_geometry.maxCluster);
+    quint32 cluster = findClusterBit(m_freeClusterMap, true, start, m_geometry.maxCluster);
+    if (cluster <= m_geometry.maxCluster) {
+        return cluster;
+    }
+
+    cluster = findClusterBit(m_freeClusterMap, true, 2, start - 1);
+    return cluster < start ? cluster : 0;
+}
+
+quint32 QFATFileSystem::findFreeClusterRun(quint32 count)
+{
+    if (count == 0 || !ensureFreeClusterMap() || m_freeClusterCount < count) {
+        return 0;
+    }
+
+    // Best fit: the smallest free run that holds the request, so large runs stay whole for large files.
+    // Among equally good runs the first one at or after the allocation cursor wins.
+    quint32 cursor = qBound<quint32>(2, m_nextFreeCluster, m_geometry.maxCluster);
+    quint32 bestStart = 0;
+    quint32 bestLength = 0;
+    bool bestAfterCursor = false;
+
+    quint32 cluster = 2;
+    while (cluster <= m_geometry.maxCluster) {
+        quint32 runStart = findClusterBit(m_freeClusterMap, true, cluster, m_geometry.maxCluster);
+        if (runStart > m_geometry.maxCluster) {
+            break;
+        }
+        quint32 runEnd = findClusterBit(m_freeClusterMap, false, runStart, m_geometry.maxCluster);
+        quint32 runLength = runEnd - runStart;
+
+        if (runLength >= count) {
+            bool afterCursor = runStart >= cursor;
+            if (bestLength == 0 || runLength < bestLength || (runLength == bestLength && afterCursor && !bestAfterCursor)) {
+                bestStart = runStart;
+                bestLength = runLength;
+                bestAfterCursor = afterCursor;
+            }
+            if (runLength == count && afterCursor) {
+                break; // Nothing fits better
+            }
+        }
+        cluster = runEnd + 1;
+    }
+
+    return bestStart;
+}
+
+QList<QFATExtent> QFATFileSystem::freeClusterRuns()
+{
+    QList<QFATExtent> runs;
+
+    if (!ensureFreeClusterMap()) {
+        return runs;
+    }
+
+    quint32 cluster = 2;
+    while (cluster <= m_geometry.maxCluster) {
+        quint32 runStart = findClusterBit(m_freeClusterMap, true, cluster, m_geometry.maxCluster);
+        if (runStart > m_geometry.maxCluster) {
+            break;
+        }
+        quint32 runEnd = findClusterBit(m_freeClusterMap, false, runStart, m_geometry.maxCluster);
+        runs.append(QFATExtent(runStart, runEnd - runStart));
+        cluster = runEnd + 1;
+    }
+
+    return runs;
+}
+
+QList<QFATExtent> QFATFileSystem::findFewestFreeRuns(quint32 count)
+{
+    QList<QFATExtent> runs = freeClusterRuns();
+
+    // Fewest fragments: the largest runs first, and the last piece from the smallest run that still holds it
+    std::stable_sort(runs.begin(), runs.end(), [](const QFATExtent &a, const QFATExtent &b) {
+        return a.length > b.length;
+    });
+
+    QList<QFATExtent> chosen;
+    quint32 remaining = count;
+    for (int i = 0; i < runs.size() && remaining > 0; i++) {
+        if (runs[i].length >= remaining) {
+            int best = i;
+            while (best + 1 < runs.size() && runs[best + 1].length >= remaining) {
+                best++;
+            }
+            chosen.append(QFATExtent(runs[best].startCluster, remaining));
+            remaining = 0;
+            break;
+        }
+        chosen.append(runs[i]);
+        remaining -= runs[i].length;
+    }
+
+    if (remaining > 0) {
+        return QList<QFATExtent>();
+    }
+
+    // Chain the pieces in volume order so sequential reads move forward
+    std::sort(chosen.begin(), chosen.end(), [](const QFATExtent &a, const QFATExtent &b) {
+        return a.startCluster < b.startCluster;
+    });
+    return chosen;
+}
+
+bool QFATFileSystem::freeClusterCount(quint32 &count)
+{
+    // A trusted FSInfo count saves scanning the FAT until something needs the free map anyway
+    if (!m_freeClusterMapLoaded && m_fsInfoCountUsable && m_fsInfoMode == QFATFSInfoMode::Trust) {
+        count = m_fsInfoFreeCount;
+        return true;
+    }
+
+    if (!ensureFreeClusterMap()) {
+        return false;
+    }
+
+    count = m_freeClusterCount;
+    return true;
+}
+
+QList<quint32> QFATFileSystem::allocateClusters(quint32 count, quint32 sizeHint, quint32 preferredStart)
+{
+    QList<quint32> chain;
+
+    if (count == 0 || !ensureFreeClusterMap() || m_freeClusterCount < count) {
+        return chain;
+    }
+
+    QList<QFATExtent> extents;
+
+    // Growing a chain straight after its last cluster keeps it in one piece
+    if (m_geometry.isDataCluster(preferredStart) && m_geometry.maxCluster - preferredStart >= count - 1) {
+        quint32 last = preferredStart + count - 1;
+        if (findClusterBit(m_freeClusterMap, false, preferredStart, last) > last) {
+            extents.append(QFATExtent(preferredStart, count));
+        }
+    }
+
+    // Otherwise the best-fitting run for the expected final size, then for this request alone
+    if (extents.isEmpty() && sizeHint > count) {
+        quint32 runStart = findFreeClusterRun(sizeHint);
+        if (runStart != 0) {
+            extents.append(QFATExtent(runStart, count));
+        }
+    }
+    if (extents.isEmpty()) {
+        quint32 runStart = findFreeClusterRun(count);
+        if (runStart != 0) {
+            extents.append(QFATExtent(runStart, count));
+        }
+    }
+
+    // No run is large enough, split the request over as few runs as possible
+    if (extents.isEmpty()) {
+        extents = findFewestFreeRuns(count);
+    }
+
+    chain = expandExtents(extents);
+
+    if (static_cast<quint32>(chain.size()) < count) {
+        return QList<quint32>();
+    }
+
+    // Link the chain and terminate it
+    quint32 endOfChain = fatEndOfChainMarker();
+    for (int i = 0; i < chain.size(); i++) {
+        quint32 next = (i + 1 < chain.size()) ? chain[i + 1] : endOfChain;
+        if (!writeFATEntry(chain[i], next)) {
+            // Roll back what was already linked
+            for (int j = 0; j < i; j++) {
+                writeFATEntry(chain[j], 0);
+            }
+            return QList<quint32>();
+        }
+    }
+
+    m_nextFreeCluster = chain.last() + 1;
+    if (m_nextFreeCluster > m_geometry.maxCluster) {
+        m_nextFreeCluster = 2;
+    }
+    m_fsInfoDirty = true;
+
+    return chain;
+}
+
+// ============================================================================
+// Cluster chains
+// ============================================================================
+
+QList<QFATExtent> QFATFileSystem::getClusterExtents(quint32 startCluster)
+{
+    QList<QFATExtent> extents;
+
+    if (!m_geometry.isDataCluster(startCluster)) {
+        return extents;
+    }
+
+    if (QList<QFATExtent> *cached = m_extentCache.object(startCluster)) {
+        return *cached;
+    }
+
+    // Walk the chain, merging consecutive clusters into one extent.
+    // The walk stops at end-of-chain, free or bad entries, and after clusterCount clusters to survive loops.
+    quint32 cluster = startCluster;
+    quint32 visited = 0;
+    QFATExtent current(startCluster, 1);
+
+    while (++visited < m_geometry.clusterCount) {
+        quint32 next = readFATEntry(cluster);
+        if (!m_geometry.isDataCluster(next)) {
+            break;
+        }
+
+        if (next == cluster + 1) {
+            current.length++;
+        } else {
+            extents.append(current);
+            current = QFATExtent(next, 1);
+        }
+        cluster = next;
+    }
+    extents.append(current);
+
+    m_extentCache.insert(startCluster, new QList<QFATExtent>(extents), extents.size());
+    return extents;
+}
+
+QList<quint32> QFATFileSystem::expandExtents(const QList<QFATExtent> &extents)
+{
+    QList<quint32> clusters;
+
+    for (const QFATExtent &extent : extents) {
+        for (quint32 i = 0; i < extent.length; i++) {
+            clusters.append(extent.startCluster + i);
+        }
+    }
+
+    return clusters;
+}
+
+QList<QFATExtent> QFATFileSystem::compactClusters(const QList<quint32> &clusters)
+{
+    QList<QFATExtent> extents;
+
+    for (quint32 cluster : clusters) {
+        if (!extents.isEmpty() && extents.last().startCluster + extents.last().length == cluster) {
+            extents.last().length++;
+        } else {
+            extents.append(QFATExtent(cluster, 1));
+        }
+    }
+
+    return extents;
+}
+
+QByteArray QFATFileSystem::readClusterRange(quint32 startCluster, quint32 offset, quint32 length)
+{
+    QByteArray data;
+
+    if (length == 0) {
+        return data;
+    }
+
+    QList<QFATExtent> extents = getClusterExtents(startCluster);
+
+    // A range within one run of a mapped image is returned as a view instead of a copy
+    if (m_mappedImage) {
+        quint64 extentStart = 0;
+        for (const QFATExtent &extent : extents) {
+            quint64 extentEnd = extentStart + static_cast<quint64>(extent.length) * m_geometry.clusterSize;
+            if (offset < extentEnd) {
+                const char *view = mappedRange(m_geometry.clusterOffset(extent.startCluster) + (offset - extentStart), length);
+                if (view && offset + length <= extentEnd) {
+                    return QByteArray::fromRawData(view, length);
+                }
+                break;
+            }
+            extentStart = extentEnd;
+        }
+    }
+
+    data.resize(length);
+    qint64 bytesRead = readExtents(extents, offset, data.data(), length);
+    data.resize(qMax<qint64>(bytesRead, 0));
+    return data;
+}
+
+qint64 QFATFileSystem::readExtents(const QList<QFATExtent> &extents, quint64 offset, char *data, qint64 length)
+{
+    qint64 bytesRead = 0;
+    quint64 extentStart = 0; // Byte position of the current extent within the chain
+
+    for (const QFATExtent &extent : extents) {
+        if (bytesRead >= length) {
+            break;
+        }
+
+        quint64 extentSize = static_cast<quint64>(extent.length) * m_geometry.clusterSize;
+        quint64 position = offset + bytesRead;
+
+        // Skip extents that end before the requested range without touching the device
+        if (position >= extentStart + extentSize) {
+            extentStart += extentSize;
+            continue;
+        }
+
+        quint64 offsetInExtent = position - extentStart;
+        quint64 remaining = qMin<quint64>(extentSize - offsetInExtent, length - bytesRead);
+
+        // One positional read per run of consecutive clusters, or a copy out of the mapping
+        quint64 devicePosition = m_geometry.clusterOffset(extent.startCluster) + offsetInExtent;
+        if (const char *mapped = mappedRange(devicePosition, remaining)) {
+            memcpy(data + bytesRead, mapped, remaining);
+            bytesRead += remaining;
+            extentStart += extentSize;
+            continue;
+        }
+
+        qint64 actualRead = m_blockCache->readAt(devicePosition, data + bytesRead, remaining);
+        if (actualRead < 0) {
+            return bytesRead > 0 ? bytesRead : -1;
+        }
+
+        bytesRead += actualRead;
+        if (static_cast<quint64>(actualRead) < remaining) {
+            return bytesRead;
+        }
+
+        extentStart += extentSize;
+    }
+
+    return bytesRead;
+}
+
+qint64 QFATFileSystem::writeExtents(const QList<QFATExtent> &extents, quint64 offset, const char *data, qint64 length)
+{
+    qint64 bytesWritten = 0;
+    quint64 extentStart = 0;
+
+    for (const QFATExtent &extent : extents) {
+        if (bytesWritten >= length) {
+            break;
+        }
+
+        quint64 extentSize = static_cast<quint64>(extent.length) * m_geometry.clusterSize;
+        quint64 position = offset + bytesWritten;
+
+        if (position >= extentStart + extentSize) {
+            extentStart += extentSize;
+            continue;
+        }
+
+        quint64 offsetInExtent = position - extentStart;
+        quint64 remaining = qMin<quint64>(extentSize - offsetInExtent, length - bytesWritten);
+
+        qint64 actualWritten = m_blockCache->writeAt(m_geometry.clusterOffset(extent.startCluster) + offsetInExtent,
+                                                     data + bytesWritten, remaining);
+        if (actualWritten < 0) {
+            return bytesWritten > 0 ? bytesWritten : -1;
+        }
+
+        bytesWritten += actualWritten;
+        if (static_cast<quint64>(actualWritten) < remaining) {
+            return bytesWritten;
+        }
+
+        extentStart += extentSize;
+    }
+
+    return bytesWritten;
+}
+
+bool QFATFileSystem::writeAllocatedClusters(const QList<quint32> &clusters, const QByteArray &data)
+{
+    QList<QFATExtent> extents = compactClusters(clusters);
+
+    // Written straight from the caller's buffer, one device write per run of consecutive clusters
+    if (writeExtents(extents, 0, data.constData(), data.size()) != data.size()) {
+        qWarning() << "Failed to write" << data.size() << "bytes to cluster chain starting at" << clusters.value(0);
+        return false;
+    }
+
+    // Only the last cluster can have slack, so never more than one cluster of padding
+    quint64 allocatedSize = static_cast<quint64>(clusters.size()) * m_geometry.clusterSize;
+    qint64 slack = static_cast<qint64>(allocatedSize - data.size());
+    if (slack > 0) {
+        QByteArray zeros(static_cast<int>(slack), 0);
+        if (writeExtents(extents, data.size(), zeros.constData(), slack) != slack) {
+            qWarning() << "Failed to zero-fill the last cluster of chain starting at" << clusters.value(0);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool QFATFileSystem::setFATCacheEnabled(bool enabled)
+{
+    if (enabled == m_fatCacheEnabled) {
+        return true;
+    }
+
+    if (!enabled) {
+        bool ok = flushFATCache();
+        m_fatCacheEnabled = false;
+        m_fatCache.clear();
+        m_fatDirtySectors.clear();
+        return ok;
+    }
+
+    if (!m_geometry.valid || !m_device->isOpen()) {
+        m_lastError = QFATError::DeviceNotOpen;
+        return false;
+    }
+
+    // Load the first FAT copy in one sequential read
+    QByteArray fat(m_geometry.fatSize, 0);
+    if (m_blockCache->readAt(m_geometry.fatOffset, fat.data(), fat.size()) != fat.size()) {
+        qWarning() << "Failed to load FAT into memory";
+        m_lastError = QFATError::ReadError;
+        return false;
+    }
+
+    m_fatCache = fat;
+    m_fatDirtySectors = QBitArray(m_geometry.sectorsPerFAT);
+    m_fatCacheEnabled = true;
+    return true;
+}
+
+bool QFATFileSystem::flushFATCache()
+{
+    if (!m_fatCacheEnabled) {
+        return true;
+    }
+
+    quint32 sectorCount = m_fatDirtySectors.size();
+    quint32 sector = 0;
+    bool ok = true;
+
+    // Write each run of consecutive dirty sectors to every FAT copy with a single write
+    while (sector < sectorCount) {
+        if (!m_fatDirtySectors.testBit(sector)) {
+            sector++;
+            continue;
+        }
+
+        quint32 runStart = sector;
+        while (sector < sectorCount && m_fatDirtySectors.testBit(sector)) {
+            sector++;
+        }
+
+        quint32 offset = runStart * m_geometry.bytesPerSector;
+        quint32 length = (sector - runStart) * m_geometry.bytesPerSector;
+        markFATMirrorDirty(offset, length);
+        for (quint8 i = 0; i < fatCopiesToWrite(); i++) {
+            quint64 position = m_geometry.fatOffset + static_cast<quint64>(i) * m_geometry.fatSize + offset;
+            if (m_blockCache->writeAt(position, m_fatCache.constData() + offset, length) != length) {
+                qWarning() << "Failed to write FAT sectors" << runStart << "to" << sector - 1;
+                ok = false;
+            }
+        }
+
+        if (ok) {
+            m_fatDirtySectors.fill(false, runStart, sector);
+        }
+    }
+
+    if (!ok) {
+        m_lastError = QFATError::WriteError;
+    }
+
+    return ok;
+}
+
+bool QFATFileSystem::setFATMirrorDeferred(bool deferred)
+{
+    if (deferred == m_fatMirrorDeferred) {
+        return true;
+    }
+
+    if (!deferred) {
+        // The FAT cache may still hold sectors that only ever reached the first copy
+        bool ok = flushFATCache() && syncFATMirrors();
+        m_fatMirrorDeferred = false;
+        m_fatMirrorDirtySectors.clear();
+        return ok;
+    }
+
+    m_fatMirrorDirtySectors = QBitArray(m_geometry.sectorsPerFAT);
+    m_fatMirrorDeferred = true;
+    return true;
+}
+
+void QFATFileSystem::markFATMirrorDirty(quint32 offset, quint32 length)
+{
+    if (!m_fatMirrorDeferred || m_geometry.numFATs < 2 || length == 0) {
+        return;
+    }
+
+    quint32 first = offset / m_geometry.bytesPerSector;
+    quint32 last = qMin<quint32>((offset + length - 1) / m_geometry.bytesPerSector, m_fatMirrorDirtySectors.size() - 1);
+    if (first <= last) {
+        m_fatMirrorDirtySectors.fill(true, first, last + 1);
+    }
+}
+
+bool QFATFileSystem::syncFATMirrors()
+{
+    if (!m_fatMirrorDeferred || m_geometry.numFATs < 2) {
+        return true;
+    }
+
+    quint32 sectorCount = m_fatMirrorDirtySectors.size();
+    quint32 sector = 0;
+    bool ok = true;
+
+    // Each run of changed sectors is read once from the first copy and written to every other copy
+    while (sector < sectorCount) {
+        if (!m_fatMirrorDirtySectors.testBit(sector)) {
+            sector++;
+            continue;
+        }
+
+        quint32 runStart = sector;
+        while (sector < sectorCount && m_fatMirrorDirtySectors.testBit(sector)) {
+            sector++;
+        }
+
+        quint32 offset = runStart * m_geometry.bytesPerSector;
+        quint32 length = (sector - runStart) * m_geometry.bytesPerSector;
+        QByteArray run;
+        if (m_fatCacheEnabled) {
+            run = m_fatCache.mid(offset, length);
+        } else {
+            run.resize(length);
+            if (m_blockCache->readAt(m_geometry.fatOffset + offset, run.data(), length) != length) {
+                qWarning() << "Failed to read FAT sectors" << runStart << "to" << sector - 1 << "for the mirror copies";
+                ok = false;
+                continue;
+            }
+        }
+
+        bool copied = true;
+        for (quint8 i = 1; i < m_geometry.numFATs; i++) {
+            quint64 position = m_geometry.fatOffset + static_cast<quint64>(i) * m_geometry.fatSize + offset;
+            if (m_blockCache->writeAt(position, run.constData(), run.size()) != run.size()) {
+                qWarning() << "Failed to write FAT copy" << i + 1 << "sectors" << runStart << "to" << sector - 1;
+                copied = false;
+            }
+        }
+
+        if (copied) {
+            m_fatMirrorDirtySectors.fill(false, runStart, sector);
+        }
+        ok = copied && ok;
+    }
+
+    if (!ok) {
+        m_lastError = QFATError::WriteError;
+    }
+
+    return ok;
+}
+
+bool QFATFileSystem::flush()
+{
+    if (!m_device || !m_device->isOpen() || m_batchDepth > 0) {
+        return true;
+    }
+
+    // The FAT cache, the FAT mirrors and FSInfo write through the block cache, so they go first
+    bool ok = flushFATCache();
+    ok = syncFATMirrors() && ok;
+    ok = flushFSInfo() && ok;
+    return m_blockCache->flush() && ok;
+}
+
+// ============================================================================
+// Batches
+// ============================================================================
+
+bool QFATFileSystem::beginBatch()
+{
+    if (m_batchDepth > 0) {
+        m_batchDepth++;
+        return true;
+    }
+
+    if (!m_device || !m_device->isOpen()) {
+        m_lastError = QFATError::DeviceNotOpen;
+        return false;
+    }
+
+    // Start from a clean device, with the whole FAT and the free map in memory
+    if (!flush()) {
+        m_lastError = QFATError::WriteError;
+        return false;
+    }
+    if (!ensureFreeClusterMap()) {
+        m_lastError = QFATError::ReadError;
+        return false;
+    }
+    m_batchFATCacheWasEnabled = m_fatCacheEnabled;
+    if (!setFATCacheEnabled(true)) {
+        return false;
+    }
+
+    m_batchFreed.clear();
+    m_batchAborted = false;
+    m_blockCache->setHoldMetadata(true);
+    m_batchDepth = 1;
+    return true;
+}
+
+bool QFATFileSystem::commitBatch(QFATError &error)
+{
+    if (m_batchDepth == 0) {
+        error = QFATError::NotInBatch;
+        m_lastError = error;
+        return false;
+    }
+
+    if (m_batchDepth > 1) {
+        m_batchDepth--;
+        error = m_batchAborted ? QFATError::BatchAborted : QFATError::None;
+        if (m_batchAborted) {
+            m_lastError = error;
+        }
+        return !m_batchAborted;
+    }
+
+    // Part of the batch was rolled back, committing the rest would be a partial batch
+    if (m_batchAborted) {
+        discardBatch();
+        error = QFATError::BatchAborted;
+        m_lastError = error;
+        return false;
+    }
+
+    // Freed clusters go out still marked as taken, so no entry on disk can point at a free cluster
+    for (auto it = m_batchFreed.constBegin(); it != m_batchFreed.constEnd(); ++it) {
+        writeFATEntry(it.key(), it.value());
+    }
+
+    // File contents first, nothing on disk points at them yet, then every FAT copy
+    bool ok = m_blockCache->flushRegion(QFATCacheRegion::Data) && m_blockCache->sync();
+    if (ok) {
+        ok = flushFATCache() && syncFATMirrors() && m_blockCache->flushRegion(QFATCacheRegion::FAT) && m_blockCache->sync();
+    }
+
+    // Then the directory entries, which may now refer to the new chains
+    if (ok) {
+        ok = m_blockCache->flushRegion(QFATCacheRegion::Directory) && m_blockCache->sync();
+    }
+
+    m_batchDepth = 0;
+    m_blockCache->setHoldMetadata(false);
+
+    // Freed clusters are only released once nothing refers to them any more. After a failure they
+    // stay allocated on disk, and whatever is still pending goes out with the next flush().
+    if (ok) {
+        for (auto it = m_batchFreed.constBegin(); it != m_batchFreed.constEnd(); ++it) {
+            writeFATEntry(it.key(), 0);
+        }
+        ok = flush() && m_blockCache->sync();
+    } else {
+        m_freeClusterMapLoaded = false;
+    }
+    m_batchFreed.clear();
+
+    if (!m_batchFATCacheWasEnabled) {
+        ok = setFATCacheEnabled(false) && ok;
+    }
+
+    if (!ok) {
+        qWarning() << "Failed to commit batch";
+        m_lastError = QFATError::WriteError;
+    }
+    error = ok ? QFATError::None : QFATError::WriteError;
+    return ok;
+}
+
+void QFATFileSystem::rollbackBatch()
+{
+    if (m_batchDepth == 0) {
+        return;
+    }
+
+    // A nested batch cannot be unwound on its own, the outer ones are doomed with it
+    if (m_batchDepth > 1) {
+        m_batchDepth--;
+        m_batchAborted = true;
+        return;
+    }
+
+    discardBatch();
+}
+
+void QFATFileSystem::discardBatch()
+{
+    // Held metadata never reached the device. File contents did, new ones in clusters that are still
+    // free there, in-place overwrites in clusters their files already owned, and those stay.
+    m_blockCache->discardWrites();
+    m_blockCache->setHoldMetadata(false);
+    m_batchDepth = 0;
+    m_batchAborted = false;
+    m_batchFreed.clear();
+
+    m_fatCacheEnabled = false;
+    m_fatCache.clear();
+    m_fatDirtySectors.clear();
+    if (m_batchFATCacheWasEnabled) {
+        setFATCacheEnabled(true);
+    }
+
+    // Everything derived from the discarded metadata is rebuilt from the device
+    m_freeClusterMapLoaded = false;
+    m_extentCache.clear();
+    m_directoryIndex.clear();
+    m_pathCache.clear();
+    loadFSInfo();
+}
+
+// ============================================================================
+// FAT32 FSInfo sector
+// ============================================================================
+
+void QFATFileSystem::loadFSInfo()
+{
+    if (m_geometry.type != QFATType::FAT32 || !m_geometry.valid || !m_device->isOpen()) {
+        return;
+    }
+
+    // The sector lives in the reserved area, 0 and 0xFFFF mean the volume has none
+    if (m_geometry.fsInfoSector == 0 || m_geometry.fsInfoSector >= m_geometry.reservedSectors) {
+        return;
+    }
+
+    uchar sector[BOOT_SECTOR_SIZE];
+    quint64 offset = static_cast<quint64>(m_geometry.fsInfoSector) * m_geometry.bytesPerSector;
+    if (m_blockCache->readAt(offset, reinterpret_cast<char *>(sector), BOOT_SECTOR_SIZE) != BOOT_SECTOR_SIZE) {
+        return;
+    }
+
+    if (qFromLittleEndian<quint32>(sector + FSINFO_LEAD_SIGNATURE_OFFSET) != FSINFO_LEAD_SIGNATURE
+        || qFromLittleEndian<quint32>(sector + FSINFO_STRUCT_SIGNATURE_OFFSET) != FSINFO_STRUCT_SIGNATURE
+        || qFromLittleEndian<quint32>(sector + FSINFO_TRAIL_SIGNATURE_OFFSET) != FSINFO_TRAIL_SIGNATURE) {
+        qWarning() << "Invalid FSInfo sector signatures";
+        return;
+    }
+
+    m_fsInfoLoaded = true;
+    m_fsInfoDirty = false;
+    m_fsInfoFreeCount = qFromLittleEndian<quint32>(sector + FSINFO_FREE_COUNT_OFFSET);
+    m_fsInfoNextFree = qFromLittleEndian<quint32>(sector + FSINFO_NEXT_FREE_OFFSET);
+
+    // Both values are hints, anything out of range is ignored
+    m_fsInfoCountUsable = (m_fsInfoFreeCount <= m_geometry.clusterCount);
+    if (m_geometry.isDataCluster(m_fsInfoNextFree)) {
+        m_nextFreeCluster = m_fsInfoNextFree;
+    }
+}
+
+bool QFATFileSystem::flushFSInfo()
+{
+    // Only what the allocator changed is written, a mount without changes leaves the sector as it was
+    if (!m_fsInfoLoaded || !m_fsInfoDirty || !(m_device->openMode() & QIODevice::WriteOnly)) {
+        return true;
+    }
+
+    // An exact count once the FAT was scanned, the loaded one while it still holds, unknown otherwise
+    quint32 freeCount = FSINFO_UNKNOWN;
+    if (m_freeClusterMapLoaded) {
+        freeCount = m_freeClusterCount;
+    } else if (m_fsInfoCountUsable) {
+        freeCount = m_fsInfoFreeCount;
+    }
+    quint32 nextFree = m_nextFreeCluster;
+
+    if (freeCount == m_fsInfoFreeCount && nextFree == m_fsInfoNextFree) {
+        m_fsInfoDirty = false;
+        return true;
+    }
+
+    uchar values[8];
+    qToLittleEndian<quint32>(freeCount, values);
+    qToLittleEndian<quint32>(nextFree, values + 4);
+
+    quint64 offset = static_cast<quint64>(m_geometry.fsInfoSector) * m_geometry.bytesPerSector + FSINFO_FREE_COUNT_OFFSET;
+    if (m_blockCache->writeAt(offset, reinterpret_cast<const char *>(values), sizeof(values)) != sizeof(values)) {
+        qWarning() << "Failed to update FSInfo sector";
+        m_lastError = QFATError::WriteError;
+        return false;
+    }
+
+    m_fsInfoFreeCount = freeCount;
+    m_fsInfoNextFree = nextFree;
+    m_fsInfoCountUsable = (freeCount != FSINFO_UNKNOWN);
+    m_fsInfoDirty = false;
+    return true;
+}
+
+bool QFATFileSystem::setBlockCacheSize(qint64 bytes)
+{
+    return m_blockCache->setCapacity(bytes);
+}
+
+bool QFATFileSystem::setBlockCachePolicy(QFATCacheRegion region, QFATCachePolicy policy)
+{
+    return m_blockCache->setPolicy(region, policy);
+}
+
+bool QFATFileSystem::writeFileFrom(const QString &path, QIODevice *source, QFATError &error, qint64 expectedSize)
+{
+    error = QFATError::None;
+
+    if (!source || !source->isReadable()) {
+        qWarning() << "writeFileFrom: source is not readable";
+        error = QFATError::ReadError;
+        m_lastError = error;
+        return false;
+    }
+
+    // Random-access sources know how much is left, that is as good as an expected size
+    if (expectedSize < 0 && !source->isSequential()) {
+        expectedSize = source->size() - source->pos();
+    }
+
+    QFATFile file(this, path);
+    file.setSizeHint(qMax<qint64>(expectedSize, 0));
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = (m_lastError != QFATError::None) ? m_lastError : QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+    m_lastError = QFATError::None;
+
+    // Whole clusters per chunk, so every write but the last fills the clusters it touches
+    qint64 chunkSize = qMax<qint64>(m_geometry.clusterSize, STREAM_CHUNK_SIZE / m_geometry.clusterSize * m_geometry.clusterSize);
+    QByteArray chunk(static_cast<int>(chunkSize), 0);
+
+    bool ok = true;
+    while (ok) {
+        qint64 bytesRead = source->read(chunk.data(), chunkSize);
+        if (bytesRead < 0) {
+            error = QFATError::ReadError;
+            ok = false;
+            break;
+        }
+        if (bytesRead == 0) {
+            // Sequential sources may simply not have the next piece yet
+            if (source->isSequential() && !source->atEnd()) {
+                if (source->waitForReadyRead(STREAM_READ_TIMEOUT_MS)) {
+                    continue;
+                }
+                // A source that stalls before its end is a truncated read, not the end of the file
+                qWarning() << "writeFileFrom: timed out waiting for more data for" << path;
+                error = QFATError::ReadError;
+                ok = false;
+            }
+            break;
+        }
+
+        if (file.write(chunk.constData(), bytesRead) != bytesRead) {
+            error = (m_lastError != QFATError::None) ? m_lastError : QFATError::WriteError;
+            ok = false;
+        }
+    }
+
+    // Finalize the directory entry with the size actually written
+    if (ok && !file.flush()) {
+        error = QFATError::WriteError;
+        ok = false;
+    }
+    file.close();
+
+    // Do not leave a truncated file behind
+    if (!ok) {
+        qWarning() << "writeFileFrom: failed to write" << path << ":" << file.errorString();
+        QFATError ignored;
+        deleteFile(path, ignored);
+        m_lastError = error;
+        return false;
+    }
+
+    return true;
+}
+
+bool QFATFileSystem::readFileTo(const QString &path, QIODevice *sink, QFATError &error)
+{
+    error = QFATError::None;
+
+    if (!sink || !sink->isWritable()) {
+        qWarning() << "readFileTo: sink is not writable";
+        error = QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+
+    return readFileChunks(path, [sink](const char *data, qint64 length) {
+        qint64 written = 0;
+        while (written < length) {
+            qint64 result = sink->write(data + written, length - written);
+            if (result < 0) {
+                return false;
+            }
+            if (result == 0 && !sink->waitForBytesWritten(STREAM_WRITE_TIMEOUT_MS)) {
+                return false;
+            }
+            written += result;
+        }
+
+        // Sockets and pipes buffer everything they accept, keep that bounded as well
+        while (sink->bytesToWrite() > STREAM_CHUNK_SIZE) {
+            if (!sink->waitForBytesWritten(STREAM_WRITE_TIMEOUT_MS)) {
+                return false;
+            }
+        }
+        return true;
+    }, error);
+}
+
+bool QFATFileSystem::readFileChunks(const QString &path, const QFATChunkHandler &handler, QFATError &error)
+{
+    error = QFATError::None;
+
+    if (!m_device->isOpen()) {
+        error = QFATError::DeviceNotOpen;
+        m_lastError = error;
+        return false;
+    }
+
+    QFATFileInfo info = getFileInfo(path, error);
+    if (error != QFATError::None) {
+        m_lastError = error;
+        return false;
+    }
+
+    if (info.isDirectory) {
+        error = QFATError::InvalidPath;
+        m_lastError = error;
+        return false;
+    }
+
+    if (info.size == 0 || info.cluster < 2) {
+        return true;
+    }
+
+    const QList<QFATExtent> extents = getClusterExtents(info.cluster);
+    const quint64 clusterSize = m_geometry.clusterSize;
+    const quint64 chunkLimit = qMax<quint64>(clusterSize, STREAM_CHUNK_SIZE / clusterSize * clusterSize);
+
+    QByteArray buffer;
+    quint64 remaining = info.size;
+
+    for (int i = 0; i < extents.size() && remaining > 0; i++) {
+        quint64 position = m_geometry.clusterOffset(extents[i].startCluster);
+        quint64 runLength = qMin<quint64>(extents[i].length * clusterSize, remaining);
+
+        // Let the device fetch the start of the next run while this one goes to the handler
+        if (i + 1 < extents.size() && remaining > runLength) {
+            quint64 nextLength = qMin<quint64>(extents[i + 1].length * clusterSize, remaining - runLength);
+            m_blockCache->prefetch(m_geometry.clusterOffset(extents[i + 1].startCluster), qMin(nextLength, chunkLimit));
+        }
+
+        while (runLength > 0) {
+            quint64 length = qMin(runLength, chunkLimit);
+
+            // Mapped images hand out the data in place, everything else goes through one reused buffer
+            const char *data = mappedRange(position, length);
+            if (!data) {
+                if (static_cast<quint64>(buffer.size()) < length) {
+                    buffer.resize(static_cast<int>(length));
+                }
+                if (m_blockCache->readAt(position, buffer.data(), length) != static_cast<qint64>(length)) {
+                    error = QFATError::ReadError;
+                    m_lastError = error;
+                    return false;
+                }
+                data = buffer.constData();
+            }
+
+            if (!handler(data, length)) {
+                qWarning() << "readFileChunks: stopped by the receiver while reading" << path;
+                error = QFATError::WriteError;
+                m_lastError = error;
+                return false;
+            }
+
+            position += length;
+            runLength -= length;
+            remaining -= length;
+        }
+    }
+
+    // The chain ended before the size recorded in the directory entry
+    if (remaining > 0) {
+        qWarning() << "readFileChunks: cluster chain shorter than file size for" << path;
+        error = QFATError::ReadError;
+        m_lastError = error;
+        return false;
+    }
+
+    return true;
+}
+
+bool QFATFileSystem::appendFile(const QString &path, const QByteArray &data, QFATError &error)
+{
+    return writeInPlace(path, -1, data, error);
+}
+
+bool QFATFileSystem::writeAt(const QString &path, quint32 offset, const QByteArray &data, QFATError &error)
+{
+    return writeInPlace(path, offset, data, error);
+}
+
+bool QFATFileSystem::writeInPlace(const QString &path, qint64 offset, const QByteArray &data, QFATError &error)
+{
+    error = QFATError::None;
+
+    if (!m_device->isOpen()) {
+        error = QFATError::DeviceNotOpen;
+        m_lastError = error;
+        return false;
+    }
+
+    bool append = offset < 0;
+    QFATFileInfo info = getFileInfo(path, error);
+    if (error == QFATError::None && info.isDirectory) {
+        error = QFATError::InvalidPath;
+    }
+    // Only appending creates missing files
+    if (error != QFATError::None && !(append && error == QFATError::FileNotFound)) {
+        m_lastError = error;
+        return false;
+    }
+    error = QFATError::None;
+
+    if (!append && static_cast<quint64>(offset) + data.size() > ENTRY_MAX_FILE_SIZE) {
+        error = QFATError::InsufficientSpace;
+        m_lastError = error;
+        return false;
+    }
+
+    // QFATFile extends the existing chain after its tail and writes only the bytes given
+    QFATFile file(this, path);
+    m_lastError = QFATError::None;
+    if (!file.open(append ? (QIODevice::WriteOnly | QIODevice::Append) : QIODevice::ReadWrite)) {
+        error = (m_lastError != QFATError::None) ? m_lastError : QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+
+    if (!append && !file.seek(offset)) {
+        error = QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+
+    if (file.write(data) != data.size()) {
+        error = (m_lastError != QFATError::None) ? m_lastError : QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+
+    // Size, cluster and modification time are the only entry fields that change
+    if (!file.flush()) {
+        qWarning() << "writeInPlace: failed to update directory entry for" << path;
+        error = QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+
+    return true;
+}
+
+bool QFATFileSystem::truncate(const QString &path, quint32 newSize, QFATError &error)
+{
+    error = QFATError::None;
+
+    if (!m_device->isOpen()) {
+        error = QFATError::DeviceNotOpen;
+        m_lastError = error;
+        return false;
+    }
+
+    QFATFileInfo info = getFileInfo(path, error);
+    if (error == QFATError::None && info.isDirectory) {
+        error = QFATError::InvalidPath;
+    }
+    if (error != QFATError::None) {
+        m_lastError = error;
+        return false;
+    }
+
+    QFATFile file(this, path);
+    m_lastError = QFATError::None;
+    if (!file.open(QIODevice::ReadWrite) || !file.resize(newSize)) {
+        qWarning() << "truncate: failed for" << path << ":" << file.errorString();
+        error = (m_lastError != QFATError::None) ? m_lastError : QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+
+    return true;
+}
+
+bool QFATFileSystem::preallocate(const QString &path, quint32 size, QFATError &error)
+{
+    error = QFATError::None;
+
+    if (!m_device->isOpen()) {
+        error = QFATError::DeviceNotOpen;
+        m_lastError = error;
+        return false;
+    }
+
+    QFATFileInfo info = getFileInfo(path, error);
+    if (error == QFATError::None && info.isDirectory) {
+        error = QFATError::InvalidPath;
+    }
+    if (error != QFATError::None && error != QFATError::FileNotFound) {
+        m_lastError = error;
+        return false;
+    }
+    error = QFATError::None;
+
+    // Opening read-write creates a missing file without truncating an existing one
+    QFATFile file(this, path);
+    m_lastError = QFATError::None;
+    if (!file.open(QIODevice::ReadWrite) || !file.reserve(size)) {
+        qWarning() << "preallocate: failed for" << path << ":" << file.errorString();
+        error = (m_lastError != QFATError::None) ? m_lastError : QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+
+    return true;
+}
+
+bool QFATFileSystem::relocateEntry(const QString &sourcePath, const QString &destPath, QFATError &error)
+{
+    error = QFATError::None;
+
+    if (!m_device->isOpen()) {
+        error = QFATError::DeviceNotOpen;
+        m_lastError = error;
+        return false;
+    }
+
+    QFATFileInfo sourceInfo = getFileInfo(sourcePath, error);
+    if (error != QFATError::None) {
+        m_lastError = error;
+        return false;
+    }
+
+    QStringList destParts = splitPath(destPath);
+    if (destParts.isEmpty()) {
+        error = QFATError::InvalidPath;
+        m_lastError = error;
+        return false;
+    }
+
+    QString destParentPath = destParts.size() > 1 ? "/" + destParts.mid(0, destParts.size() - 1).join("/") : "/";
+
+    // Destination must not exist yet
+    QFATError destError;
+    getFileInfo(destPath, destError);
+    if (destError == QFATError::None) {
+        error = QFATError::InvalidPath;
+        m_lastError = error;
+        return false;
+    }
+
+    // Walk down to the destination parent, 0 stands for the root directory as in '..' entries
+    quint32 destParentCluster = 0;
+    for (int i = 1; i < destParts.size(); i++) {
+        QFATError parentError;
+        QFATFileInfo parentInfo = getFileInfo("/" + destParts.mid(0, i).join("/"), parentError);
+        if (parentError != QFATError::None || !parentInfo.isDirectory) {
+            error = QFATError::DirectoryNotFound;
+            m_lastError = error;
+            return false;
+        }
+
+        // A directory cannot be moved into itself or below it
+        if (sourceInfo.isDirectory && parentInfo.cluster == sourceInfo.cluster) {
+            error = QFATError::InvalidPath;
+            m_lastError = error;
+            return false;
+        }
+        destParentCluster = parentInfo.cluster;
+    }
+
+    // The new entry is the old short entry under a new name, so cluster, size, attributes and all times carry over
+    QFATFileInfo destInfo = sourceInfo;
+    destInfo.longName = destParts.last();
+    destInfo.name = generateShortName(destInfo.longName, destParentPath == "/" ? listRootDirectory() : listDirectory(destParentPath));
+
+    quint8 shortEntry[ENTRY_SIZE];
+    quint64 sourceOffset = entryOffset(sourceInfo.entry);
+    if (sourceOffset == 0 || m_blockCache->readAt(sourceOffset, reinterpret_cast<char *>(shortEntry), ENTRY_SIZE) != ENTRY_SIZE) {
+        error = QFATError::ReadError;
+        m_lastError = error;
+        return false;
+    }
+    encodeShortName(destInfo.name, shortEntry + ENTRY_NAME_OFFSET);
+
+    // Marks whatever part of the new entry set was written as deleted again
+    QList<quint64> destOffsets;
+    auto discardDestEntries = [&]() {
+        const char deleted = static_cast<char>(ENTRY_DELETED);
+        bool discarded = true;
+        for (quint64 offset : destOffsets) {
+            if (m_blockCache->writeAt(offset, &deleted, 1) != 1) {
+                discarded = false;
+                continue;
+            }
+            invalidateDirectoryCaches(offset);
+        }
+        destOffsets.clear();
+        return discarded;
+    };
+
+    // With LFN entries so the long name survives a remount, a full directory gets the short entry alone
+    if (!writeEntrySet(destParentCluster, destInfo.longName, destInfo.name, shortEntry, destOffsets)) {
+        if (!discardDestEntries()) {
+            qWarning() << "Failed to remove a partially written entry for" << destPath;
+            error = QFATError::WriteError;
+            m_lastError = error;
+            return false;
+        }
+        if (!updateDirectoryEntry(destParentPath, destInfo)) {
+            error = QFATError::WriteError;
+            m_lastError = error;
+            return false;
+        }
+    }
+
+    // The old entry goes by the slot it was found at, with its LFN parts, not by a second lookup by name
+    if (!deleteEntrySet(sourceInfo.entry)) {
+        // Without this the clusters would be owned by two entries
+        bool discarded = true;
+        if (destOffsets.isEmpty()) {
+            discarded = deleteDirectoryEntry((destParentPath == "/" ? QString("/") : destParentPath + "/") + destInfo.name);
+        } else {
+            discarded = discardDestEntries();
+        }
+        if (!discarded) {
+            qWarning() << "Failed to remove the new entry for" << destPath << ", its clusters are now shared with" << sourcePath;
+        }
+        error = QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+
+    if (sourceInfo.isDirectory && sourceInfo.cluster >= 2) {
+        quint64 dotDotOffset = m_geometry.clusterOffset(sourceInfo.cluster) + ENTRY_SIZE;
+        quint8 entry[ENTRY_SIZE];
+        if (m_blockCache->readAt(dotDotOffset, reinterpret_cast<char *>(entry), ENTRY_SIZE) != ENTRY_SIZE) {
+            error = QFATError::ReadError;
+            m_lastError = error;
+            return false;
+        }
+
+        if (entry[0] == ENTRY_CURRENT_DIRECTORY && entry[1] == ENTRY_CURRENT_DIRECTORY) {
+            qToLittleEndian<quint16>(static_cast<quint16>(destParentCluster & 0xFFFF), entry + ENTRY_CLUSTER_OFFSET);
+            if (m_geometry.type == QFATType::FAT32) {
+                qToLittleEndian<quint16>(static_cast<quint16>(destParentCluster >> 16), entry + ENTRY_HIGH_ORDER_CLUSTER_ADDRESS_OFFSET);
+            }
+            if (m_blockCache->writeAt(dotDotOffset, reinterpret_cast<const char *>(entry), ENTRY_SIZE) != ENTRY_SIZE) {
+                error = QFATError::WriteError;
+                m_lastError = error;
+                return false;
+            }
+            invalidateDirectoryCaches(dotDotOffset);
+        }
+    }
+
+    return true;
+}
+
+bool QFATFileSystem::setFileTimes(const QFATEntryHandle &handle, const QDateTime &created, const QDateTime &modified, QFATError &error)
+{
+    return patchDirectoryEntry(handle, [&](quint8 *entry) {
+        if (memcmp(entry + ENTRY_NAME_OFFSET, handle.shortName, ENTRY_NAME_LENGTH) != 0) {
+            return false; // The slot was reused by another entry
+        }
+
+        quint16 date;
+        quint16 time;
+        if (created.isValid()) {
+            encodeFATDateTime(created, date, time);
+            qToLittleEndian<quint16>(time, entry + ENTRY_CREATION_DATE_TIME_OFFSET);
+            qToLittleEndian<quint16>(date, entry + ENTRY_CREATION_DATE_TIME_OFFSET + 2);
+        }
+        if (modified.isValid()) {
+            encodeFATDateTime(modified, date, time);
+            qToLittleEndian<quint16>(time, entry + ENTRY_WRITTEN_DATE_TIME_OFFSET);
+            qToLittleEndian<quint16>(date, entry + ENTRY_WRITTEN_DATE_TIME_OFFSET + 2);
+        }
+        return true;
+    }, error);
+}
 
-#include "internal_constants.h"
-#include "qfatfilesystem.h"
+bool QFATFileSystem::setFileTimes(const QString &path, const QDateTime &created, const QDateTime &modified, QFATError &error)
+{
+    QFATFileInfo info = getFileInfo(path, error);
+    if (error == QFATError::None && !info.entry.isValid()) {
+        error = QFATError::InvalidPath; // The root directory has no entry
+    }
+    if (error != QFATError::None) {
+        m_lastError = error;
+        return false;
+    }
 
-// ============================================================================
-// Base class: QFATFileSystem
-// ============================================================================
+    return setFileTimes(info.entry, created, modified, error);
+}
 
-QFATFileSystem::QFATFileSystem(QSharedPointer<QIODevice> device)
-    : m_device(device)
-    , m_lastError(QFATError::None)
+bool QFATFileSystem::setAttributes(const QFATEntryHandle &handle, quint8 attributes, QFATError &error)
 {
-    m_stream.setDevice(m_device.data());
-    // Set byte order to Little Endian so that the data is read correctly
-    m_stream.setByteOrder(QDataStream::LittleEndian);
+    return patchDirectoryEntry(handle, [&](quint8 *entry) {
+        if (memcmp(entry + ENTRY_NAME_OFFSET, handle.shortName, ENTRY_NAME_LENGTH) != 0) {
+            return false;
+        }
+
+        // Directory and volume label bits describe what the entry is, they are kept
+        entry[ENTRY_ATTRIBUTE_OFFSET] = (entry[ENTRY_ATTRIBUTE_OFFSET] & ~ENTRY_ATTRIBUTE_CHANGEABLE) | (attributes & ENTRY_ATTRIBUTE_CHANGEABLE);
+        return true;
+    }, error);
 }
 
-QFATFileSystem::~QFATFileSystem()
+bool QFATFileSystem::setAttributes(const QString &path, quint8 attributes, QFATError &error)
+{
+    QFATFileInfo info = getFileInfo(path, error);
+    if (error == QFATError::None && !info.entry.isValid()) {
+        error = QFATError::InvalidPath;
+    }
+    if (error != QFATError::None) {
+        m_lastError = error;
+        return false;
+    }
+
+    return setAttributes(info.entry, attributes, error);
+}
+
+quint64 QFATFileSystem::entryOffset(const QFATEntryHandle &handle)
+{
+    if (!handle.isValid()) {
+        return 0;
+    }
+
+    quint64 position = static_cast<quint64>(handle.slot) * ENTRY_SIZE;
+    if (handle.directoryCluster == 0) {
+        return (position + ENTRY_SIZE <= m_geometry.rootDirSize) ? m_geometry.rootDirOffset + position : 0;
+    }
+
+    // Extents of a directory are cached, so this is a short walk rather than a FAT traversal
+    quint64 extentStart = 0;
+    for (const QFATExtent &extent : getClusterExtents(handle.directoryCluster)) {
+        quint64 extentSize = static_cast<quint64>(extent.length) * m_geometry.clusterSize;
+        if (position < extentStart + extentSize) {
+            return m_geometry.clusterOffset(extent.startCluster) + (position - extentStart);
+        }
+        extentStart += extentSize;
+    }
+    return 0;
+}
+
+bool QFATFileSystem::patchDirectoryEntry(const QFATEntryHandle &handle, const std::function<bool(quint8 *)> &patch, QFATError &error)
+{
+    error = QFATError::None;
+
+    if (!m_device->isOpen()) {
+        error = QFATError::DeviceNotOpen;
+        m_lastError = error;
+        return false;
+    }
+
+    quint64 offset = entryOffset(handle);
+    if (offset == 0) {
+        error = QFATError::InvalidPath;
+        m_lastError = error;
+        return false;
+    }
+
+    quint8 entry[ENTRY_SIZE];
+    if (m_blockCache->readAt(offset, reinterpret_cast<char *>(entry), ENTRY_SIZE) != ENTRY_SIZE) {
+        error = QFATError::ReadError;
+        m_lastError = error;
+        return false;
+    }
+
+    // The handle went stale if its entry was deleted or the slot now holds something else
+    if (!isValidEntry(entry) || isLongFileNameEntry(entry) || !patch(entry)) {
+        error = QFATError::FileNotFound;
+        m_lastError = error;
+        return false;
+    }
+    if (m_blockCache->writeAt(offset, reinterpret_cast<const char *>(entry), ENTRY_SIZE) != ENTRY_SIZE) {
+        error = QFATError::WriteError;
+        m_lastError = error;
+        return false;
+    }
+
+    // Names are unchanged, so the directory index and the resolved paths of this entry are patched instead of dropped
+    QString longName;
+    QFATFileInfo updated = parseDirectoryEntry(entry, longName);
+    auto applyPatch = [&updated](QFATFileInfo &info) {
+        info.attributes = updated.attributes;
+        info.isDirectory = updated.isDirectory;
+        info.size = updated.size;
+        info.cluster = updated.cluster;
+        info.created = updated.created;
+        info.modified = updated.modified;
+    };
+
+    quint32 key = directoryKey(handle.directoryCluster);
+    if (QFATDirectoryIndex *index = m_directoryIndex.object(key)) {
+        auto it = std::lower_bound(index->entries.begin(), index->entries.end(), handle.slot,
+                                   [](const QFATFileInfo &info, quint32 slot) { return info.entry.slot < slot; });
+        if (it != index->entries.end() && it->entry.slot == handle.slot) {
+            applyPatch(*it);
+        }
+    }
+    for (const QString &path : m_pathCache.keys()) {
+        QFATPathCacheEntry *cached = m_pathCache.object(path);
+        if (cached->error == QFATError::None && cached->info.entry.slot == handle.slot
+            && directoryKey(cached->info.entry.directoryCluster) == key) {
+            applyPatch(cached->info);
+        }
+    }
+
+    return true;
+}
+
+QFATVolumeStats QFATFileSystem::volumeStats(QFATError &error)
 {
+    QFATVolumeStats stats;
+    error = QFATError::None;
+
+    if (!m_device->isOpen()) {
+        error = QFATError::DeviceNotOpen;
+        m_lastError = error;
+        return stats;
+    }
+
+    quint32 freeClusters;
+    if (!freeClusterCount(freeClusters)) {
+        error = QFATError::ReadError;
+        m_lastError = error;
+        return stats;
+    }
+
+    stats.clusterSize = m_geometry.clusterSize;
+    stats.totalClusters = m_geometry.clusterCount;
+    stats.freeClusters = freeClusters;
+    stats.totalBytes = static_cast<quint64>(stats.totalClusters) * stats.clusterSize;
+    stats.freeBytes = static_cast<quint64>(stats.freeClusters) * stats.clusterSize;
+    stats.usedBytes = stats.totalBytes - stats.freeBytes;
+    return stats;
 }
 
 QString QFATFileSystem::errorString() const
@@ -50,6 +2079,10 @@ QString QFATFileSystem::errorString() const
         return "Insufficient space";
     case QFATError::InvalidFileName:
         return "Invalid file name";
+    case QFATError::NotInBatch:
+        return "No batch open";
+    case QFATError::BatchAborted:
+        return "Batch aborted by a nested rollback";
     default:
         return "Unknown error";
     }
@@ -76,48 +2109,53 @@ QStringList QFATFileSystem::splitPath(const QString &path)
     return normalized.split('/', Qt::SkipEmptyParts);
 }
 
-QFATFileInfo QFATFileSystem::findInDirectory(const QList<QFATFileInfo> &entries, const QString &name)
+// A long name that is mostly non-ASCII or control characters is most likely left over garbage
+static bool isGarbageLongName(const QString &longName, const QString &shortName)
 {
-    QString upperName = name.toUpper();
+    // If long and short names are identical, it's not really an LFN
+    if (longName.toUpper() == shortName.toUpper()) {
+        return false;
+    }
+    int nonAsciiCount = 0;
+    for (const QChar &ch : longName) {
+        if (ch.unicode() > 127 || ch.unicode() < 32) {
+            nonAsciiCount++;
+        }
+    }
+    // If more than 50% of characters are non-ASCII, likely garbage
+    return longName.length() > 0 && (nonAsciiCount * 2 > longName.length());
+}
 
-    for (const QFATFileInfo &entry : entries) {
-        QString entryShortName = entry.name.toUpper();
-        QString entryLongName = entry.longName.toUpper();
+// Key of an entry written without a (usable) long name, or empty if it must only match by its own names
+static QString shortNameOnlyKey(const QFATFileInfo &entry)
+{
+    bool hasValidLFN = (entry.longName.toUpper() != entry.name.toUpper()) &&
+                       !isGarbageLongName(entry.longName, entry.name);
+    if (hasValidLFN) {
+        return QString();
+    }
 
-        // Match by exact name (short or long)
-        if (entryShortName == upperName) {
-            qDebug() << "[findInDirectory] Matched" << name << "to short:" << entry.name;
-            return entry;
-        } else if (entryLongName == upperName) {
-            qDebug() << "[findInDirectory] Matched" << name << "to long:" << entry.longName;
-            return entry;
-        }
+    QString entryBase = entry.name.toUpper();
+    QString entryExt;
+    int entryDot = entryBase.lastIndexOf('.');
+    if (entryDot > 0) {
+        entryExt = entryBase.mid(entryDot + 1);
+        entryBase = entryBase.left(entryDot);
     }
 
-    // Helper lambda to detect if a long name looks like garbage
-    auto isGarbageLFN = [](const QString &longName, const QString &shortName) -> bool {
-        // If long and short names are identical, it's not really an LFN
-        if (longName.toUpper() == shortName.toUpper()) {
-            return false;
-        }
-        // Check if longName contains mostly non-ASCII or control characters (likely garbage)
-        int nonAsciiCount = 0;
-        for (const QChar &ch : longName) {
-            if (ch.unicode() > 127 || ch.unicode() < 32) {
-                nonAsciiCount++;
-            }
-        }
-        // If more than 50% of characters are non-ASCII, likely garbage
-        return longName.length() > 0 && (nonAsciiCount * 2 > longName.length());
-    };
+    // Entries with tails (like "TESTFI~1.TXT") cannot be reliably matched without LFN entries,
+    // as we can't distinguish between "testfile0.txt" and "testfile1.txt"
+    if (entryBase.contains("~")) {
+        return QString();
+    }
 
-    // If no direct match found, try to find entries that were written without LFN entries.
-    // For such entries, longName == name (both are the short name).
-    // We need to check if any of these could match the search name.
+    return entryBase + "." + entryExt;
+}
 
-    // Generate what the base short name would be (without considering duplicates)
-    QString searchUpper = name.toUpper();
-    QString searchBase = searchUpper;
+// Key the short name generated for name would have, or empty if it would need a numeric tail
+static QString shortNameSearchKey(const QString &name)
+{
+    QString searchBase = name.toUpper();
     QString searchExt;
 
     int dotPos = searchBase.lastIndexOf('.');
@@ -131,64 +2169,206 @@ QFATFileInfo QFATFileSystem::findInDirectory(const QList<QFATFileInfo> &entries,
     searchBase.remove(QRegularExpression("[^A-Z0-9_^$~!#%&\\-{}@'`()]"));
     searchExt.remove(QRegularExpression("[^A-Z0-9_^$~!#%&\\-{}@'`()]"));
 
-    // Check if the name would need truncation
+    // If "testfile0.txt" truncates to "TESTFI", we should NOT match an existing "TESTFI.TXT"
+    // because they are different files.
     bool needsTruncation = (searchBase.length() > 8 || searchExt.length() > 3 ||
                            searchBase != originalBase); // Invalid chars were removed
+    if (needsTruncation) {
+        return QString();
+    }
 
     if (searchBase.length() > 6) {
         searchBase = searchBase.left(6);
     }
-    if (searchExt.length() > 3) {
-        searchExt = searchExt.left(3);
-    }
 
+    return searchBase + "." + searchExt;
+}
+
+QFATFileInfo QFATFileSystem::findInDirectory(const QList<QFATFileInfo> &entries, const QString &name)
+{
+    QString upperName = name.toUpper();
 
     for (const QFATFileInfo &entry : entries) {
         QString entryShortName = entry.name.toUpper();
+        QString entryLongName = entry.longName.toUpper();
+
+        // Match by exact name (short or long)
+        if (entryShortName == upperName) {
+            qDebug() << "[findInDirectory] Matched" << name << "to short:" << entry.name;
+            return entry;
+        } else if (entryLongName == upperName) {
+            qDebug() << "[findInDirectory] Matched" << name << "to long:" << entry.longName;
+            return entry;
+        }
+    }
+
+    // If no direct match found, try to find entries that were written without LFN entries.
+    // For such entries, longName == name (both are the short name).
+    QString searchKey = shortNameSearchKey(name);
+    if (searchKey.isEmpty()) {
+        return QFATFileInfo();
+    }
 
-        // Only match entries where longName == name (no LFN written) OR where longName is garbage
-        // Skip entries with valid LFNs
-        bool hasValidLFN = (entry.longName.toUpper() != entry.name.toUpper()) &&
-                           !isGarbageLFN(entry.longName, entry.name);
+    for (const QFATFileInfo &entry : entries) {
+        if (shortNameOnlyKey(entry) == searchKey) {
+            return entry;
+        }
+    }
 
-        if (hasValidLFN) {
-            // This entry has a valid LFN, skip it for fallback matching
-            continue;
+    return QFATFileInfo();
+}
+
+QFATFileInfo QFATFileSystem::findInDirectory(quint32 dirCluster, const QString &name)
+{
+    QFATDirectoryIndex *index = directoryIndex(dirCluster);
+    if (!index) {
+        return QFATFileInfo();
+    }
+
+    int position = index->byName.value(name.toUpper(), -1);
+    if (position >= 0) {
+        return index->entries.at(position);
+    }
+
+    QString searchKey = shortNameSearchKey(name);
+    if (!searchKey.isEmpty()) {
+        position = index->byShortNameOnly.value(searchKey, -1);
+        if (position >= 0) {
+            return index->entries.at(position);
         }
+    }
+
+    return QFATFileInfo();
+}
+
+QFATDirectoryIndex *QFATFileSystem::directoryIndex(quint32 dirCluster)
+{
+    if (!m_device->isOpen()) {
+        return nullptr;
+    }
+
+    dirCluster = directoryKey(dirCluster);
+    if (QFATDirectoryIndex *cached = m_directoryIndex.object(dirCluster)) {
+        return cached;
+    }
 
-        // Entry either has no LFN or has garbage LFN - treat it as short-name-only
-        if (entry.longName.toUpper() != entry.name.toUpper()) {
+    QFATDirectoryIndex *index = new QFATDirectoryIndex;
+    if (dirCluster == 0) {
+        index->entries = readDirectoryEntries(m_geometry.rootDirOffset, m_geometry.rootDirSize);
+    } else if (m_geometry.isDataCluster(dirCluster)) {
+        index->entries = readDirectoryChain(dirCluster);
+    }
+
+    // Earlier entries win, so lookups return the same entry a linear scan would
+    for (int i = 0; i < index->entries.size(); i++) {
+        const QFATFileInfo &entry = index->entries.at(i);
+        QString shortName = entry.name.toUpper();
+        QString longName = entry.longName.toUpper();
+        if (!index->byName.contains(shortName)) {
+            index->byName.insert(shortName, i);
+        }
+        if (!longName.isEmpty() && !index->byName.contains(longName)) {
+            index->byName.insert(longName, i);
         }
 
-        // Parse the entry's short name
-        QString entryBase = entryShortName;
-        QString entryExt;
-        int entryDot = entryBase.lastIndexOf('.');
-        if (entryDot > 0) {
-            entryExt = entryBase.mid(entryDot + 1);
-            entryBase = entryBase.left(entryDot);
+        QString key = shortNameOnlyKey(entry);
+        if (!key.isEmpty() && !index->byShortNameOnly.contains(key)) {
+            index->byShortNameOnly.insert(key, i);
         }
+    }
 
+    // A directory never holds more entries than the cache allows, so the insertion always succeeds
+    m_directoryIndex.insert(dirCluster, index, qMax(1, index->entries.size()));
+    return m_directoryIndex.object(dirCluster);
+}
 
-        // Check if extensions match
-        if (entryExt != searchExt) {
-            continue;
+quint32 QFATFileSystem::directoryKey(quint32 dirCluster) const
+{
+    // ".." entries of first-level directories point at cluster 0, which is the FAT32 root cluster
+    if (dirCluster == 0 && m_geometry.type == QFATType::FAT32) {
+        return m_geometry.rootDirCluster;
+    }
+    return dirCluster;
+}
+
+bool QFATFileSystem::directoryContainsCluster(quint32 dirCluster, quint32 cluster)
+{
+    if (dirCluster == 0) {
+        return cluster == 0;
+    }
+
+    for (const QFATExtent &extent : getClusterExtents(dirCluster)) {
+        if (cluster >= extent.startCluster && cluster < extent.startCluster + extent.length) {
+            return true;
         }
+    }
+    return false;
+}
 
-        // Match if the base names are identical
-        // This works for entries without tails (like "EMPTY_.TXT")
-        // Entries with tails (like "TESTFI~1.TXT") cannot be reliably matched
-        // without LFN entries, as we can't distinguish between "testfile0.txt" and "testfile1.txt"
-        //
-        // IMPORTANT: Only match if the search name did NOT need truncation.
-        // If "testfile0.txt" truncates to "TESTFI", we should NOT match an existing "TESTFI.TXT"
-        // because they are different files.
-        if (entryBase == searchBase && !entryBase.contains("~") && !needsTruncation) {
-            return entry;
+QString QFATFileSystem::pathCacheKey(const QStringList &parts) const
+{
+    return parts.join("/").toUpper();
+}
+
+bool QFATFileSystem::lookupPathCache(const QString &key, QFATFileInfo &info, QFATError &error)
+{
+    QFATPathCacheEntry *entry = m_pathCache.object(key);
+    if (!entry) {
+        return false;
+    }
+
+    info = entry->info;
+    error = entry->error;
+    if (error != QFATError::None) {
+        m_lastError = error;
+    }
+    return true;
+}
+
+QFATFileInfo QFATFileSystem::cachePathResult(const QString &key, const QFATFileInfo &info, QFATError error, const QList<quint32> &directories)
+{
+    QFATPathCacheEntry *entry = new QFATPathCacheEntry;
+    entry->info = info;
+    entry->error = error;
+    entry->directories = directories;
+    m_pathCache.insert(key, entry);
+    return info;
+}
+
+void QFATFileSystem::invalidateDirectoryCaches(quint64 entryOffset)
+{
+    // Entries in front of the data area belong to the fixed FAT12/16 root directory
+    quint32 cluster = 0;
+    if (entryOffset >= m_geometry.dataOffset) {
+        cluster = static_cast<quint32>((entryOffset - m_geometry.dataOffset) >> m_geometry.clusterShift) + 2;
+    }
+
+    QList<quint32> changed;
+    for (quint32 dirCluster : m_directoryIndex.keys()) {
+        if (directoryContainsCluster(dirCluster, cluster)) {
+            m_directoryIndex.remove(dirCluster);
+            changed.append(dirCluster);
         }
     }
 
-    return QFATFileInfo();
+    // Directories traversed by cached paths may not be indexed anymore, check them once each
+    QHash<quint32, bool> affected;
+    for (quint32 dirCluster : changed) {
+        affected.insert(dirCluster, true);
+    }
+
+    for (const QString &key : m_pathCache.keys()) {
+        QFATPathCacheEntry *entry = m_pathCache.object(key);
+        for (quint32 dirCluster : entry->directories) {
+            if (!affected.contains(dirCluster)) {
+                affected.insert(dirCluster, directoryContainsCluster(dirCluster, cluster));
+            }
+            if (affected.value(dirCluster)) {
+                m_pathCache.remove(key);
+                break;
+            }
+        }
+    }
 }
 
 void QFATFileSystem::encodeFATDateTime(const QDateTime &dt, quint16 &date, quint16 &time)
@@ -272,11 +2452,10 @@ QString QFATFileSystem::generateShortName(const QString &longName, const QList<Q
 }
 
 // Calculate LFN checksum for a short name (in 8.3 format with padding)
-quint8 QFATFileSystem::calculateLFNChecksum(const QString &shortName)
+void QFATFileSystem::encodeShortName(const QString &shortName, quint8 *name)
 {
     // Convert short name to 11-byte format (8 chars + 3 extension, space-padded)
-    quint8 name[11];
-    for (int i = 0; i < 11; i++) {
+    for (int i = 0; i < ENTRY_NAME_LENGTH; i++) {
         name[i] = ' ';
     }
 
@@ -296,8 +2475,18 @@ quint8 QFATFileSystem::calculateLFNChecksum(const QString &shortName)
             name[8 + i] = ext[i].toLatin1();
         }
     }
+}
+
+quint8 QFATFileSystem::calculateLFNChecksum(const QString &shortName)
+{
+    quint8 name[ENTRY_NAME_LENGTH];
+    encodeShortName(shortName, name);
+    return calculateLFNChecksum(name);
+}
 
-    // Calculate checksum
+quint8 QFATFileSystem::calculateLFNChecksum(const quint8 *name)
+{
+    // Calculate checksum over the 11 raw name bytes
     quint8 checksum = 0;
     for (int i = 0; i < 11; i++) {
         checksum = ((checksum & 1) << 7) + (checksum >> 1) + name[i];
@@ -331,7 +2520,7 @@ void QFATFileSystem::writeLFNEntry(quint8 *entry, const QString &longName, int s
     entry[ENTRY_ATTRIBUTE_OFFSET] = ENTRY_ATTRIBUTE_LONG_FILE_NAME;
 
     // Set checksum
-    entry[0x0D] = checksum;
+    entry[ENTRY_LFN_CHECKSUM_OFFSET] = checksum;
 
     // Calculate starting position in long name (0-based, counting from end)
     int startPos = (sequence - 1) * 13;
@@ -362,6 +2551,123 @@ void QFATFileSystem::writeLFNEntry(quint8 *entry, const QString &longName, int s
     }
 }
 
+bool QFATFileSystem::writeEntrySet(quint32 directoryCluster, const QString &longName, const QString &shortName, const quint8 *shortEntry, QList<quint64> &offsets)
+{
+    offsets.clear();
+    quint32 key = directoryKey(directoryCluster);
+
+    // Load the whole directory to look for a long enough run of free slots
+    QByteArray buffer;
+    if (key == 0) {
+        buffer.resize(m_geometry.rootDirSize);
+        if (m_blockCache->readAt(m_geometry.rootDirOffset, buffer.data(), buffer.size()) != buffer.size()) {
+            return false;
+        }
+    } else {
+        QList<QFATExtent> extents = getClusterExtents(key);
+        quint64 size = 0;
+        for (const QFATExtent &extent : extents) {
+            size += static_cast<quint64>(extent.length) * m_geometry.clusterSize;
+        }
+        buffer.resize(static_cast<int>(qMin<quint64>(size, MAX_DIRECTORY_SIZE)));
+        qint64 bytesRead = readExtents(extents, 0, buffer.data(), buffer.size());
+        if (bytesRead <= 0) {
+            return false;
+        }
+        buffer.resize(bytesRead);
+    }
+
+    // LFN entries are only needed when the short name does not already spell the long one
+    bool needsLFN = !longName.isEmpty() && longName.toUpper() != shortName.toUpper();
+    int needed = (needsLFN ? calculateLFNEntriesNeeded(longName) : 0) + 1;
+
+    // Everything after the end-of-directory marker is free as well
+    quint32 slotCount = buffer.size() / ENTRY_SIZE;
+    quint32 runStart = 0;
+    int runLength = 0;
+    bool pastEnd = false;
+    for (quint32 slot = 0; slot < slotCount && runLength < needed; slot++) {
+        quint8 firstByte = static_cast<quint8>(buffer[slot * ENTRY_SIZE]);
+        pastEnd = pastEnd || firstByte == ENTRY_END_OF_DIRECTORY;
+        if (pastEnd || firstByte == ENTRY_DELETED) {
+            if (runLength == 0) {
+                runStart = slot;
+            }
+            runLength++;
+        } else {
+            runLength = 0;
+        }
+    }
+    if (runLength < needed) {
+        return false;
+    }
+
+    // Highest LFN sequence first, the short entry last
+    quint8 checksum = calculateLFNChecksum(shortName);
+    for (int i = 0; i < needed; i++) {
+        quint8 entry[ENTRY_SIZE];
+        if (i == needed - 1) {
+            memcpy(entry, shortEntry, ENTRY_SIZE);
+        } else {
+            int sequence = needed - 1 - i;
+            writeLFNEntry(entry, longName, sequence, checksum, i == 0);
+        }
+
+        QFATEntryHandle handle;
+        handle.directoryCluster = key;
+        handle.slot = runStart + i;
+        quint64 offset = entryOffset(handle);
+        if (offset == 0 || m_blockCache->writeAt(offset, reinterpret_cast<const char *>(entry), ENTRY_SIZE) != ENTRY_SIZE) {
+            return false;
+        }
+        invalidateDirectoryCaches(offset);
+        offsets.append(offset);
+    }
+
+    return true;
+}
+
+bool QFATFileSystem::deleteEntrySet(const QFATEntryHandle &handle)
+{
+    quint8 entry[ENTRY_SIZE];
+    quint64 offset = entryOffset(handle);
+    if (offset == 0 || m_blockCache->readAt(offset, reinterpret_cast<char *>(entry), ENTRY_SIZE) != ENTRY_SIZE
+        || !isValidEntry(entry) || isLongFileNameEntry(entry)) {
+        return false;
+    }
+    quint8 checksum = calculateLFNChecksum(entry + ENTRY_NAME_OFFSET);
+
+    // The parts sit right before the short entry, the one flagged last comes first
+    QList<quint64> offsets;
+    offsets.append(offset);
+    QFATEntryHandle part = handle;
+    while (part.slot > 0) {
+        part.slot--;
+        quint64 partOffset = entryOffset(part);
+        if (partOffset == 0 || m_blockCache->readAt(partOffset, reinterpret_cast<char *>(entry), ENTRY_SIZE) != ENTRY_SIZE) {
+            break;
+        }
+        if (isDeletedEntry(entry) || !isLongFileNameEntry(entry) || entry[ENTRY_LFN_CHECKSUM_OFFSET] != checksum) {
+            break;
+        }
+        offsets.append(partOffset);
+        if (entry[ENTRY_NAME_OFFSET] & ENTRY_LFN_SEQUENCE_LAST_MASK) {
+            break;
+        }
+    }
+
+    // Short entry first, a crash part way through only leaves orphaned LFN parts
+    const char deleted = static_cast<char>(ENTRY_DELETED);
+    for (quint64 entryPosition : offsets) {
+        if (m_blockCache->writeAt(entryPosition, &deleted, 1) != 1) {
+            return false;
+        }
+        invalidateDirectoryCaches(entryPosition);
+    }
+
+    return true;
+}
+
 // Helper methods for reading BPB values
 quint16 QFATFileSystem::readBytesPerSector()
 {
@@ -403,19 +2709,19 @@ quint16 QFATFileSystem::readRootEntryCount()
     return value;
 }
 
-bool QFATFileSystem::isLongFileNameEntry(quint8 *entry)
+bool QFATFileSystem::isLongFileNameEntry(const quint8 *entry)
 {
-    // Long filename entries have attribute long file name
-    return (entry[ENTRY_ATTRIBUTE_OFFSET] & ENTRY_ATTRIBUTE_LONG_FILE_NAME) != 0;
+    // Long filename entries carry exactly read-only, hidden, system and volume label, a plain file may have some of them
+    return (entry[ENTRY_ATTRIBUTE_OFFSET] & ENTRY_ATTRIBUTE_LONG_FILE_NAME_MASK) == ENTRY_ATTRIBUTE_LONG_FILE_NAME;
 }
 
-bool QFATFileSystem::isDeletedEntry(quint8 *entry)
+bool QFATFileSystem::isDeletedEntry(const quint8 *entry)
 {
     // Deleted entries have the deleted attribute
     return entry[ENTRY_NAME_OFFSET] == ENTRY_DELETED;
 }
 
-bool QFATFileSystem::isValidEntry(quint8 *entry)
+bool QFATFileSystem::isValidEntry(const quint8 *entry)
 {
     // Valid entries don't start with end of directory, deleted, or current/parent directory
     if (entry[ENTRY_NAME_OFFSET] == ENTRY_END_OF_DIRECTORY || entry[ENTRY_NAME_OFFSET] == ENTRY_DELETED) {
@@ -433,7 +2739,7 @@ bool QFATFileSystem::isValidEntry(quint8 *entry)
     return true;
 }
 
-QString QFATFileSystem::readLongFileName(quint8 *entry)
+QString QFATFileSystem::readLongFileName(const quint8 *entry)
 {
     // Long filename entries contain UTF-16LE characters
     QString name;
@@ -464,7 +2770,7 @@ QString QFATFileSystem::readLongFileName(quint8 *entry)
     return name;
 }
 
-QFATFileInfo QFATFileSystem::parseDirectoryEntry(quint8 *entry, QString &longName)
+QFATFileInfo QFATFileSystem::parseDirectoryEntry(const quint8 *entry, QString &longName)
 {
     QFATFileInfo info;
 
@@ -541,14 +2847,14 @@ QDateTime QFATFileSystem::parseDateTime(quint16 date, quint16 time)
     // time: | hour (0-23, 5 bits) | minute (0-59, 6 bits) | second (0-59, 5 bits) |
     int year = ENTRY_DATE_TIME_START_OF_YEAR + ((date >> 9) & MASK_7_BITS);
     int month = (date >> 5) & MASK_4_BITS;
-    int day = (date & MASK_5_BITS) + 1;
+    int day = date & MASK_5_BITS;
     int hour = (time >> 11) & MASK_5_BITS;
     int minute = (time >> 5) & MASK_6_BITS;
     int second = (time & MASK_5_BITS) * 2;
     return QDateTime(QDate(year, month, day), QTime(hour, minute, second));
 }
 
-QList<QFATFileInfo> QFATFileSystem::readDirectoryEntries(quint32 offset, quint32 maxSize)
+QList<QFATFileInfo> QFATFileSystem::readDirectoryEntries(quint64 offset, quint32 maxSize)
 {
     QList<QFATFileInfo> files;
 
@@ -556,20 +2862,68 @@ QList<QFATFileInfo> QFATFileSystem::readDirectoryEntries(quint32 offset, quint32
         return files;
     }
 
-    m_stream.device()->seek(offset);
+    // Parsed in place when the image is mapped
+    if (const char *mapped = mappedRange(offset, maxSize)) {
+        return parseDirectoryEntries(QByteArray::fromRawData(mapped, maxSize), 0);
+    }
 
     QByteArray buffer(maxSize, 0);
-    qint64 bytesRead = m_stream.readRawData(buffer.data(), maxSize);
+    qint64 bytesRead = m_blockCache->readAt(offset, buffer.data(), maxSize);
 
     if (bytesRead <= 0) {
         return files;
     }
 
-    quint32 numEntries = bytesRead / (int)ENTRY_SIZE;
+    buffer.resize(bytesRead);
+    return parseDirectoryEntries(buffer, 0);
+}
+
+QList<QFATFileInfo> QFATFileSystem::readDirectoryChain(quint32 startCluster)
+{
+    // Size the buffer for the whole chain so each run of consecutive clusters is a single read
+    quint64 chainSize = 0;
+    QList<QFATExtent> extents = getClusterExtents(startCluster);
+    for (const QFATExtent &extent : extents) {
+        chainSize += static_cast<quint64>(extent.length) * m_geometry.clusterSize;
+    }
+    chainSize = qMin<quint64>(chainSize, MAX_DIRECTORY_SIZE);
+
+    if (chainSize == 0) {
+        return QList<QFATFileInfo>();
+    }
+
+    // Let the block cache treat these clusters as directory metadata from now on
+    for (const QFATExtent &extent : extents) {
+        for (quint32 i = 0; i < extent.length; i++) {
+            m_blockCache->setDirectoryCluster(extent.startCluster + i, true);
+        }
+    }
+
+    // A single run of a mapped image is parsed in place
+    if (extents.size() == 1) {
+        if (const char *mapped = mappedRange(m_geometry.clusterOffset(extents.first().startCluster), chainSize)) {
+            return parseDirectoryEntries(QByteArray::fromRawData(mapped, static_cast<int>(chainSize)), startCluster);
+        }
+    }
+
+    QByteArray buffer(static_cast<int>(chainSize), 0);
+    qint64 bytesRead = readExtents(extents, 0, buffer.data(), chainSize);
+    if (bytesRead <= 0) {
+        return QList<QFATFileInfo>();
+    }
+
+    buffer.resize(bytesRead);
+    return parseDirectoryEntries(buffer, startCluster);
+}
+
+QList<QFATFileInfo> QFATFileSystem::parseDirectoryEntries(const QByteArray &buffer, quint32 directoryCluster)
+{
+    QList<QFATFileInfo> files;
+    quint32 numEntries = buffer.size() / (int)ENTRY_SIZE;
     QString currentLongName;
 
     for (quint32 i = 0; i < numEntries; i++) {
-        quint8 *entry = reinterpret_cast<quint8 *>(buffer.data() + i * ENTRY_SIZE);
+        const quint8 *entry = reinterpret_cast<const quint8 *>(buffer.constData() + i * ENTRY_SIZE);
 
         if (entry[ENTRY_NAME_OFFSET] == ENTRY_END_OF_DIRECTORY) {
             // End of directory
@@ -601,6 +2955,9 @@ QList<QFATFileInfo> QFATFileSystem::readDirectoryEntries(quint32 offset, quint32
 
         if (isValidEntry(entry)) {
             QFATFileInfo info = parseDirectoryEntry(entry, currentLongName);
+            info.entry.directoryCluster = directoryCluster;
+            info.entry.slot = i;
+            memcpy(info.entry.shortName, entry + ENTRY_NAME_OFFSET, ENTRY_NAME_LENGTH);
             files.append(info);
             currentLongName.clear();
         }
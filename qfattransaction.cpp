@@ -0,0 +1,37 @@
+#include "qfatfilesystem.h"
+
+// ============================================================================
+// QFATTransaction
+// ============================================================================
+
+QFATTransaction::QFATTransaction(QFATFileSystem *fileSystem)
+    : m_fileSystem(fileSystem)
+    , m_active(fileSystem && fileSystem->beginBatch())
+{
+}
+
+QFATTransaction::~QFATTransaction()
+{
+    rollback();
+}
+
+bool QFATTransaction::commit(QFATError &error)
+{
+    if (!m_active) {
+        error = QFATError::NotInBatch;
+        return false;
+    }
+
+    m_active = false;
+    return m_fileSystem->commitBatch(error);
+}
+
+void QFATTransaction::rollback()
+{
+    if (!m_active) {
+        return;
+    }
+
+    m_active = false;
+    m_fileSystem->rollbackBatch();
+}
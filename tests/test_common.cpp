@@ -18,6 +18,9 @@ private slots:
 
     // File info structure tests
     void testFileInfoStructure();
+
+    // Volume geometry tests
+    void testVolumeGeometry();
 };
 
 void TestCommonOperations::testSmartPointerMemoryManagement()
@@ -98,5 +101,33 @@ void TestCommonOperations::testFileInfoStructure()
     QCOMPARE(info.cluster, quint32(5));
 }
 
+void TestCommonOperations::testVolumeGeometry()
+{
+    QScopedPointer<QFAT16FileSystem> fs16 = QFAT16FileSystem::create(TEST_FAT16_IMAGE_PATH);
+    QVERIFY(!fs16.isNull());
+
+    const QFATVolumeGeometry &g16 = fs16->geometry();
+    QVERIFY(g16.valid);
+    QCOMPARE(g16.type, QFATType::FAT16);
+    QCOMPARE(g16.clusterSize, static_cast<quint32>(g16.bytesPerSector) * g16.sectorsPerCluster);
+    QCOMPARE(1u << g16.clusterShift, g16.clusterSize);
+    QCOMPARE(g16.rootDirOffset, g16.fatOffset + g16.numFATs * g16.fatSize);
+    QCOMPARE(g16.dataOffset, g16.rootDirOffset + g16.rootDirSize);
+    QCOMPARE(g16.clusterOffset(2), g16.dataOffset);
+    QVERIFY(g16.clusterCount > 0);
+    QCOMPARE(g16.maxCluster, g16.clusterCount + 1);
+
+    QScopedPointer<QFAT32FileSystem> fs32 = QFAT32FileSystem::create(TEST_FAT32_IMAGE_PATH);
+    QVERIFY(!fs32.isNull());
+
+    const QFATVolumeGeometry &g32 = fs32->geometry();
+    QVERIFY(g32.valid);
+    QCOMPARE(g32.type, QFATType::FAT32);
+    QVERIFY(g32.rootDirCluster >= 2);
+    QCOMPARE(g32.dataOffset, g32.fatOffset + g32.numFATs * g32.fatSize);
+    QVERIFY(g32.isDataCluster(g32.rootDirCluster));
+    QVERIFY(!g32.isDataCluster(g32.maxCluster + 1));
+}
+
 QTEST_MAIN(TestCommonOperations)
 #include "test_common.moc"
@@ -1,5 +1,6 @@
 #include "../qfatfilesystem.h"
 #include <QDebug>
+#include <QtEndian>
 #include <QtTest/QtTest>
 
 const QString TEST_FAT12_IMAGE_PATH = "data/fat12.img";
@@ -11,6 +12,7 @@ private slots:
     // Filesystem info tests
     void testGetFreeSpace();
     void testGetTotalSpace();
+    void testFreeSpaceMatchesFAT();
 };
 
 void TestFAT12AdvancedOperations::testGetFreeSpace()
@@ -22,7 +24,7 @@ void TestFAT12AdvancedOperations::testGetFreeSpace()
     QVERIFY(!fs.isNull());
 
     QFATError error;
-    quint32 freeSpace = fs->getFreeSpace(error);
+    quint64 freeSpace = fs->getFreeSpace(error);
     QCOMPARE(error, QFATError::None);
     QVERIFY(freeSpace > 0);
 
@@ -40,11 +42,11 @@ void TestFAT12AdvancedOperations::testGetTotalSpace()
     QVERIFY(!fs.isNull());
 
     QFATError error;
-    quint32 totalSpace = fs->getTotalSpace(error);
+    quint64 totalSpace = fs->getTotalSpace(error);
     QCOMPARE(error, QFATError::None);
     QVERIFY(totalSpace > 0);
 
-    quint32 freeSpace = fs->getFreeSpace(error);
+    quint64 freeSpace = fs->getFreeSpace(error);
     QVERIFY(freeSpace <= totalSpace);
 
     qDebug() << "FAT12 total space:" << totalSpace << "bytes";
@@ -54,5 +56,50 @@ void TestFAT12AdvancedOperations::testGetTotalSpace()
     QFile::remove("test_fat12_totalspace.img");
 }
 
+void TestFAT12AdvancedOperations::testFreeSpaceMatchesFAT()
+{
+    QFile::copy(TEST_FAT12_IMAGE_PATH, "test_fat12_freescan.img");
+    QFile::setPermissions("test_fat12_freescan.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT12FileSystem> fs = QFAT12FileSystem::create("test_fat12_freescan.img");
+    QVERIFY(!fs.isNull());
+
+    // Leave an odd number of clusters in use so packed entries on both nibble positions change
+    QFATError error;
+    QVERIFY(fs->writeFile("/odd.bin", QByteArray(fs->geometry().clusterSize * 3, 'o'), error));
+    QVERIFY(fs->writeFile("/gap.bin", QByteArray(fs->geometry().clusterSize, 'g'), error));
+    QVERIFY(fs->deleteFile("/gap.bin", error));
+    QVERIFY(fs->flush());
+
+    const QFATVolumeGeometry geometry = fs->geometry();
+    QFile image("test_fat12_freescan.img");
+    QVERIFY(image.open(QIODevice::ReadOnly));
+    QVERIFY(image.seek(geometry.fatOffset));
+    QByteArray fat = image.read(geometry.fatSize);
+    image.close();
+
+    // Count free entries one at a time, independently of the library's bulk scan
+    quint32 freeClusters = 0;
+    const uchar *bytes = reinterpret_cast<const uchar *>(fat.constData());
+    for (quint32 cluster = 2; cluster <= geometry.maxCluster; cluster++) {
+        quint16 value = qFromLittleEndian<quint16>(bytes + cluster + cluster / 2);
+        quint16 entry = (cluster & 1) ? (value >> 4) : (value & 0x0FFF);
+        if (entry == 0) {
+            freeClusters++;
+        }
+    }
+
+    // A fresh mount scans the FAT from scratch
+    fs.reset();
+    fs.reset(QFAT12FileSystem::create("test_fat12_freescan.img").take());
+    QVERIFY(!fs.isNull());
+    QFATVolumeStats stats = fs->volumeStats(error);
+    QCOMPARE(error, QFATError::None);
+    QCOMPARE(stats.freeClusters, freeClusters);
+    QCOMPARE(fs->getFreeSpace(error), static_cast<quint64>(freeClusters) * geometry.clusterSize);
+
+    QFile::remove("test_fat12_freescan.img");
+}
+
 QTEST_MAIN(TestFAT12AdvancedOperations)
 #include "test_fat12_advanced.moc"
@@ -12,6 +12,8 @@ private slots:
     void testOverwriteFile();
     void testWriteEmptyFile();
     void testDeleteFile();
+    void testFATCopiesInSync();
+    void testUnalignedMultiClusterWrite();
 };
 
 void TestFAT12WriteOperations::testWriteSmallFile()
@@ -115,5 +117,78 @@ void TestFAT12WriteOperations::testDeleteFile()
     QFile::remove("test_fat12_delete.img");
 }
 
+void TestFAT12WriteOperations::testFATCopiesInSync()
+{
+    QFile::copy(TEST_FAT12_IMAGE_PATH, "test_fat12_fatcopies.img");
+    QFile::setPermissions("test_fat12_fatcopies.img", QFile::ReadUser | QFile::WriteUser);
+
+    {
+        QScopedPointer<QFAT12FileSystem> fs = QFAT12FileSystem::create("test_fat12_fatcopies.img");
+        QVERIFY(!fs.isNull());
+
+        QFATError error;
+        QVERIFY(fs->writeFile("/mirror.txt", QByteArray(3000, 'M'), error));
+        QCOMPARE(error, QFATError::None);
+    }
+
+    QScopedPointer<QFAT12FileSystem> fs = QFAT12FileSystem::create("test_fat12_fatcopies.img");
+    QVERIFY(!fs.isNull());
+    const QFATVolumeGeometry &geometry = fs->geometry();
+
+    // Allocation must update every FAT copy, not only the first one
+    QFile image("test_fat12_fatcopies.img");
+    QVERIFY(image.open(QIODevice::ReadOnly));
+    image.seek(geometry.fatOffset);
+    QByteArray firstFAT = image.read(geometry.fatSize);
+    for (quint8 i = 1; i < geometry.numFATs; i++) {
+        image.seek(geometry.fatOffset + i * geometry.fatSize);
+        QCOMPARE(image.read(geometry.fatSize), firstFAT);
+    }
+    image.close();
+
+    QFile::remove("test_fat12_fatcopies.img");
+}
+
+void TestFAT12WriteOperations::testUnalignedMultiClusterWrite()
+{
+    QFile::copy(TEST_FAT12_IMAGE_PATH, "test_fat12_unaligned.img");
+    QFile::setPermissions("test_fat12_unaligned.img", QFile::ReadUser | QFile::WriteUser);
+
+    quint32 clusterSize = 0;
+    QByteArray testData;
+    QFATFileInfo info;
+    QFATVolumeGeometry geometry;
+
+    {
+        QScopedPointer<QFAT12FileSystem> fs = QFAT12FileSystem::create("test_fat12_unaligned.img");
+        QVERIFY(!fs.isNull());
+        geometry = fs->geometry();
+        clusterSize = geometry.clusterSize;
+
+        testData.resize(clusterSize * 3 + 100);
+        for (int i = 0; i < testData.size(); i++) {
+            testData[i] = static_cast<char>(i % 251);
+        }
+
+        QFATError error;
+        QVERIFY(fs->writeFile("/unaligned.bin", testData, error));
+        QCOMPARE(fs->readFile("/unaligned.bin", error), testData);
+
+        info = fs->getFileInfo("/unaligned.bin", error);
+        QCOMPARE(error, QFATError::None);
+    }
+
+    // A fresh image has room for a contiguous run, so the slack after the data is in the last cluster
+    QFile image("test_fat12_unaligned.img");
+    QVERIFY(image.open(QIODevice::ReadOnly));
+    image.seek(geometry.clusterOffset(info.cluster));
+    QByteArray raw = image.read(clusterSize * 4);
+    QCOMPARE(raw.left(testData.size()), testData);
+    QCOMPARE(raw.mid(testData.size()), QByteArray(clusterSize - 100, 0));
+    image.close();
+
+    QFile::remove("test_fat12_unaligned.img");
+}
+
 QTEST_MAIN(TestFAT12WriteOperations)
 #include "test_fat12_write.moc"
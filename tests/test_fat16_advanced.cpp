@@ -1,5 +1,7 @@
 #include "../qfatfilesystem.h"
 #include <QDebug>
+#include <QThread>
+#include <QtEndian>
 #include <QtTest/QtTest>
 
 const QString TEST_FAT16_IMAGE_PATH = "data/fat16.img";
@@ -12,6 +14,7 @@ private slots:
     void testPartialRead();
     void testPartialReadWithOffset();
     void testPartialReadBeyondFile();
+    void testPartialReadAcrossClusters();
 
     // Rename tests
     void testRenameFile();
@@ -22,6 +25,7 @@ private slots:
     void testMoveFile();
     void testMoveDirectory();
     void testMoveToNonExistentDirectory();
+    void testMoveFromSecondDirectoryCluster();
 
     // Recursive directory deletion tests
     void testDeleteEmptyDirectoryNonRecursive();
@@ -31,6 +35,17 @@ private slots:
     // Filesystem info tests
     void testGetFreeSpace();
     void testGetTotalSpace();
+    void testFreeSpaceAccounting();
+
+    // Path cache tests
+    void testCachedMissesInvalidated();
+
+    // Positional I/O tests
+    void testConcurrentPositionalReads();
+
+    // Metadata update tests
+    void testSetFileTimes();
+    void testSetAttributes();
 };
 
 void TestFAT16AdvancedOperations::testPartialRead()
@@ -239,6 +254,91 @@ void TestFAT16AdvancedOperations::testMoveDirectory()
     QFile::remove("test_fat16_move_dir.img");
 }
 
+void TestFAT16AdvancedOperations::testMoveFromSecondDirectoryCluster()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_move_chain.img");
+    QFile::setPermissions("test_fat16_move_chain.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_move_chain.img");
+    QVERIFY(!fs.isNull());
+
+    QFATError error;
+    QVERIFY(fs->createDirectory("/deep", error));
+    QVERIFY(fs->writeFile("/deep/a long name.txt", "long", error));
+
+    // A cluster that is free again, to become the directory's second cluster
+    const QFATVolumeGeometry geometry = fs->geometry();
+    QVERIFY(fs->writeFile("/spare.bin", QByteArray(geometry.clusterSize, 's'), error));
+    quint16 second = fs->getFileInfo("/spare.bin", error).cluster;
+    QVERIFY(fs->deleteFile("/spare.bin", error));
+    quint16 first = fs->getFileInfo("/deep", error).cluster;
+    fs.reset();
+
+    // Chain the directory on to the second cluster and put an entry there. The unused slots of the
+    // first cluster become deleted entries so the listing runs on into the second cluster.
+    {
+        QFile image("test_fat16_move_chain.img");
+        QVERIFY(image.open(QIODevice::ReadWrite));
+        for (quint8 i = 0; i < geometry.numFATs; i++) {
+            quint64 fat = geometry.fatOffset + static_cast<quint64>(i) * geometry.fatSize;
+            uchar link[2];
+            qToLittleEndian<quint16>(second, link);
+            QVERIFY(image.seek(fat + first * 2));
+            QCOMPARE(image.write(reinterpret_cast<const char *>(link), 2), qint64(2));
+            qToLittleEndian<quint16>(0xFFFF, link);
+            QVERIFY(image.seek(fat + second * 2));
+            QCOMPARE(image.write(reinterpret_cast<const char *>(link), 2), qint64(2));
+        }
+
+        QVERIFY(image.seek(geometry.clusterOffset(first)));
+        QByteArray dirData = image.read(geometry.clusterSize);
+        for (int i = 0; i < dirData.size(); i += 32) {
+            if (dirData[i] == 0) {
+                dirData[i] = static_cast<char>(0xE5);
+            }
+        }
+        QVERIFY(image.seek(geometry.clusterOffset(first)));
+        image.write(dirData);
+
+        QByteArray entries(geometry.clusterSize, 0);
+        entries.replace(0, 11, "MOVEME  TXT");
+        entries[11] = 0x20;
+        QVERIFY(image.seek(geometry.clusterOffset(second)));
+        image.write(entries);
+    }
+
+    fs.reset(QFAT16FileSystem::create("test_fat16_move_chain.img").take());
+    QVERIFY(!fs.isNull());
+    QVERIFY(fs->exists("/deep/moveme.txt"));
+    QVERIFY(fs->moveFile("/deep/moveme.txt", "/moved.txt", error));
+    QCOMPARE(error, QFATError::None);
+    QVERIFY(fs->moveFile("/deep/a long name.txt", "/long moved.txt", error));
+    QCOMPARE(error, QFATError::None);
+    fs.reset();
+
+    // Neither the short entries nor the LFN parts of the sources are left behind
+    {
+        QFile image("test_fat16_move_chain.img");
+        QVERIFY(image.open(QIODevice::ReadOnly));
+        for (quint16 cluster : {first, second}) {
+            QVERIFY(image.seek(geometry.clusterOffset(cluster)));
+            QByteArray dirData = image.read(geometry.clusterSize);
+            for (int i = 0; i < dirData.size(); i += 32) {
+                quint8 firstByte = static_cast<quint8>(dirData[i]);
+                QVERIFY(firstByte == 0x00 || firstByte == 0xE5 || firstByte == '.');
+            }
+        }
+    }
+
+    fs.reset(QFAT16FileSystem::create("test_fat16_move_chain.img").take());
+    QVERIFY(!fs.isNull());
+    QVERIFY(fs->listDirectory("/deep").isEmpty());
+    QVERIFY(fs->exists("/moved.txt"));
+    QCOMPARE(fs->readFile("/long moved.txt", error), QByteArray("long"));
+
+    QFile::remove("test_fat16_move_chain.img");
+}
+
 void TestFAT16AdvancedOperations::testMoveToNonExistentDirectory()
 {
     QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_move_invalid.img");
@@ -340,7 +440,7 @@ void TestFAT16AdvancedOperations::testGetFreeSpace()
     QVERIFY(!fs.isNull());
 
     QFATError error;
-    quint32 freeSpace = fs->getFreeSpace(error);
+    quint64 freeSpace = fs->getFreeSpace(error);
     QCOMPARE(error, QFATError::None);
     QVERIFY(freeSpace > 0);
 
@@ -350,7 +450,7 @@ void TestFAT16AdvancedOperations::testGetFreeSpace()
     QByteArray largeData(10000, 'X');
     fs->writeFile("/large.bin", largeData, error);
 
-    quint32 newFreeSpace = fs->getFreeSpace(error);
+    quint64 newFreeSpace = fs->getFreeSpace(error);
     QCOMPARE(error, QFATError::None);
     QVERIFY(newFreeSpace < freeSpace);
 
@@ -368,11 +468,11 @@ void TestFAT16AdvancedOperations::testGetTotalSpace()
     QVERIFY(!fs.isNull());
 
     QFATError error;
-    quint32 totalSpace = fs->getTotalSpace(error);
+    quint64 totalSpace = fs->getTotalSpace(error);
     QCOMPARE(error, QFATError::None);
     QVERIFY(totalSpace > 0);
 
-    quint32 freeSpace = fs->getFreeSpace(error);
+    quint64 freeSpace = fs->getFreeSpace(error);
     QVERIFY(freeSpace <= totalSpace);
 
     qDebug() << "Total space:" << totalSpace << "bytes";
@@ -382,5 +482,275 @@ void TestFAT16AdvancedOperations::testGetTotalSpace()
     QFile::remove("test_fat16_totalspace.img");
 }
 
+void TestFAT16AdvancedOperations::testFreeSpaceAccounting()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_accounting.img");
+    QFile::setPermissions("test_fat16_accounting.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_accounting.img");
+    QVERIFY(!fs.isNull());
+
+    QFATError error;
+    quint32 clusterSize = fs->geometry().clusterSize;
+    quint64 freeBefore = fs->getFreeSpace(error);
+    QCOMPARE(error, QFATError::None);
+
+    // A file spanning several clusters uses exactly that many clusters
+    QByteArray testData(clusterSize * 5 + 1, 'A');
+    QVERIFY(fs->writeFile("/accounting.bin", testData, error));
+    QCOMPARE(fs->getFreeSpace(error), freeBefore - clusterSize * 6);
+    QCOMPARE(fs->readFile("/accounting.bin", error), testData);
+
+    // Deleting it gives every cluster back
+    QVERIFY(fs->deleteFile("/accounting.bin", error));
+    QCOMPARE(fs->getFreeSpace(error), freeBefore);
+
+    // A fresh mount counts the same free space from the FAT
+    quint64 freeAfter = fs->getFreeSpace(error);
+    fs.reset();
+    fs.reset(QFAT16FileSystem::create("test_fat16_accounting.img").take());
+    QVERIFY(!fs.isNull());
+    QCOMPARE(fs->getFreeSpace(error), freeAfter);
+
+    QFile::remove("test_fat16_accounting.img");
+}
+
+void TestFAT16AdvancedOperations::testPartialReadAcrossClusters()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_partial_clusters.img");
+    QFile::setPermissions("test_fat16_partial_clusters.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_partial_clusters.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QByteArray testData(clusterSize * 4 + 123, 0);
+    for (int i = 0; i < testData.size(); i++) {
+        testData[i] = static_cast<char>(i % 251);
+    }
+
+    QFATError error;
+    QVERIFY(fs->writeFile("/clusters.bin", testData, error));
+
+    // Range straddling a cluster boundary
+    QCOMPARE(fs->readFilePartial("/clusters.bin", clusterSize - 10, 20, error), testData.mid(clusterSize - 10, 20));
+    QCOMPARE(error, QFATError::None);
+
+    // Range inside a later cluster
+    QCOMPARE(fs->readFilePartial("/clusters.bin", clusterSize * 2 + 7, 100, error), testData.mid(clusterSize * 2 + 7, 100));
+
+    // Range spanning several clusters
+    QCOMPARE(fs->readFilePartial("/clusters.bin", 5, clusterSize * 3, error), testData.mid(5, clusterSize * 3));
+
+    // Tail of the file, length clamped to the file size
+    QCOMPARE(fs->readFilePartial("/clusters.bin", testData.size() - 50, 1000, error), testData.right(50));
+
+    QFile::remove("test_fat16_partial_clusters.img");
+}
+
+void TestFAT16AdvancedOperations::testCachedMissesInvalidated()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_pathcache.img");
+    QFile::setPermissions("test_fat16_pathcache.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_pathcache.img");
+    QVERIFY(!fs.isNull());
+
+    QFATError error;
+
+    // Misses are cached too, creating the path must make them visible
+    QVERIFY(!fs->exists("/cached.txt"));
+    QVERIFY(!fs->exists("/cachedir/inner.txt"));
+    QVERIFY(fs->writeFile("/cached.txt", QByteArray("root"), error));
+    QVERIFY(fs->exists("/cached.txt"));
+
+    QVERIFY(fs->createDirectory("/cachedir", error));
+    QVERIFY(!fs->exists("/cachedir/inner.txt"));
+    QVERIFY(fs->writeFile("/cachedir/inner.txt", QByteArray("inner"), error));
+    QVERIFY(fs->exists("/cachedir/inner.txt"));
+    QCOMPARE(fs->getFileInfo("/CACHEDIR/INNER.TXT", error).size, quint32(5));
+
+    // Paths below a renamed directory are no longer found under the old name
+    QVERIFY(fs->renameFile("/cachedir", "/moved", error));
+    QVERIFY(!fs->exists("/cachedir/inner.txt"));
+    QCOMPARE(fs->readFile("/moved/inner.txt", error), QByteArray("inner"));
+
+    // Changes in a subdirectory leave the root entry intact
+    QVERIFY(fs->deleteFile("/moved/inner.txt", error));
+    QVERIFY(!fs->exists("/moved/inner.txt"));
+    QCOMPARE(fs->readFile("/cached.txt", error), QByteArray("root"));
+
+    QFile::remove("test_fat16_pathcache.img");
+}
+
+void TestFAT16AdvancedOperations::testConcurrentPositionalReads()
+{
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create(TEST_FAT16_IMAGE_PATH);
+    QVERIFY(!fs.isNull());
+
+    QFile reference(TEST_FAT16_IMAGE_PATH);
+    QVERIFY(reference.open(QIODevice::ReadOnly));
+    QByteArray image = reference.read(fs->geometry().dataOffset + 64 * 1024);
+    QVERIFY(image.size() > 0);
+
+    QSharedPointer<QFile> file(new QFile(TEST_FAT16_IMAGE_PATH));
+    QVERIFY(file->open(QIODevice::ReadOnly));
+    QFATBlockCache cache(file, fs->geometry());
+    QVERIFY(cache.open(QIODevice::ReadOnly));
+
+    // Readers on separate threads each pass their own offset, none of them may see another's data
+    const int threadCount = 4;
+    int mismatches[threadCount] = {};
+    QList<QThread *> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.append(QThread::create([&, t]() {
+            char buffer[700];
+            for (int i = 0; i < 200; i++) {
+                qint64 offset = (static_cast<qint64>(i) * 4099 + t * 1531) % (image.size() - sizeof(buffer));
+                if (cache.readAt(offset, buffer, sizeof(buffer)) != static_cast<qint64>(sizeof(buffer))
+                    || memcmp(buffer, image.constData() + offset, sizeof(buffer)) != 0) {
+                    mismatches[t]++;
+                }
+            }
+        }));
+    }
+    for (QThread *thread : threads) {
+        thread->start();
+    }
+    for (QThread *thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+
+    for (int t = 0; t < threadCount; t++) {
+        QCOMPARE(mismatches[t], 0);
+    }
+    QCOMPARE(cache.pos(), qint64(0));
+}
+
+void TestFAT16AdvancedOperations::testSetFileTimes()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_times.img");
+    QFile::setPermissions("test_fat16_times.img", QFile::ReadUser | QFile::WriteUser);
+
+    QDateTime created(QDate(2001, 2, 3), QTime(4, 5, 6));
+    QDateTime modified(QDate(2020, 12, 24), QTime(18, 30, 10));
+
+    {
+        QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_times.img");
+        QVERIFY(!fs.isNull());
+
+        QFATError error;
+        QByteArray data("timestamps");
+        QVERIFY(fs->writeFile("/stamp.txt", data, error));
+
+        // Handles come with listings as well as lookups
+        QFATEntryHandle handle;
+        for (const QFATFileInfo &info : fs->listRootDirectory()) {
+            if (info.name == "STAMP.TXT") {
+                handle = info.entry;
+            }
+        }
+        QVERIFY(handle.isValid());
+        QCOMPARE(fs->getFileInfo("/stamp.txt", error).entry.slot, handle.slot);
+
+        QVERIFY(fs->setFileTimes(handle, created, modified, error));
+        QCOMPARE(error, QFATError::None);
+
+        QFATFileInfo info = fs->getFileInfo("/stamp.txt", error);
+        QCOMPARE(info.created, created);
+        QCOMPARE(info.modified, modified);
+        QCOMPARE(fs->readFile("/stamp.txt", error), data);
+
+        // An invalid time keeps the stored one
+        QDateTime later(QDate(2021, 1, 1), QTime(0, 0, 0));
+        QVERIFY(fs->setFileTimes("/stamp.txt", QDateTime(), later, error));
+        info = fs->getFileInfo("/stamp.txt", error);
+        QCOMPARE(info.created, created);
+        QCOMPARE(info.modified, later);
+        modified = later;
+    }
+
+    // The change is on disk, not only in the caches
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_times.img");
+    QFATError error;
+    QFATFileInfo info = fs->getFileInfo("/stamp.txt", error);
+    QCOMPARE(info.created, created);
+    QCOMPARE(info.modified, modified);
+
+    QFile::remove("test_fat16_times.img");
+}
+
+void TestFAT16AdvancedOperations::testSetAttributes()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_attributes.img");
+    QFile::setPermissions("test_fat16_attributes.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_attributes.img");
+    QVERIFY(!fs.isNull());
+
+    QFATError error;
+    QVERIFY(fs->writeFile("/attr.txt", "attributes", error));
+    QVERIFY(fs->createDirectory("/attrdir", error));
+
+    // Read-only and hidden
+    QVERIFY(fs->setAttributes("/attr.txt", 0x01 | 0x02, error));
+    QCOMPARE(fs->getFileInfo("/attr.txt", error).attributes, quint16(0x03));
+
+    // The directory bit cannot be cleared
+    QVERIFY(fs->setAttributes("/attrdir", 0x02, error));
+    QFATFileInfo dirInfo = fs->getFileInfo("/attrdir", error);
+    QVERIFY(dirInfo.isDirectory);
+    QCOMPARE(dirInfo.attributes, quint16(0x10 | 0x02));
+
+    // Read-only and hidden alone do not make an entry look like a long name part, so they can be cleared again
+    QVERIFY(fs->setAttributes("/attr.txt", 0x01 | 0x02 | 0x04, error));
+    QVERIFY(fs->setAttributes("/attr.txt", 0x02, error));
+    QCOMPARE(fs->getFileInfo("/attr.txt", error).attributes, quint16(0x02));
+
+    // Both entries survive a remount with their attributes
+    fs.reset();
+    fs.reset(QFAT16FileSystem::create("test_fat16_attributes.img").take());
+    QVERIFY(!fs.isNull());
+    QHash<QString, quint16> listed;
+    for (const QFATFileInfo &info : fs->listRootDirectory()) {
+        listed.insert((info.longName.isEmpty() ? info.name : info.longName).toLower(), info.attributes);
+    }
+    QVERIFY(listed.contains("attr.txt"));
+    QVERIFY(listed.contains("attrdir"));
+    QCOMPARE(listed.value("attr.txt"), quint16(0x02));
+    QCOMPARE(listed.value("attrdir"), quint16(0x10 | 0x02));
+    QCOMPARE(fs->readFile("/attr.txt", error), QByteArray("attributes"));
+
+    // The root directory has no entry, deleted entries leave stale handles behind
+    QVERIFY(!fs->setAttributes("/", 0x01, error));
+    QCOMPARE(error, QFATError::InvalidPath);
+
+    QFATEntryHandle handle = fs->getFileInfo("/attr.txt", error).entry;
+    QVERIFY(fs->deleteFile("/attr.txt", error));
+    QVERIFY(!fs->setAttributes(handle, 0x00, error));
+    QCOMPARE(error, QFATError::FileNotFound);
+
+    // A stale handle does not touch the entry that reused its slot
+    QVERIFY(fs->writeFile("/old.txt", "old", error));
+    QFATEntryHandle stale = fs->getFileInfo("/old.txt", error).entry;
+    QVERIFY(fs->deleteFile("/old.txt", error));
+    QVERIFY(fs->writeFile("/new.txt", "new", error));
+    QFATFileInfo reused = fs->getFileInfo("/new.txt", error);
+    QCOMPARE(reused.entry.directoryCluster, stale.directoryCluster);
+    QCOMPARE(reused.entry.slot, stale.slot);
+
+    QVERIFY(!fs->setAttributes(stale, 0x01 | 0x02, error));
+    QCOMPARE(error, QFATError::FileNotFound);
+    QVERIFY(!fs->setFileTimes(stale, QDateTime(QDate(2001, 2, 3), QTime(4, 5, 6)), QDateTime(), error));
+    QCOMPARE(error, QFATError::FileNotFound);
+
+    QFATFileInfo unchanged = fs->getFileInfo("/new.txt", error);
+    QCOMPARE(unchanged.attributes, reused.attributes);
+    QCOMPARE(unchanged.created, reused.created);
+
+    QFile::remove("test_fat16_attributes.img");
+}
+
 QTEST_MAIN(TestFAT16AdvancedOperations)
 #include "test_fat16_advanced.moc"
@@ -1,5 +1,6 @@
 #include "../qfatfilesystem.h"
 #include <QDebug>
+#include <QtEndian>
 #include <QtTest/QtTest>
 
 const QString TEST_FAT16_IMAGE_PATH = "data/fat16.img";
@@ -18,8 +19,71 @@ private slots:
     // File deletion tests
     void testDeleteFile();
     void testDeleteNonExistentFile();
+
+    // Block cache tests
+    void testBlockCacheWriteBack();
+    void testBlockCacheEviction();
+    void testBlockCacheDisabled();
+
+    // Allocation policy tests
+    void testBestFitAllocation();
+    void testSizeHintKeepsStreamContiguous();
+
+    // In-place update tests
+    void testAppendFile();
+    void testWriteAt();
+
+    // Batch tests
+    void testBatchCommit();
+    void testBatchRollback();
+    void testBatchKeepsFreedClusters();
+    void testBatchNestedRollback();
+
+private:
+    QByteArray readRootDirectoryRegion(const QString &imagePath, const QFATVolumeGeometry &geometry);
+    QByteArray readFATRegion(const QString &imagePath, const QFATVolumeGeometry &geometry);
+    bool isContiguous(const QString &imagePath, const QFATVolumeGeometry &geometry, quint16 startCluster, int clusters);
 };
 
+bool TestFAT16WriteOperations::isContiguous(const QString &imagePath, const QFATVolumeGeometry &geometry, quint16 startCluster, int clusters)
+{
+    QFile image(imagePath);
+    if (!image.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    image.seek(geometry.fatOffset);
+    QByteArray fat = image.read(geometry.fatSize);
+
+    // Every entry but the last must point at the cluster right after it
+    for (int i = 0; i < clusters - 1; i++) {
+        quint16 next = qFromLittleEndian<quint16>(fat.constData() + (startCluster + i) * 2);
+        if (next != startCluster + i + 1) {
+            return false;
+        }
+    }
+    return qFromLittleEndian<quint16>(fat.constData() + (startCluster + clusters - 1) * 2) >= 0xFFF8;
+}
+
+QByteArray TestFAT16WriteOperations::readRootDirectoryRegion(const QString &imagePath, const QFATVolumeGeometry &geometry)
+{
+    QFile image(imagePath);
+    if (!image.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    image.seek(geometry.rootDirOffset);
+    return image.read(geometry.rootDirSize);
+}
+
+QByteArray TestFAT16WriteOperations::readFATRegion(const QString &imagePath, const QFATVolumeGeometry &geometry)
+{
+    QFile image(imagePath);
+    if (!image.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    image.seek(geometry.fatOffset);
+    return image.read(static_cast<qint64>(geometry.numFATs) * geometry.fatSize);
+}
+
 void TestFAT16WriteOperations::testWriteNewFile()
 {
     QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_write.img");
@@ -203,5 +267,437 @@ void TestFAT16WriteOperations::testDeleteNonExistentFile()
     QFile::remove("test_fat16_delete_nonexist.img");
 }
 
+void TestFAT16WriteOperations::testBlockCacheWriteBack()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_blockcache.img");
+    QFile::setPermissions("test_fat16_blockcache.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_blockcache.img");
+    QVERIFY(!fs.isNull());
+    QCOMPARE(fs->blockCachePolicy(QFATCacheRegion::Directory), QFATCachePolicy::WriteBack);
+
+    QFATError error;
+    QVERIFY(fs->writeFile("/wbtest.txt", QByteArray("write-back"), error));
+    QCOMPARE(fs->readFile("/wbtest.txt", error), QByteArray("write-back"));
+
+    // The new directory entry only reaches the image on flush
+    const QFATVolumeGeometry &geometry = fs->geometry();
+    QVERIFY(!readRootDirectoryRegion("test_fat16_blockcache.img", geometry).contains("WBTEST  TXT"));
+    QVERIFY(fs->flush());
+    QVERIFY(readRootDirectoryRegion("test_fat16_blockcache.img", geometry).contains("WBTEST  TXT"));
+
+    fs.reset();
+    QFile::remove("test_fat16_blockcache.img");
+}
+
+void TestFAT16WriteOperations::testBlockCacheEviction()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_blockcache_small.img");
+    QFile::setPermissions("test_fat16_blockcache_small.img", QFile::ReadUser | QFile::WriteUser);
+
+    QFATError error;
+
+    {
+        QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_blockcache_small.img");
+        QVERIFY(!fs.isNull());
+
+        // Two blocks force modified metadata out through eviction
+        QVERIFY(fs->setBlockCacheSize(fs->geometry().bytesPerSector * 2));
+        for (int i = 0; i < 20; i++) {
+            QVERIFY(fs->writeFile(QString("/evict%1.txt").arg(i), QByteArray::number(i * 11), error));
+        }
+        for (int i = 0; i < 20; i++) {
+            QCOMPARE(fs->readFile(QString("/evict%1.txt").arg(i), error), QByteArray::number(i * 11));
+        }
+    }
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_blockcache_small.img");
+    QVERIFY(!fs.isNull());
+    for (int i = 0; i < 20; i++) {
+        QCOMPARE(fs->readFile(QString("/evict%1.txt").arg(i), error), QByteArray::number(i * 11));
+    }
+
+    fs.reset();
+    QFile::remove("test_fat16_blockcache_small.img");
+}
+
+void TestFAT16WriteOperations::testBlockCacheDisabled()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_blockcache_off.img");
+    QFile::setPermissions("test_fat16_blockcache_off.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_blockcache_off.img");
+    QVERIFY(!fs.isNull());
+    QVERIFY(fs->setBlockCacheSize(0));
+    QCOMPARE(fs->blockCacheSize(), qint64(0));
+
+    // Without a cache everything still round-trips, through this mount and a fresh one
+    QFATError error;
+    QVERIFY(fs->writeFile("/direct.txt", QByteArray("direct"), error));
+    QCOMPARE(fs->readFile("/direct.txt", error), QByteArray("direct"));
+
+    fs.reset();
+    fs.reset(QFAT16FileSystem::create("test_fat16_blockcache_off.img").take());
+    QVERIFY(!fs.isNull());
+    QCOMPARE(fs->readFile("/direct.txt", error), QByteArray("direct"));
+
+    fs.reset();
+    QFile::remove("test_fat16_blockcache_off.img");
+}
+
+void TestFAT16WriteOperations::testBestFitAllocation()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_bestfit.img");
+    QFile::setPermissions("test_fat16_bestfit.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_bestfit.img");
+    QVERIFY(!fs.isNull());
+
+    // Leave a five-cluster and a three-cluster hole between files that stay
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QFATError error;
+    QVERIFY(fs->writeFile("/keep1.bin", QByteArray(clusterSize, '1'), error));
+    QVERIFY(fs->writeFile("/hole5.bin", QByteArray(clusterSize * 5, '5'), error));
+    QVERIFY(fs->writeFile("/keep2.bin", QByteArray(clusterSize, '2'), error));
+    QVERIFY(fs->writeFile("/hole3.bin", QByteArray(clusterSize * 3, '3'), error));
+    QVERIFY(fs->writeFile("/keep3.bin", QByteArray(clusterSize, '4'), error));
+    quint32 hole5 = fs->getFileInfo("/hole5.bin", error).cluster;
+    quint32 hole3 = fs->getFileInfo("/hole3.bin", error).cluster;
+    QVERIFY(fs->deleteFile("/hole5.bin", error));
+    QVERIFY(fs->deleteFile("/hole3.bin", error));
+
+    // Three clusters fill the three-cluster hole exactly, the larger one stays whole
+    QByteArray three(clusterSize * 3, 't');
+    QVERIFY(fs->writeFile("/three.bin", three, error));
+    QCOMPARE(fs->getFileInfo("/three.bin", error).cluster, hole3);
+
+    QByteArray five(clusterSize * 5, 'f');
+    QVERIFY(fs->writeFile("/five.bin", five, error));
+    QCOMPARE(fs->getFileInfo("/five.bin", error).cluster, hole5);
+
+    QCOMPARE(fs->readFile("/three.bin", error), three);
+    QCOMPARE(fs->readFile("/five.bin", error), five);
+    const QFATVolumeGeometry geometry = fs->geometry();
+    fs.reset();
+
+    QVERIFY(isContiguous("test_fat16_bestfit.img", geometry, hole3, 3));
+    QVERIFY(isContiguous("test_fat16_bestfit.img", geometry, hole5, 5));
+
+    QFile::remove("test_fat16_bestfit.img");
+}
+
+void TestFAT16WriteOperations::testSizeHintKeepsStreamContiguous()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_sizehint.img");
+    QFile::setPermissions("test_fat16_sizehint.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_sizehint.img");
+    QVERIFY(!fs.isNull());
+
+    // A one-cluster hole would swallow the first cluster of an unhinted stream
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QFATError error;
+    QVERIFY(fs->writeFile("/keep1.bin", QByteArray(clusterSize, '1'), error));
+    QVERIFY(fs->writeFile("/hole1.bin", QByteArray(clusterSize, 'h'), error));
+    QVERIFY(fs->writeFile("/keep2.bin", QByteArray(clusterSize, '2'), error));
+    QVERIFY(fs->deleteFile("/hole1.bin", error));
+
+    QByteArray data(clusterSize * 6, 0);
+    for (int i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i % 249);
+    }
+
+    quint32 start;
+    {
+        QFATFile file(fs.data(), "/hinted.bin");
+        file.setSizeHint(data.size());
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        for (int offset = 0; offset < data.size(); offset += clusterSize) {
+            QCOMPARE(file.write(data.mid(offset, clusterSize)), static_cast<qint64>(clusterSize));
+        }
+        start = file.fileInfo().cluster;
+    }
+
+    QCOMPARE(fs->readFile("/hinted.bin", error), data);
+    const QFATVolumeGeometry geometry = fs->geometry();
+    fs.reset();
+
+    QVERIFY(isContiguous("test_fat16_sizehint.img", geometry, start, 6));
+
+    QFile::remove("test_fat16_sizehint.img");
+}
+
+void TestFAT16WriteOperations::testAppendFile()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_append.img");
+    QFile::setPermissions("test_fat16_append.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_append.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QFATError error;
+
+    // Appending to a missing file creates it
+    QByteArray line("first line\n");
+    QVERIFY(fs->appendFile("/log.txt", line, error));
+    QCOMPARE(error, QFATError::None);
+    QCOMPARE(fs->readFile("/log.txt", error), line);
+
+    // Fill the first cluster exactly, the chain must keep its start and grow by one cluster only
+    QByteArray expected = line;
+    QByteArray fill(clusterSize - line.size(), 'a');
+    QVERIFY(fs->appendFile("/log.txt", fill, error));
+    expected += fill;
+    quint32 start = fs->getFileInfo("/log.txt", error).cluster;
+    quint64 freeBefore = fs->getFreeSpace(error);
+
+    QByteArray more("second line\n");
+    QVERIFY(fs->appendFile("/log.txt", more, error));
+    expected += more;
+
+    QFATFileInfo info = fs->getFileInfo("/log.txt", error);
+    QCOMPARE(info.cluster, start);
+    QCOMPARE(info.size, static_cast<quint32>(expected.size()));
+    QCOMPARE(fs->getFreeSpace(error), freeBefore - clusterSize);
+    QCOMPARE(fs->readFile("/log.txt", error), expected);
+
+    // Directories cannot be appended to
+    QVERIFY(fs->createDirectory("/logs", error));
+    QVERIFY(!fs->appendFile("/logs", more, error));
+    QCOMPARE(error, QFATError::InvalidPath);
+
+    QFile::remove("test_fat16_append.img");
+}
+
+void TestFAT16WriteOperations::testWriteAt()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_writeat.img");
+    QFile::setPermissions("test_fat16_writeat.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_writeat.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QFATError error;
+    QByteArray data(clusterSize * 3, 'd');
+    QVERIFY(fs->writeFile("/patch.bin", data, error));
+    quint32 start = fs->getFileInfo("/patch.bin", error).cluster;
+    quint64 freeBefore = fs->getFreeSpace(error);
+
+    // Patching across a cluster boundary changes neither the chain nor the free space
+    QByteArray patch("PATCHED");
+    QVERIFY(fs->writeAt("/patch.bin", clusterSize - 3, patch, error));
+    data.replace(clusterSize - 3, patch.size(), patch);
+    QCOMPARE(fs->readFile("/patch.bin", error), data);
+    QCOMPARE(fs->getFileInfo("/patch.bin", error).cluster, start);
+    QCOMPARE(fs->getFreeSpace(error), freeBefore);
+
+    // Writing past the end fills the gap with zeros
+    QVERIFY(fs->writeAt("/patch.bin", data.size() + 10, "tail", error));
+    data += QByteArray(10, 0) + QByteArray("tail");
+    QCOMPARE(fs->readFile("/patch.bin", error), data);
+    QCOMPARE(fs->getFileInfo("/patch.bin", error).cluster, start);
+
+    // Unlike appendFile, writeAt does not create files
+    QVERIFY(!fs->writeAt("/missing.bin", 0, patch, error));
+    QCOMPARE(error, QFATError::FileNotFound);
+    QVERIFY(!fs->exists("/missing.bin"));
+
+    QFile::remove("test_fat16_writeat.img");
+}
+
+void TestFAT16WriteOperations::testBatchCommit()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_batch.img");
+    QFile::setPermissions("test_fat16_batch.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_batch.img");
+    QVERIFY(!fs.isNull());
+
+    QFATVolumeGeometry geometry = fs->geometry();
+    QByteArray fatBefore = readFATRegion("test_fat16_batch.img", geometry);
+    QByteArray rootBefore = readRootDirectoryRegion("test_fat16_batch.img", geometry);
+
+    QFATError error;
+    QVERIFY(fs->beginBatch());
+    QVERIFY(fs->isInBatch());
+    QVERIFY(fs->createDirectory("/batch", error));
+    for (int i = 0; i < 100; i++) {
+        QVERIFY(fs->writeFile(QString("/batch/f%1.txt").arg(i), QByteArray::number(i), error));
+    }
+
+    // Visible through the filesystem, but no metadata has reached the image yet
+    QCOMPARE(fs->readFile("/batch/f42.txt", error), QByteArray("42"));
+    QVERIFY(fs->flush());
+    QCOMPARE(readFATRegion("test_fat16_batch.img", geometry), fatBefore);
+    QCOMPARE(readRootDirectoryRegion("test_fat16_batch.img", geometry), rootBefore);
+
+    QVERIFY(fs->commitBatch(error));
+    QCOMPARE(error, QFATError::None);
+    QVERIFY(!fs->isInBatch());
+    QVERIFY(readFATRegion("test_fat16_batch.img", geometry) != fatBefore);
+
+    // Everything is on the image once committed
+    fs.reset();
+    fs.reset(QFAT16FileSystem::create("test_fat16_batch.img").take());
+    QVERIFY(!fs.isNull());
+    QCOMPARE(fs->listDirectory("/batch").size(), 100);
+    for (int i = 0; i < 100; i++) {
+        QCOMPARE(fs->readFile(QString("/batch/f%1.txt").arg(i), error), QByteArray::number(i));
+    }
+
+    QFile::remove("test_fat16_batch.img");
+}
+
+void TestFAT16WriteOperations::testBatchRollback()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_rollback.img");
+    QFile::setPermissions("test_fat16_rollback.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_rollback.img");
+    QVERIFY(!fs.isNull());
+
+    QFATVolumeGeometry geometry = fs->geometry();
+    QByteArray fatBefore = readFATRegion("test_fat16_rollback.img", geometry);
+    QByteArray rootBefore = readRootDirectoryRegion("test_fat16_rollback.img", geometry);
+
+    QFATError error;
+    quint64 freeBefore = fs->getFreeSpace(error);
+
+    {
+        // Dropped without commit
+        QFATTransaction transaction(fs.data());
+        QVERIFY(transaction.isActive());
+        QVERIFY(fs->writeFile("/gone.txt", QByteArray(geometry.clusterSize * 3, 'g'), error));
+        QVERIFY(fs->createDirectory("/gonedir", error));
+        QVERIFY(fs->exists("/gone.txt"));
+    }
+
+    QVERIFY(!fs->isInBatch());
+    QVERIFY(!fs->exists("/gone.txt"));
+    QVERIFY(!fs->exists("/gonedir"));
+    QCOMPARE(fs->getFreeSpace(error), freeBefore);
+
+    QVERIFY(fs->flush());
+    QCOMPARE(readFATRegion("test_fat16_rollback.img", geometry), fatBefore);
+    QCOMPARE(readRootDirectoryRegion("test_fat16_rollback.img", geometry), rootBefore);
+
+    // The filesystem stays usable, and a committed transaction sticks
+    {
+        QFATTransaction transaction(fs.data());
+        QVERIFY(fs->writeFile("/kept.txt", "kept", error));
+        QVERIFY(transaction.commit(error));
+        QVERIFY(!transaction.isActive());
+    }
+    QCOMPARE(fs->readFile("/kept.txt", error), QByteArray("kept"));
+
+    QFile::remove("test_fat16_rollback.img");
+}
+
+void TestFAT16WriteOperations::testBatchKeepsFreedClusters()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_batchfree.img");
+    QFile::setPermissions("test_fat16_batchfree.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_batchfree.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QFATError error;
+    QVERIFY(fs->writeFile("/old.bin", QByteArray(clusterSize * 2, 'o'), error));
+    quint16 oldCluster = fs->getFileInfo("/old.bin", error).cluster;
+    quint64 freeBefore = fs->getFreeSpace(error);
+
+    // A cluster freed inside the batch must not be handed out again before the commit
+    QVERIFY(fs->beginBatch());
+    QVERIFY(fs->deleteFile("/old.bin", error));
+    QCOMPARE(fs->getFreeSpace(error), freeBefore);
+    QVERIFY(fs->writeFile("/new.bin", QByteArray(clusterSize * 2, 'n'), error));
+    quint16 newCluster = fs->getFileInfo("/new.bin", error).cluster;
+    QVERIFY(newCluster != oldCluster);
+    QVERIFY(newCluster != oldCluster + 1);
+    QCOMPARE(fs->getFreeSpace(error), freeBefore - clusterSize * 2);
+
+    QVERIFY(fs->commitBatch(error));
+    QCOMPARE(fs->getFreeSpace(error), freeBefore);
+
+    // Released on disk once committed
+    QByteArray fat = readFATRegion("test_fat16_batchfree.img", fs->geometry());
+    QCOMPARE(qFromLittleEndian<quint16>(fat.constData() + oldCluster * 2), quint16(0));
+    QCOMPARE(qFromLittleEndian<quint16>(fat.constData() + (oldCluster + 1) * 2), quint16(0));
+    QVERIFY(!fs->exists("/old.bin"));
+    QCOMPARE(fs->readFile("/new.bin", error), QByteArray(clusterSize * 2, 'n'));
+
+    QFile::remove("test_fat16_batchfree.img");
+}
+
+void TestFAT16WriteOperations::testBatchNestedRollback()
+{
+    QFile::copy(TEST_FAT16_IMAGE_PATH, "test_fat16_nested.img");
+    QFile::setPermissions("test_fat16_nested.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT16FileSystem> fs = QFAT16FileSystem::create("test_fat16_nested.img");
+    QVERIFY(!fs.isNull());
+
+    QFATVolumeGeometry geometry = fs->geometry();
+    QByteArray fatBefore = readFATRegion("test_fat16_nested.img", geometry);
+    QByteArray rootBefore = readRootDirectoryRegion("test_fat16_nested.img", geometry);
+
+    // Committing without a batch is an error, not a flush
+    QFATError error;
+    QVERIFY(!fs->commitBatch(error));
+    QCOMPARE(error, QFATError::NotInBatch);
+
+    {
+        QFATTransaction outer(fs.data());
+        QVERIFY(fs->writeFile("/outer1.txt", "outer", error));
+        {
+            // Dropped without commit, which dooms the outer transaction too
+            QFATTransaction inner(fs.data());
+            QVERIFY(fs->writeFile("/inner.txt", "inner", error));
+        }
+
+        // Later changes are still held, not written through
+        QVERIFY(fs->isInBatch());
+        QVERIFY(fs->writeFile("/outer2.txt", "outer", error));
+        QVERIFY(fs->flush());
+        QCOMPARE(readRootDirectoryRegion("test_fat16_nested.img", geometry), rootBefore);
+
+        QVERIFY(!outer.commit(error));
+        QCOMPARE(error, QFATError::BatchAborted);
+    }
+
+    QVERIFY(!fs->isInBatch());
+    QVERIFY(!fs->exists("/outer1.txt"));
+    QVERIFY(!fs->exists("/inner.txt"));
+    QVERIFY(!fs->exists("/outer2.txt"));
+    QVERIFY(fs->flush());
+    QCOMPARE(readFATRegion("test_fat16_nested.img", geometry), fatBefore);
+    QCOMPARE(readRootDirectoryRegion("test_fat16_nested.img", geometry), rootBefore);
+
+    // Nested commits leave the writing to the outermost one
+    {
+        QFATTransaction outer(fs.data());
+        QVERIFY(fs->writeFile("/outer.txt", "outer", error));
+        {
+            QFATTransaction inner(fs.data());
+            QVERIFY(fs->writeFile("/inner.txt", "inner", error));
+            QVERIFY(inner.commit(error));
+        }
+        QVERIFY(fs->isInBatch());
+        QVERIFY(outer.commit(error));
+        QCOMPARE(error, QFATError::None);
+    }
+
+    fs.reset();
+    fs.reset(QFAT16FileSystem::create("test_fat16_nested.img").take());
+    QVERIFY(!fs.isNull());
+    QCOMPARE(fs->readFile("/outer.txt", error), QByteArray("outer"));
+    QCOMPARE(fs->readFile("/inner.txt", error), QByteArray("inner"));
+
+    QFile::remove("test_fat16_nested.img");
+}
+
 QTEST_MAIN(TestFAT16WriteOperations)
 #include "test_fat16_write.moc"
@@ -1,5 +1,6 @@
 #include "../qfatfilesystem.h"
 #include <QDebug>
+#include <QtEndian>
 #include <QtTest/QtTest>
 
 const QString TEST_FAT32_IMAGE_PATH = "data/fat32.img";
@@ -18,6 +19,8 @@ private slots:
 
     // Move tests
     void testMoveFile();
+    void testMoveKeepsClusters();
+    void testMoveDirectoryUpdatesParentLink();
 
     // Recursive directory deletion tests
     void testDeleteEmptyDirectoryNonRecursive();
@@ -26,8 +29,32 @@ private slots:
     // Filesystem info tests
     void testGetFreeSpace();
     void testGetTotalSpace();
+
+    // Cluster chain tests
+    void testMultiClusterReadAfterRewrite();
+
+    // Directory index tests
+    void testDirectoryLookupStaysCoherent();
+
+    // Large volume tests
+    void testLargeSparseVolume();
+
+    // FSInfo tests
+    void testFSInfoUpdatedOnFlush();
+    void testFSInfoTrustAndVerify();
+    void testFSInfoUntouchedWithoutChanges();
+
+private:
+    bool createSparseVolume(const QString &path);
+    quint64 fsInfoOffset(const QString &path);
 };
 
+// Layout of the sparse volume: ~200 GB with 32 KB clusters, one file stored far beyond 4 GiB
+static const quint32 LARGE_TOTAL_SECTORS = 400000000;
+static const quint32 LARGE_SECTORS_PER_FAT = 50000;
+static const quint32 LARGE_FILE_CLUSTER = 6000000;
+static const int LARGE_FILE_CLUSTERS = 3;
+
 void TestFAT32AdvancedOperations::testPartialRead()
 {
     QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_partial.img");
@@ -161,6 +188,95 @@ void TestFAT32AdvancedOperations::testMoveFile()
     QFile::remove("test_fat32_move.img");
 }
 
+void TestFAT32AdvancedOperations::testMoveKeepsClusters()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_move_meta.img");
+    QFile::setPermissions("test_fat32_move_meta.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_move_meta.img");
+    QVERIFY(!fs.isNull());
+
+    QFATError error;
+    QVERIFY(fs->createDirectory("/from", error));
+    QVERIFY(fs->createDirectory("/to", error));
+
+    QByteArray data(fs->geometry().clusterSize * 4 + 100, 'm');
+    QVERIFY(fs->writeFile("/from/recording.data", data, error));
+    QFATFileInfo before = fs->getFileInfo("/from/recording.data", error);
+    quint64 freeBefore = fs->getFreeSpace(error);
+
+    // A long destination name needs a generated short name and LFN entries
+    QVERIFY(fs->moveFile("/from/recording.data", "/to/renamed recording.data", error));
+    QCOMPARE(error, QFATError::None);
+
+    QVERIFY(!fs->exists("/from/recording.data"));
+    QFATFileInfo after = fs->getFileInfo("/to/renamed recording.data", error);
+    QCOMPARE(error, QFATError::None);
+    QCOMPARE(after.cluster, before.cluster);
+    QCOMPARE(after.size, before.size);
+    QCOMPARE(fs->getFreeSpace(error), freeBefore);
+    QCOMPARE(fs->readFile("/to/renamed recording.data", error), data);
+
+    // Existing destinations are refused
+    QVERIFY(fs->writeFile("/from/other.txt", "other", error));
+    QVERIFY(!fs->moveFile("/from/other.txt", "/to/renamed recording.data", error));
+    QCOMPARE(error, QFATError::InvalidPath);
+    QCOMPARE(fs->readFile("/from/other.txt", error), QByteArray("other"));
+
+    // The long name is on the image, not only in memory
+    fs.reset();
+    fs.reset(QFAT32FileSystem::create("test_fat32_move_meta.img").take());
+    QVERIFY(!fs.isNull());
+    after = fs->getFileInfo("/to/renamed recording.data", error);
+    QCOMPARE(error, QFATError::None);
+    QCOMPARE(after.longName, QString("renamed recording.data"));
+    QCOMPARE(after.cluster, before.cluster);
+    QCOMPARE(fs->readFile("/to/renamed recording.data", error), data);
+
+    QFile::remove("test_fat32_move_meta.img");
+}
+
+void TestFAT32AdvancedOperations::testMoveDirectoryUpdatesParentLink()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_move_tree.img");
+    QFile::setPermissions("test_fat32_move_tree.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_move_tree.img");
+    QVERIFY(!fs.isNull());
+
+    QFATError error;
+    QVERIFY(fs->createDirectory("/tree", error));
+    QVERIFY(fs->createDirectory("/tree/branch", error));
+    QVERIFY(fs->createDirectory("/target", error));
+    QVERIFY(fs->writeFile("/tree/branch/leaf.txt", "leaf", error));
+    quint32 branchCluster = fs->getFileInfo("/tree/branch", error).cluster;
+    quint32 targetCluster = fs->getFileInfo("/target", error).cluster;
+
+    // A directory cannot go below itself
+    QVERIFY(!fs->moveFile("/tree", "/tree/branch/tree", error));
+    QCOMPARE(error, QFATError::InvalidPath);
+
+    QVERIFY(fs->moveFile("/tree/branch", "/target/branch", error));
+    QCOMPARE(fs->getFileInfo("/target/branch", error).cluster, branchCluster);
+    QCOMPARE(fs->readFile("/target/branch/leaf.txt", error), QByteArray("leaf"));
+    QVERIFY(!fs->exists("/tree/branch"));
+
+    const QFATVolumeGeometry geometry = fs->geometry();
+    fs.reset();
+
+    // '..' of the moved directory now names its new parent
+    QFile image("test_fat32_move_tree.img");
+    QVERIFY(image.open(QIODevice::ReadOnly));
+    QVERIFY(image.seek(geometry.clusterOffset(branchCluster) + 32));
+    QByteArray dotDot = image.read(32);
+    QCOMPARE(dotDot.left(2), QByteArray(".."));
+    quint32 parent = qFromLittleEndian<quint16>(dotDot.constData() + 0x1A) |
+                     (static_cast<quint32>(qFromLittleEndian<quint16>(dotDot.constData() + 0x14)) << 16);
+    QCOMPARE(parent, targetCluster);
+
+    QFile::remove("test_fat32_move_tree.img");
+}
+
 void TestFAT32AdvancedOperations::testDeleteEmptyDirectoryNonRecursive()
 {
     QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_del_empty.img");
@@ -218,7 +334,7 @@ void TestFAT32AdvancedOperations::testGetFreeSpace()
     QVERIFY(!fs.isNull());
 
     QFATError error;
-    quint32 freeSpace = fs->getFreeSpace(error);
+    quint64 freeSpace = fs->getFreeSpace(error);
     QCOMPARE(error, QFATError::None);
     QVERIFY(freeSpace > 0);
 
@@ -228,7 +344,7 @@ void TestFAT32AdvancedOperations::testGetFreeSpace()
     QByteArray largeData(10000, 'X');
     fs->writeFile("/large32.bin", largeData, error);
 
-    quint32 newFreeSpace = fs->getFreeSpace(error);
+    quint64 newFreeSpace = fs->getFreeSpace(error);
     QCOMPARE(error, QFATError::None);
     QVERIFY(newFreeSpace < freeSpace);
 
@@ -246,11 +362,11 @@ void TestFAT32AdvancedOperations::testGetTotalSpace()
     QVERIFY(!fs.isNull());
 
     QFATError error;
-    quint32 totalSpace = fs->getTotalSpace(error);
+    quint64 totalSpace = fs->getTotalSpace(error);
     QCOMPARE(error, QFATError::None);
     QVERIFY(totalSpace > 0);
 
-    quint32 freeSpace = fs->getFreeSpace(error);
+    quint64 freeSpace = fs->getFreeSpace(error);
     QVERIFY(freeSpace <= totalSpace);
 
     qDebug() << "FAT32 total space:" << totalSpace << "bytes";
@@ -260,5 +376,340 @@ void TestFAT32AdvancedOperations::testGetTotalSpace()
     QFile::remove("test_fat32_totalspace.img");
 }
 
+void TestFAT32AdvancedOperations::testMultiClusterReadAfterRewrite()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_extents.img");
+    QFile::setPermissions("test_fat32_extents.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_extents.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QFATError error;
+
+    QByteArray first(clusterSize * 3, 'A');
+    QVERIFY(fs->writeFile("/extents.bin", first, error));
+    QCOMPARE(fs->readFile("/extents.bin", error), first);
+
+    // Rewriting changes the chain, cached extents must not be reused
+    QByteArray second(clusterSize * 5 + 100, 'B');
+    second[0] = 'X';
+    second[second.size() - 1] = 'Y';
+    QVERIFY(fs->writeFile("/extents.bin", second, error));
+    QCOMPARE(fs->readFile("/extents.bin", error), second);
+
+    // Clusters freed by a delete are reused without disturbing the neighbouring file
+    QByteArray other(clusterSize, 'O');
+    QVERIFY(fs->writeFile("/other.bin", other, error));
+    QVERIFY(fs->deleteFile("/extents.bin", error));
+    QByteArray third(clusterSize * 8, 'C');
+    for (int i = 0; i < third.size(); i += clusterSize) {
+        third[i] = static_cast<char>('0' + i / clusterSize);
+    }
+    QVERIFY(fs->writeFile("/third.bin", third, error));
+    QCOMPARE(fs->readFile("/third.bin", error), third);
+    QCOMPARE(fs->readFile("/other.bin", error), other);
+
+    QFile::remove("test_fat32_extents.img");
+}
+
+void TestFAT32AdvancedOperations::testDirectoryLookupStaysCoherent()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_dirindex.img");
+    QFile::setPermissions("test_fat32_dirindex.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_dirindex.img");
+    QVERIFY(!fs.isNull());
+
+    QFATError error;
+    QVERIFY(fs->createDirectory("/lookup", error));
+    for (int i = 0; i < 12; i++) {
+        QVERIFY(fs->writeFile(QString("/lookup/entry%1.dat").arg(i), QByteArray::number(i), error));
+    }
+
+    // Lookups are case-insensitive on every path component
+    QVERIFY(fs->exists("/LOOKUP/ENTRY7.DAT"));
+    QCOMPARE(fs->readFile("/Lookup/Entry11.Dat", error), QByteArray("11"));
+
+    // Rewrites, renames and deletes are visible to the next lookup
+    QVERIFY(fs->writeFile("/lookup/entry7.dat", QByteArray("seven"), error));
+    QCOMPARE(fs->getFileInfo("/lookup/entry7.dat", error).size, quint32(5));
+
+    QVERIFY(fs->renameFile("/lookup/entry8.dat", "/lookup/renamed.dat", error));
+    QVERIFY(!fs->exists("/lookup/entry8.dat"));
+    QCOMPARE(fs->readFile("/lookup/renamed.dat", error), QByteArray("8"));
+
+    QVERIFY(fs->deleteFile("/lookup/entry9.dat", error));
+    QVERIFY(!fs->exists("/lookup/entry9.dat"));
+    QVERIFY(fs->exists("/lookup/entry10.dat"));
+
+    QFile::remove("test_fat32_dirindex.img");
+}
+
+bool TestFAT32AdvancedOperations::createSparseVolume(const QString &path)
+{
+    QFile image(path);
+    if (!image.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        return false;
+    }
+    if (!image.resize(static_cast<qint64>(LARGE_TOTAL_SECTORS) * 512)) {
+        return false;
+    }
+
+    // Boot sector: 512-byte sectors, 64 sectors per cluster, 32 reserved sectors, 2 FATs, root in cluster 2
+    QByteArray boot(512, 0);
+    uchar *bpb = reinterpret_cast<uchar *>(boot.data());
+    qToLittleEndian<quint16>(512, bpb + 11);
+    bpb[13] = 64;
+    qToLittleEndian<quint16>(32, bpb + 14);
+    bpb[16] = 2;
+    qToLittleEndian<quint32>(LARGE_TOTAL_SECTORS, bpb + 32);
+    qToLittleEndian<quint32>(LARGE_SECTORS_PER_FAT, bpb + 36);
+    qToLittleEndian<quint32>(2, bpb + 44);
+    bpb[510] = 0x55;
+    bpb[511] = 0xAA;
+    image.seek(0);
+    image.write(boot);
+
+    // Reserved entries, the root directory and the file's chain, in both FAT copies
+    for (quint64 fat = 0; fat < 2; fat++) {
+        quint64 fatOffset = 32 * 512 + fat * LARGE_SECTORS_PER_FAT * 512;
+        uchar entry[4];
+        auto writeEntry = [&](quint32 cluster, quint32 value) {
+            qToLittleEndian<quint32>(value, entry);
+            image.seek(fatOffset + cluster * 4);
+            image.write(reinterpret_cast<const char *>(entry), 4);
+        };
+        writeEntry(0, 0x0FFFFFF8);
+        writeEntry(1, 0x0FFFFFFF);
+        writeEntry(2, 0x0FFFFFFF);
+        for (int i = 0; i < LARGE_FILE_CLUSTERS; i++) {
+            writeEntry(LARGE_FILE_CLUSTER + i, i + 1 < LARGE_FILE_CLUSTERS ? LARGE_FILE_CLUSTER + i + 1 : 0x0FFFFFFF);
+        }
+    }
+
+    // Root directory entry for BIG.BIN
+    quint64 dataOffset = (32 + 2 * LARGE_SECTORS_PER_FAT) * 512;
+    QByteArray entry(32, 0);
+    uchar *raw = reinterpret_cast<uchar *>(entry.data());
+    memcpy(raw, "BIG     BIN", 11);
+    raw[11] = 0x20;
+    qToLittleEndian<quint16>(LARGE_FILE_CLUSTER >> 16, raw + 20);
+    qToLittleEndian<quint16>(LARGE_FILE_CLUSTER & 0xFFFF, raw + 26);
+    qToLittleEndian<quint32>(LARGE_FILE_CLUSTERS * 32768 - 100, raw + 28);
+    image.seek(dataOffset);
+    image.write(entry);
+
+    // File contents
+    QByteArray contents(LARGE_FILE_CLUSTERS * 32768 - 100, 0);
+    for (int i = 0; i < contents.size(); i++) {
+        contents[i] = static_cast<char>((i * 13) % 251);
+    }
+    image.seek(dataOffset + static_cast<quint64>(LARGE_FILE_CLUSTER - 2) * 32768);
+    return image.write(contents) == contents.size();
+}
+
+void TestFAT32AdvancedOperations::testLargeSparseVolume()
+{
+    const QString path = "test_fat32_large.img";
+    if (!createSparseVolume(path)) {
+        QFile::remove(path);
+        QSKIP("Sparse images are not supported here");
+    }
+
+    QByteArray expected(LARGE_FILE_CLUSTERS * 32768 - 100, 0);
+    for (int i = 0; i < expected.size(); i++) {
+        expected[i] = static_cast<char>((i * 13) % 251);
+    }
+
+    {
+        QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create(path);
+        QVERIFY(!fs.isNull());
+        QVERIFY(fs->geometry().valid);
+        QVERIFY(fs->geometry().clusterOffset(LARGE_FILE_CLUSTER) > quint64(0xFFFFFFFF));
+
+        // Space figures exceed 32 bits without wrapping
+        QFATError error;
+        quint64 clusterCount = fs->geometry().clusterCount;
+        QCOMPARE(fs->getTotalSpace(error), clusterCount * 32768);
+        QVERIFY(fs->getTotalSpace(error) > quint64(100) * 1024 * 1024 * 1024);
+
+        QFATVolumeStats stats = fs->volumeStats(error);
+        QCOMPARE(error, QFATError::None);
+        QCOMPARE(stats.clusterSize, quint32(32768));
+        QCOMPARE(stats.totalClusters, fs->geometry().clusterCount);
+        QCOMPARE(stats.freeClusters, fs->geometry().clusterCount - 1 - LARGE_FILE_CLUSTERS);
+        QCOMPARE(stats.totalBytes, fs->getTotalSpace(error));
+        QCOMPARE(stats.freeBytes, fs->getFreeSpace(error));
+        QCOMPARE(stats.usedBytes, quint64(1 + LARGE_FILE_CLUSTERS) * 32768);
+
+        // Data far past 4 GiB reads back intact
+        QCOMPARE(fs->readFile("/BIG.BIN", error), expected);
+        QCOMPARE(fs->readFilePartial("/big.bin", 32768 - 10, 20, error), expected.mid(32768 - 10, 20));
+
+        QFATFile file(fs.data(), "/BIG.BIN");
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.seek(32768 - 2));
+        QCOMPARE(file.write("PATCH"), qint64(5));
+        file.close();
+    }
+
+    // The patch landed at the 64-bit offset
+    QFile image(path);
+    QVERIFY(image.open(QIODevice::ReadOnly));
+    quint64 dataOffset = (32 + 2 * LARGE_SECTORS_PER_FAT) * 512;
+    QVERIFY(image.seek(dataOffset + static_cast<quint64>(LARGE_FILE_CLUSTER - 2) * 32768 + 32768 - 2));
+    QCOMPARE(image.read(5), QByteArray("PATCH"));
+    image.close();
+
+    QFile::remove(path);
+}
+
+quint64 TestFAT32AdvancedOperations::fsInfoOffset(const QString &path)
+{
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create(path);
+    if (fs.isNull()) {
+        return 0;
+    }
+    return static_cast<quint64>(fs->geometry().fsInfoSector) * fs->geometry().bytesPerSector;
+}
+
+// Free count and next-free hint as stored in the FSInfo sector
+static void readFSInfo(const QString &path, quint64 offset, quint32 &freeCount, quint32 &nextFree)
+{
+    QFile image(path);
+    image.open(QIODevice::ReadOnly);
+    image.seek(offset + 0x1E8);
+    QByteArray values = image.read(8);
+    freeCount = qFromLittleEndian<quint32>(values.constData());
+    nextFree = qFromLittleEndian<quint32>(values.constData() + 4);
+}
+
+void TestFAT32AdvancedOperations::testFSInfoUpdatedOnFlush()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_fsinfo.img");
+    QFile::setPermissions("test_fat32_fsinfo.img", QFile::ReadUser | QFile::WriteUser);
+
+    quint64 offset = fsInfoOffset("test_fat32_fsinfo.img");
+    if (offset == 0) {
+        QFile::remove("test_fat32_fsinfo.img");
+        QSKIP("Test image has no FSInfo sector");
+    }
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_fsinfo.img");
+    QVERIFY(!fs.isNull());
+    fs->setFSInfoMode(QFATFSInfoMode::Verify);
+
+    QFATError error;
+    quint32 clusterSize = fs->geometry().clusterSize;
+    quint64 freeBefore = fs->getFreeSpace(error);
+    QVERIFY(fs->writeFile("/fsinfo.bin", QByteArray(clusterSize * 3, 'f'), error));
+    QFATFileInfo info = fs->getFileInfo("/fsinfo.bin", error);
+    QVERIFY(fs->flush());
+
+    // Allocation moved both the free count and the next-free hint
+    quint32 freeCount;
+    quint32 nextFree;
+    readFSInfo("test_fat32_fsinfo.img", offset, freeCount, nextFree);
+    QCOMPARE(static_cast<quint64>(freeCount) * clusterSize, freeBefore - clusterSize * 3);
+    QCOMPARE(nextFree, info.cluster + 3);
+
+    // Freeing is recorded as well
+    QVERIFY(fs->deleteFile("/fsinfo.bin", error));
+    QVERIFY(fs->flush());
+    readFSInfo("test_fat32_fsinfo.img", offset, freeCount, nextFree);
+    QCOMPARE(static_cast<quint64>(freeCount) * clusterSize, freeBefore);
+
+    fs.reset();
+    QFile::remove("test_fat32_fsinfo.img");
+}
+
+void TestFAT32AdvancedOperations::testFSInfoTrustAndVerify()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_fsinfo_stale.img");
+    QFile::setPermissions("test_fat32_fsinfo_stale.img", QFile::ReadUser | QFile::WriteUser);
+
+    quint64 offset = fsInfoOffset("test_fat32_fsinfo_stale.img");
+    if (offset == 0) {
+        QFile::remove("test_fat32_fsinfo_stale.img");
+        QSKIP("Test image has no FSInfo sector");
+    }
+
+    // Make the stored free count disagree with the FAT
+    {
+        QFile image("test_fat32_fsinfo_stale.img");
+        QVERIFY(image.open(QIODevice::ReadWrite));
+        QVERIFY(image.seek(offset + 0x1E8));
+        uchar stale[4];
+        qToLittleEndian<quint32>(3, stale);
+        QCOMPARE(image.write(reinterpret_cast<const char *>(stale), 4), qint64(4));
+    }
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_fsinfo_stale.img");
+    QVERIFY(!fs.isNull());
+    QCOMPARE(fs->fsInfoMode(), QFATFSInfoMode::Trust);
+
+    // Trusted, the stored count is reported as is
+    QFATError error;
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QCOMPARE(fs->getFreeSpace(error), quint64(3) * clusterSize);
+
+    // Verified, the FAT is scanned and the stored count repaired
+    fs->setFSInfoMode(QFATFSInfoMode::Verify);
+    quint64 actual = fs->getFreeSpace(error);
+    QVERIFY(actual > quint64(3) * clusterSize);
+    QVERIFY(fs->flush());
+
+    quint32 freeCount;
+    quint32 nextFree;
+    readFSInfo("test_fat32_fsinfo_stale.img", offset, freeCount, nextFree);
+    QCOMPARE(static_cast<quint64>(freeCount) * clusterSize, actual);
+
+    fs.reset();
+    QFile::remove("test_fat32_fsinfo_stale.img");
+}
+
+void TestFAT32AdvancedOperations::testFSInfoUntouchedWithoutChanges()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_fsinfo_clean.img");
+    QFile::setPermissions("test_fat32_fsinfo_clean.img", QFile::ReadUser | QFile::WriteUser);
+
+    quint64 offset = fsInfoOffset("test_fat32_fsinfo_clean.img");
+    if (offset == 0) {
+        QFile::remove("test_fat32_fsinfo_clean.img");
+        QSKIP("Test image has no FSInfo sector");
+    }
+
+    // An unknown next-free hint leaves the allocator at its default cursor
+    QByteArray original;
+    {
+        QFile image("test_fat32_fsinfo_clean.img");
+        QVERIFY(image.open(QIODevice::ReadWrite));
+        QVERIFY(image.seek(offset + 0x1EC));
+        uchar unknown[4];
+        qToLittleEndian<quint32>(0xFFFFFFFF, unknown);
+        QCOMPARE(image.write(reinterpret_cast<const char *>(unknown), 4), qint64(4));
+        QVERIFY(image.seek(0));
+        original = image.readAll();
+    }
+
+    // Mounting read-write and only reading must not touch the image
+    {
+        QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_fsinfo_clean.img");
+        QVERIFY(!fs.isNull());
+        QFATError error;
+        fs->listRootDirectory();
+        fs->getFreeSpace(error);
+        QVERIFY(fs->flush());
+    }
+
+    QFile image("test_fat32_fsinfo_clean.img");
+    QVERIFY(image.open(QIODevice::ReadOnly));
+    QVERIFY(image.readAll() == original);
+    image.close();
+
+    QFile::remove("test_fat32_fsinfo_clean.img");
+}
+
 QTEST_MAIN(TestFAT32AdvancedOperations)
 #include "test_fat32_advanced.moc"
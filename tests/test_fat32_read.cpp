@@ -27,6 +27,9 @@ private slots:
     void testFileSizes();
     void testLongFilenames();
 
+    // Mapped read-only mount
+    void testMappedReadOnly();
+
 private:
     bool findFileByName(const QList<QFATFileInfo> &files, const QString &name);
     QFATFileInfo getFileByName(const QList<QFATFileInfo> &files, const QString &name);
@@ -218,6 +221,34 @@ void TestFAT32ReadOperations::testLongFilenames()
     qDebug() << "FAT32 long filename validation passed";
 }
 
+void TestFAT32ReadOperations::testMappedReadOnly()
+{
+    QScopedPointer<QFAT32FileSystem> reference = QFAT32FileSystem::create(TEST_FAT32_IMAGE_PATH);
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create(TEST_FAT32_IMAGE_PATH, QFATMountMode::MappedReadOnly);
+    QVERIFY(!reference.isNull());
+    QVERIFY(!fs.isNull());
+    QVERIFY(fs->isMapped());
+    QVERIFY(!reference->isMapped());
+
+    QFATError error;
+    for (const QString &path : {QString("/test.txt"), QString("/binary.dat"), QString("/largefile.bin")}) {
+        QByteArray expected = reference->readFile(path, error);
+        QCOMPARE(fs->readFile(path, error), expected);
+        QCOMPARE(error, QFATError::None);
+        QCOMPARE(fs->readFilePartial(path, 3, 100, error), expected.mid(3, 100));
+    }
+
+    // A single-cluster file is a view into the mapping, so both reads share the same bytes
+    QByteArray first = fs->readFile("/test.txt", error);
+    QByteArray second = fs->readFile("/test.txt", error);
+    QCOMPARE(first.constData(), second.constData());
+
+    QCOMPARE(fs->listRootDirectory().size(), reference->listRootDirectory().size());
+    QCOMPARE(fs->listDirectory("/subdir1").size(), reference->listDirectory("/subdir1").size());
+
+    QVERIFY(!fs->writeFile("/mapped.txt", QByteArray("data"), error));
+}
+
 bool TestFAT32ReadOperations::findFileByName(const QList<QFATFileInfo> &files, const QString &name)
 {
     QString upperName = name.toUpper();
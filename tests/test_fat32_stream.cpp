@@ -0,0 +1,417 @@
+#include "../qfatfilesystem.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QtTest/QtTest>
+
+const QString TEST_FAT32_IMAGE_PATH = "data/fat32.img";
+
+// Sequential source producing a fixed number of bytes without holding them in memory
+class PatternSource : public QIODevice
+{
+public:
+    // Only available bytes are ever handed out, after that the source stalls short of its end
+    explicit PatternSource(qint64 length, qint64 available = -1)
+        : m_remaining(length)
+        , m_available(available < 0 ? length : available)
+    {
+    }
+
+    bool isSequential() const override { return true; }
+    bool atEnd() const override { return m_remaining == 0 && QIODevice::atEnd(); }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        qint64 count = qMin(maxSize, qMin(m_remaining, m_available));
+        memset(data, 'x', count);
+        m_remaining -= count;
+        m_available -= count;
+        return count;
+    }
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    qint64 m_remaining;
+    qint64 m_available;
+};
+
+class TestFAT32StreamOperations : public QObject
+{
+    Q_OBJECT
+private slots:
+    // Reading through QFATFile
+    void testReadWithDataStream();
+    void testHashFromDevice();
+    void testSeekAndRead();
+
+    // Writing through QFATFile
+    void testWriteNewFile();
+    void testOverwriteInPlace();
+    void testWritePastEnd();
+    void testOpenMissingFileReadOnly();
+
+    // Streaming whole files in
+    void testWriteFileFromDevice();
+    void testWriteFileFromDeviceTooLarge();
+    void testWriteFileFromStalledDevice();
+
+    // Streaming whole files out
+    void testReadFileToDevice();
+    void testReadFileChunks();
+
+private:
+    QByteArray patternData(int size);
+};
+
+QByteArray TestFAT32StreamOperations::patternData(int size)
+{
+    QByteArray data(size, 0);
+    for (int i = 0; i < size; i++) {
+        data[i] = static_cast<char>((i * 7) % 253);
+    }
+    return data;
+}
+
+void TestFAT32StreamOperations::testReadWithDataStream()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_datastream.img");
+    QFile::setPermissions("test_fat32_stream_datastream.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_datastream.img");
+    QVERIFY(!fs.isNull());
+
+    // Serialize a few thousand integers spanning several clusters
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        for (quint32 i = 0; i < 5000; i++) {
+            out << i;
+        }
+    }
+
+    QFATError error;
+    QVERIFY(fs->writeFile("/numbers.bin", payload, error));
+
+    QFATFile file(fs.data(), "/numbers.bin");
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.size(), static_cast<qint64>(payload.size()));
+
+    QDataStream in(&file);
+    for (quint32 i = 0; i < 5000; i++) {
+        quint32 value;
+        in >> value;
+        QCOMPARE(value, i);
+    }
+    QVERIFY(file.atEnd());
+    file.close();
+
+    QFile::remove("test_fat32_stream_datastream.img");
+}
+
+void TestFAT32StreamOperations::testHashFromDevice()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_hash.img");
+    QFile::setPermissions("test_fat32_stream_hash.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_hash.img");
+    QVERIFY(!fs.isNull());
+
+    QByteArray testData = patternData(fs->geometry().clusterSize * 6 + 17);
+    QFATError error;
+    QVERIFY(fs->writeFile("/hashme.bin", testData, error));
+
+    QFATFile file(fs.data(), "/hashme.bin");
+    QVERIFY(file.open(QIODevice::ReadOnly));
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QVERIFY(hash.addData(&file));
+    QCOMPARE(hash.result(), QCryptographicHash::hash(testData, QCryptographicHash::Sha256));
+
+    QFile::remove("test_fat32_stream_hash.img");
+}
+
+void TestFAT32StreamOperations::testSeekAndRead()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_seek.img");
+    QFile::setPermissions("test_fat32_stream_seek.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_seek.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QByteArray testData = patternData(clusterSize * 4);
+    QFATError error;
+    QVERIFY(fs->writeFile("/seek.bin", testData, error));
+
+    QFATFile file(fs.data(), "/seek.bin");
+    QVERIFY(file.open(QIODevice::ReadOnly));
+
+    // Backwards and forwards across cluster boundaries
+    QVERIFY(file.seek(clusterSize * 3 - 5));
+    QCOMPARE(file.read(10), testData.mid(clusterSize * 3 - 5, 10));
+    QVERIFY(file.seek(3));
+    QCOMPARE(file.read(clusterSize), testData.mid(3, clusterSize));
+    QCOMPARE(file.pos(), static_cast<qint64>(clusterSize + 3));
+
+    // Reads stop at the end of the file
+    QVERIFY(file.seek(testData.size() - 4));
+    QCOMPARE(file.read(100), testData.right(4));
+    QVERIFY(file.atEnd());
+
+    QFile::remove("test_fat32_stream_seek.img");
+}
+
+void TestFAT32StreamOperations::testWriteNewFile()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_write.img");
+    QFile::setPermissions("test_fat32_stream_write.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_write.img");
+    QVERIFY(!fs.isNull());
+
+    QByteArray testData = patternData(fs->geometry().clusterSize * 5 + 300);
+    QFATError error;
+    quint64 freeBefore = fs->getFreeSpace(error);
+
+    {
+        QFATFile file(fs.data(), "/streamed.bin");
+        QVERIFY(file.open(QIODevice::WriteOnly));
+
+        // Write in odd-sized pieces so writes straddle cluster boundaries
+        for (int offset = 0; offset < testData.size(); offset += 1000) {
+            QByteArray chunk = testData.mid(offset, 1000);
+            QCOMPARE(file.write(chunk), static_cast<qint64>(chunk.size()));
+        }
+        QCOMPARE(file.size(), static_cast<qint64>(testData.size()));
+    }
+
+    QFATFileInfo info = fs->getFileInfo("/streamed.bin", error);
+    QCOMPARE(error, QFATError::None);
+    QCOMPARE(info.size, static_cast<quint32>(testData.size()));
+    QCOMPARE(fs->readFile("/streamed.bin", error), testData);
+    QCOMPARE(fs->getFreeSpace(error), freeBefore - fs->geometry().clusterSize * 6);
+
+    QFile::remove("test_fat32_stream_write.img");
+}
+
+void TestFAT32StreamOperations::testOverwriteInPlace()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_overwrite.img");
+    QFile::setPermissions("test_fat32_stream_overwrite.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_overwrite.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QByteArray testData = patternData(clusterSize * 3);
+    QFATError error;
+    QVERIFY(fs->writeFile("/inplace.bin", testData, error));
+
+    {
+        QFATFile file(fs.data(), "/inplace.bin");
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QCOMPARE(file.size(), static_cast<qint64>(testData.size()));
+
+        QVERIFY(file.seek(clusterSize - 2));
+        QCOMPARE(file.write("PATCH"), qint64(5));
+    }
+    testData.replace(clusterSize - 2, 5, "PATCH");
+
+    QCOMPARE(fs->readFile("/inplace.bin", error), testData);
+
+    // Append mode starts at the end
+    {
+        QFATFile file(fs.data(), "/inplace.bin");
+        QVERIFY(file.open(QIODevice::Append));
+        QCOMPARE(file.write("TAIL"), qint64(4));
+    }
+    testData.append("TAIL");
+
+    QCOMPARE(fs->readFile("/inplace.bin", error), testData);
+
+    QFile::remove("test_fat32_stream_overwrite.img");
+}
+
+void TestFAT32StreamOperations::testWritePastEnd()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_hole.img");
+    QFile::setPermissions("test_fat32_stream_hole.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_hole.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+
+    {
+        QFATFile file(fs.data(), "/hole.bin");
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write("head"), qint64(4));
+        QVERIFY(file.seek(clusterSize * 2 + 10));
+        QCOMPARE(file.write("tail"), qint64(4));
+    }
+
+    QByteArray expected = QByteArray("head") + QByteArray(clusterSize * 2 + 6, 0) + QByteArray("tail");
+    QFATError error;
+    QCOMPARE(fs->readFile("/hole.bin", error), expected);
+
+    QFile::remove("test_fat32_stream_hole.img");
+}
+
+void TestFAT32StreamOperations::testOpenMissingFileReadOnly()
+{
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create(TEST_FAT32_IMAGE_PATH);
+    QVERIFY(!fs.isNull());
+
+    QFATFile file(fs.data(), "/does_not_exist.bin");
+    QVERIFY(!file.open(QIODevice::ReadOnly));
+    QVERIFY(!file.isOpen());
+}
+
+void TestFAT32StreamOperations::testWriteFileFromDevice()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_from.img");
+    QFile::setPermissions("test_fat32_stream_from.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_from.img");
+    QVERIFY(!fs.isNull());
+
+    // Larger than one streaming chunk, and not a whole number of clusters
+    QByteArray data = patternData(3 * 1024 * 1024 + 123);
+    QBuffer source(&data);
+    QVERIFY(source.open(QIODevice::ReadOnly));
+
+    QFATError error;
+    QVERIFY(fs->writeFileFrom("/streamed.bin", &source, error));
+    QCOMPARE(error, QFATError::None);
+
+    QFATFileInfo info = fs->getFileInfo("/streamed.bin", error);
+    QCOMPARE(error, QFATError::None);
+    QCOMPARE(qint64(info.size), qint64(data.size()));
+    QCOMPARE(fs->readFile("/streamed.bin", error), data);
+
+    // Streaming over an existing file replaces it
+    QByteArray smaller = patternData(1000);
+    QBuffer second(&smaller);
+    QVERIFY(second.open(QIODevice::ReadOnly));
+    QVERIFY(fs->writeFileFrom("/streamed.bin", &second, error, smaller.size()));
+    QCOMPARE(fs->readFile("/streamed.bin", error), smaller);
+
+    QFile::remove("test_fat32_stream_from.img");
+}
+
+void TestFAT32StreamOperations::testWriteFileFromDeviceTooLarge()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_full.img");
+    QFile::setPermissions("test_fat32_stream_full.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_full.img");
+    QVERIFY(!fs.isNull());
+
+    QFATError error;
+    PatternSource source(fs->getFreeSpace(error) + fs->geometry().clusterSize);
+    QVERIFY(source.open(QIODevice::ReadOnly));
+
+    QVERIFY(!fs->writeFileFrom("/full.bin", &source, error));
+    QCOMPARE(error, QFATError::InsufficientSpace);
+
+    // The partial file is removed again
+    fs->getFileInfo("/full.bin", error);
+    QCOMPARE(error, QFATError::FileNotFound);
+
+    QFile::remove("test_fat32_stream_full.img");
+}
+
+void TestFAT32StreamOperations::testWriteFileFromStalledDevice()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_stall.img");
+    QFile::setPermissions("test_fat32_stream_stall.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_stall.img");
+    QVERIFY(!fs.isNull());
+
+    // The source never delivers the rest and waitForReadyRead() gives up
+    PatternSource source(100000, 40000);
+    QVERIFY(source.open(QIODevice::ReadOnly));
+
+    QFATError error;
+    QVERIFY(!fs->writeFileFrom("/stalled.bin", &source, error));
+    QCOMPARE(error, QFATError::ReadError);
+
+    // The truncated file is removed again
+    fs->getFileInfo("/stalled.bin", error);
+    QCOMPARE(error, QFATError::FileNotFound);
+
+    QFile::remove("test_fat32_stream_stall.img");
+}
+
+void TestFAT32StreamOperations::testReadFileToDevice()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_to.img");
+    QFile::setPermissions("test_fat32_stream_to.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_to.img");
+    QVERIFY(!fs.isNull());
+
+    QByteArray data = patternData(2 * 1024 * 1024 + 77);
+    QFATError error;
+    QVERIFY(fs->writeFile("/extract.bin", data, error));
+
+    QByteArray extracted;
+    QBuffer sink(&extracted);
+    QVERIFY(sink.open(QIODevice::WriteOnly));
+    QVERIFY(fs->readFileTo("/extract.bin", &sink, error));
+    QCOMPARE(error, QFATError::None);
+    QCOMPARE(extracted, data);
+
+    // Directories and missing files are rejected
+    QBuffer other;
+    QVERIFY(other.open(QIODevice::WriteOnly));
+    QVERIFY(!fs->readFileTo("/", &other, error));
+    QCOMPARE(error, QFATError::InvalidPath);
+    QVERIFY(!fs->readFileTo("/missing.bin", &other, error));
+    QCOMPARE(error, QFATError::FileNotFound);
+
+    QFile::remove("test_fat32_stream_to.img");
+}
+
+void TestFAT32StreamOperations::testReadFileChunks()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_stream_chunks.img");
+    QFile::setPermissions("test_fat32_stream_chunks.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_stream_chunks.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QByteArray data = patternData(clusterSize * 10 + 5);
+    QFATError error;
+    QVERIFY(fs->writeFile("/chunks.bin", data, error));
+
+    // Every chunk is a whole number of clusters except the tail
+    QByteArray collected;
+    int chunks = 0;
+    QVERIFY(fs->readFileChunks("/chunks.bin", [&](const char *chunk, qint64 length) {
+        if (collected.size() + length < data.size() && length % clusterSize != 0) {
+            return false;
+        }
+        collected.append(chunk, static_cast<int>(length));
+        chunks++;
+        return true;
+    }, error));
+    QCOMPARE(collected, data);
+    QVERIFY(chunks >= 1);
+
+    // The receiver can stop early
+    int calls = 0;
+    QVERIFY(!fs->readFileChunks("/chunks.bin", [&](const char *, qint64) {
+        calls++;
+        return false;
+    }, error));
+    QCOMPARE(calls, 1);
+    QCOMPARE(error, QFATError::WriteError);
+
+    QFile::remove("test_fat32_stream_chunks.img");
+}
+
+QTEST_MAIN(TestFAT32StreamOperations)
+#include "test_fat32_stream.moc"
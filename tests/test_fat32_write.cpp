@@ -13,6 +13,14 @@ private slots:
 
     // File deletion tests
     void testDeleteFile();
+
+    // FAT cache tests
+    void testFATCacheWriteBack();
+    void testFATMirrorDeferred();
+
+    // Size management tests
+    void testTruncate();
+    void testPreallocate();
 };
 
 void TestFAT32WriteOperations::testWriteNewFile()
@@ -66,5 +74,178 @@ void TestFAT32WriteOperations::testDeleteFile()
     QFile::remove("test_fat32_delete.img");
 }
 
+void TestFAT32WriteOperations::testFATCacheWriteBack()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_fatcache.img");
+    QFile::setPermissions("test_fat32_fatcache.img", QFile::ReadUser | QFile::WriteUser);
+
+    QByteArray testData(20000, 'C');
+    QFATError error;
+
+    {
+        QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_fatcache.img");
+        QVERIFY(!fs.isNull());
+        QVERIFY(fs->setFATCacheEnabled(true));
+        QVERIFY(fs->isFATCacheEnabled());
+
+        quint64 freeBefore = fs->getFreeSpace(error);
+        QVERIFY(fs->writeFile("/cached.bin", testData, error));
+        QCOMPARE(error, QFATError::None);
+        QVERIFY(fs->getFreeSpace(error) < freeBefore);
+
+        // Chains are resolved from the cache before anything is flushed
+        QCOMPARE(fs->readFile("/cached.bin", error), testData);
+        QVERIFY(fs->flush());
+    }
+
+    // A fresh mount without the cache must see the flushed FAT
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_fatcache.img");
+    QVERIFY(!fs.isNull());
+    QCOMPARE(fs->readFile("/cached.bin", error), testData);
+    QCOMPARE(error, QFATError::None);
+
+    // Every FAT copy must have been updated
+    const QFATVolumeGeometry &geometry = fs->geometry();
+    QFile image("test_fat32_fatcache.img");
+    QVERIFY(image.open(QIODevice::ReadOnly));
+    image.seek(geometry.fatOffset);
+    QByteArray firstFAT = image.read(geometry.fatSize);
+    for (quint8 i = 1; i < geometry.numFATs; i++) {
+        image.seek(geometry.fatOffset + i * geometry.fatSize);
+        QCOMPARE(image.read(geometry.fatSize), firstFAT);
+    }
+    image.close();
+
+    QFile::remove("test_fat32_fatcache.img");
+}
+
+void TestFAT32WriteOperations::testFATMirrorDeferred()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_mirror.img");
+    QFile::setPermissions("test_fat32_mirror.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_mirror.img");
+    QVERIFY(!fs.isNull());
+
+    const QFATVolumeGeometry geometry = fs->geometry();
+    QVERIFY(geometry.numFATs >= 2);
+    auto readFATCopy = [&geometry](quint8 copy) {
+        QFile image("test_fat32_mirror.img");
+        image.open(QIODevice::ReadOnly);
+        image.seek(geometry.fatOffset + static_cast<quint64>(copy) * geometry.fatSize);
+        return image.read(geometry.fatSize);
+    };
+    QByteArray mirrorBefore = readFATCopy(1);
+
+    // Without the block cache every FAT write reaches the image at once, but only in the first copy
+    QVERIFY(fs->setBlockCacheSize(0));
+    QVERIFY(fs->setFATMirrorDeferred(true));
+    QVERIFY(fs->isFATMirrorDeferred());
+
+    QByteArray testData(fs->geometry().clusterSize * 3, 'M');
+    QFATError error;
+    QVERIFY(fs->writeFile("/mirror.bin", testData, error));
+    QVERIFY(readFATCopy(0) != mirrorBefore);
+    QCOMPARE(readFATCopy(1), mirrorBefore);
+
+    // flush() brings the mirrors in line with the first copy
+    QVERIFY(fs->flush());
+    for (quint8 i = 1; i < geometry.numFATs; i++) {
+        QCOMPARE(readFATCopy(i), readFATCopy(0));
+    }
+
+    // Turning the mode off syncs pending changes right away
+    QVERIFY(fs->deleteFile("/mirror.bin", error));
+    QVERIFY(readFATCopy(1) != readFATCopy(0));
+    QVERIFY(fs->setFATMirrorDeferred(false));
+    QCOMPARE(readFATCopy(1), readFATCopy(0));
+
+    QFile::remove("test_fat32_mirror.img");
+}
+
+void TestFAT32WriteOperations::testTruncate()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_truncate.img");
+    QFile::setPermissions("test_fat32_truncate.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_truncate.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QByteArray data(clusterSize * 5, 0);
+    for (int i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i % 251);
+    }
+
+    QFATError error;
+    QVERIFY(fs->writeFile("/trunc.bin", data, error));
+    quint32 start = fs->getFileInfo("/trunc.bin", error).cluster;
+    quint64 freeBefore = fs->getFreeSpace(error);
+
+    // Shrinking to one and a half clusters keeps the start and releases three clusters
+    quint32 newSize = clusterSize + clusterSize / 2;
+    QVERIFY(fs->truncate("/trunc.bin", newSize, error));
+    QCOMPARE(error, QFATError::None);
+    QFATFileInfo info = fs->getFileInfo("/trunc.bin", error);
+    QCOMPARE(info.size, newSize);
+    QCOMPARE(info.cluster, start);
+    QCOMPARE(fs->readFile("/trunc.bin", error), data.left(newSize));
+    QCOMPARE(fs->getFreeSpace(error), freeBefore + clusterSize * 3);
+
+    // Growing again reads back zeros, not the old contents
+    QVERIFY(fs->truncate("/trunc.bin", clusterSize * 2, error));
+    QCOMPARE(fs->readFile("/trunc.bin", error), data.left(newSize) + QByteArray(clusterSize * 2 - newSize, 0));
+
+    // Truncating to zero frees the whole chain
+    QVERIFY(fs->truncate("/trunc.bin", 0, error));
+    info = fs->getFileInfo("/trunc.bin", error);
+    QCOMPARE(info.size, quint32(0));
+    QCOMPARE(info.cluster, quint32(0));
+    QCOMPARE(fs->getFreeSpace(error), freeBefore + clusterSize * 5);
+
+    QVERIFY(!fs->truncate("/missing.bin", 0, error));
+    QCOMPARE(error, QFATError::FileNotFound);
+
+    QFile::remove("test_fat32_truncate.img");
+}
+
+void TestFAT32WriteOperations::testPreallocate()
+{
+    QFile::copy(TEST_FAT32_IMAGE_PATH, "test_fat32_prealloc.img");
+    QFile::setPermissions("test_fat32_prealloc.img", QFile::ReadUser | QFile::WriteUser);
+
+    QScopedPointer<QFAT32FileSystem> fs = QFAT32FileSystem::create("test_fat32_prealloc.img");
+    QVERIFY(!fs.isNull());
+
+    quint32 clusterSize = fs->geometry().clusterSize;
+    QFATError error;
+    quint64 freeBefore = fs->getFreeSpace(error);
+
+    // The reservation is taken from free space while the file stays empty
+    QVERIFY(fs->preallocate("/record.bin", clusterSize * 8, error));
+    QCOMPARE(error, QFATError::None);
+    QFATFileInfo info = fs->getFileInfo("/record.bin", error);
+    QCOMPARE(info.size, quint32(0));
+    QVERIFY(info.cluster >= 2);
+    QCOMPARE(fs->getFreeSpace(error), freeBefore - clusterSize * 8);
+
+    // Appends fill the reserved clusters without allocating more
+    QByteArray chunk(clusterSize, 'r');
+    for (int i = 0; i < 4; i++) {
+        QVERIFY(fs->appendFile("/record.bin", chunk, error));
+    }
+    info = fs->getFileInfo("/record.bin", error);
+    QCOMPARE(info.size, clusterSize * 4);
+    QCOMPARE(fs->getFreeSpace(error), freeBefore - clusterSize * 8);
+    QCOMPARE(fs->readFile("/record.bin", error), chunk.repeated(4));
+
+    // Truncating to the current size hands back what was not used
+    QVERIFY(fs->truncate("/record.bin", info.size, error));
+    QCOMPARE(fs->getFreeSpace(error), freeBefore - clusterSize * 4);
+    QCOMPARE(fs->readFile("/record.bin", error), chunk.repeated(4));
+
+    QFile::remove("test_fat32_prealloc.img");
+}
+
 QTEST_MAIN(TestFAT32WriteOperations)
 #include "test_fat32_write.moc"